@@ -11,6 +11,9 @@
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #endif
 
 #include <string.h>
@@ -127,6 +130,94 @@ namespace Engine
 #endif // _WIN64
 	}
 
+	bool directory_exists( cstring path )
+	{
+#if defined(_WIN64)
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if ( !GetFileAttributesExA( path, GetFileExInfoStandard, &attributes ) )
+		{
+			return false;
+		}
+		return ( attributes.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) != 0;
+#else
+		struct stat path_stat;
+		if ( stat( path, &path_stat ) != 0 )
+		{
+			return false;
+		}
+		return S_ISDIR( path_stat.st_mode );
+#endif // _WIN64
+	}
+
+	bool directory_create( cstring path )
+	{
+		if ( directory_exists( path ) )
+		{
+			return true;
+		}
+
+#if defined(_WIN64)
+		return CreateDirectoryA( path, NULL ) != 0;
+#else
+		return mkdir( path, 0755 ) == 0;
+#endif // _WIN64
+	}
+
+	void directory_enumerate_files( cstring path, FileEnumerateCallback callback, void* user_data )
+	{
+		char file_path[ k_max_path ];
+
+#if defined(_WIN64)
+		snprintf( file_path, k_max_path, "%s\\*", path );
+
+		WIN32_FIND_DATAA find_data;
+		HANDLE find_handle = FindFirstFileA( file_path, &find_data );
+		if ( find_handle == INVALID_HANDLE_VALUE )
+		{
+			return;
+		}
+
+		do
+		{
+			if ( find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+			{
+				continue;
+			}
+
+			snprintf( file_path, k_max_path, "%s\\%s", path, find_data.cFileName );
+
+			const sizet size = ( ( sizet )find_data.nFileSizeHigh << 32 ) | find_data.nFileSizeLow;
+			const u64 last_write_time = ( ( u64 )find_data.ftLastWriteTime.dwHighDateTime << 32 ) | find_data.ftLastWriteTime.dwLowDateTime;
+			callback( file_path, size, last_write_time, user_data );
+
+		} while ( FindNextFileA( find_handle, &find_data ) );
+
+		FindClose( find_handle );
+#else
+		DIR* directory = opendir( path );
+		if ( !directory )
+		{
+			return;
+		}
+
+		struct dirent* entry;
+		while ( ( entry = readdir( directory ) ) != nullptr )
+		{
+			snprintf( file_path, k_max_path, "%s/%s", path, entry->d_name );
+
+			struct stat file_stat;
+			if ( stat( file_path, &file_stat ) != 0 || !S_ISREG( file_stat.st_mode ) )
+			{
+				continue;
+			}
+
+			callback( file_path, ( sizet )file_stat.st_size, ( u64 )file_stat.st_mtime, user_data );
+		}
+
+		closedir( directory );
+#endif // _WIN64
+	}
+
 	void environment_variable_get(cstring name, char* output, u32 output_size)
 	{
 #if defined(_WIN64)
@@ -231,11 +322,124 @@ namespace Engine
 		return result;
 	}
 
-	void file_write_binary(cstring filename, void* memory, sizet size)
+	bool file_write_binary(cstring filename, void* memory, sizet size)
 	{
 		FILE* file = fopen( filename, "wb" );
-		fwrite( memory, size, 1, file );
+		if ( !file )
+		{
+			return false;
+		}
+
+		const sizet written = fwrite( memory, size, 1, file );
 		fclose( file );
+
+		return written == 1;
+	}
+
+	bool file_map( cstring filename, MappedFile* mapped_file )
+	{
+		*mapped_file = { };
+
+#if defined(_WIN64)
+		HANDLE file = CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+		if ( file == INVALID_HANDLE_VALUE )
+		{
+			return false;
+		}
+
+		LARGE_INTEGER file_size;
+		if ( !GetFileSizeEx( file, &file_size ) || file_size.QuadPart == 0 )
+		{
+			CloseHandle( file );
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		void* data = mapping ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+		if ( !data )
+		{
+			if ( mapping )
+			{
+				CloseHandle( mapping );
+			}
+			CloseHandle( file );
+			return false;
+		}
+
+		mapped_file->data = ( const u8* )data;
+		mapped_file->size = ( sizet )file_size.QuadPart;
+		mapped_file->file_handle = file;
+		mapped_file->mapping_handle = mapping;
+#else
+		int file = open( filename, O_RDONLY );
+		if ( file < 0 )
+		{
+			return false;
+		}
+
+		struct stat file_stat;
+		if ( fstat( file, &file_stat ) != 0 || file_stat.st_size == 0 )
+		{
+			close( file );
+			return false;
+		}
+
+		// The mapping stays valid after the descriptor is closed.
+		void* data = mmap( nullptr, ( sizet )file_stat.st_size, PROT_READ, MAP_PRIVATE, file, 0 );
+		close( file );
+		if ( data == MAP_FAILED )
+		{
+			return false;
+		}
+
+		mapped_file->data = ( const u8* )data;
+		mapped_file->size = ( sizet )file_stat.st_size;
+#endif // _WIN64
+
+		return true;
+	}
+
+	void file_unmap( MappedFile* mapped_file )
+	{
+		if ( !mapped_file->data )
+		{
+			return;
+		}
+
+#if defined(_WIN64)
+		UnmapViewOfFile( mapped_file->data );
+		CloseHandle( mapped_file->mapping_handle );
+		CloseHandle( mapped_file->file_handle );
+#else
+		munmap( ( void* )mapped_file->data, mapped_file->size );
+#endif // _WIN64
+
+		*mapped_file = { };
+	}
+
+	bool file_stat( cstring path, sizet* size, u64* last_write_time )
+	{
+#if defined(_WIN64)
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if ( !GetFileAttributesExA( path, GetFileExInfoStandard, &attributes ) )
+		{
+			return false;
+		}
+
+		*size = ( ( sizet )attributes.nFileSizeHigh << 32 ) | attributes.nFileSizeLow;
+		*last_write_time = ( ( u64 )attributes.ftLastWriteTime.dwHighDateTime << 32 ) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat file_stat;
+		if ( stat( path, &file_stat ) != 0 )
+		{
+			return false;
+		}
+
+		*size = ( sizet )file_stat.st_size;
+		*last_write_time = ( u64 )file_stat.st_mtime;
+#endif // _WIN64
+
+		return true;
 	}
 
 } // namespace Engine.
\ No newline at end of file
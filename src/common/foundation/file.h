@@ -22,6 +22,9 @@ namespace Engine
 
 	using FileHandle = FILE*;
 
+	// Called for each regular file found by directory_enumerate_files, path includes the directory.
+	typedef void						( *FileEnumerateCallback )( cstring path, sizet size, u64 last_write_time, void* user_data );
+
 	static const u32		k_max_path = 512;
 
 	//
@@ -41,6 +44,20 @@ namespace Engine
 		sizet				size;
 	};
 
+	//
+	// Read only view of a whole file, pages are loaded by the OS on first access.
+	//
+	struct MappedFile
+	{
+		const u8*			data				= nullptr;
+		sizet				size				= 0;
+
+#if defined (_WIN64)
+		void*				file_handle			= nullptr;
+		void*				mapping_handle		= nullptr;
+#endif
+	}; // struct MappedFile
+
 	// Read file and allocate memory from allocator.
 	// User is responsible for freeing the memory.
 	char*								file_read_binary( cstring filename, Allocator* allocator, sizet* size );
@@ -49,6 +66,14 @@ namespace Engine
 	FileReadResult						file_read_binary( cstring filename, Allocator* allocator );
 	FileReadResult						file_read_text( cstring filename, Allocator* allocator );
 
+	bool								file_write_binary( cstring filename, void* memory, sizet size );
+
+	bool								file_map( cstring filename, MappedFile* mapped_file );		// Returns false if the file is missing or empty.
+	void								file_unmap( MappedFile* mapped_file );
+
+	// Size and last write time in OS specific units, only meant to be compared. Returns false if the file is missing.
+	bool								file_stat( cstring path, sizet* size, u64* last_write_time );
+
 	bool								file_exists( cstring path );
 	bool								file_delete( cstring path );
 
@@ -59,6 +84,10 @@ namespace Engine
 
 	void								directory_current( Directory* directory );
 	void								directory_change( cstring path );
+
+	bool								directory_exists( cstring path );
+	bool								directory_create( cstring path );								// Creates only the last folder of the path. Returns true if it exists afterwards.
+	void								directory_enumerate_files( cstring path, FileEnumerateCallback callback, void* user_data );
 	
 	
 
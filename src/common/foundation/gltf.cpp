@@ -1,88 +1,355 @@
 #include "gltf.h"
 
-#include "json/json.hpp"
-
+#include "foundation/array.h"
 #include "foundation/assert.h"
 #include "foundation/file.h"
+#include "foundation/numerics.h"
+#include "foundation/task_scheduler.h"
 
-using json = nlohmann::json;
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
 
 namespace Engine
 {
+    //
+    // The glTF linear allocator is shared by all the loading tasks.
+    struct GltfSharedAllocator : public Allocator {
 
-    static void* allocate_and_zero(Allocator* allocator, sizet size)
-    {
-        void* result = allocator->allocate(size, 64);
-        memset(result, 0, size);
+        void* allocate(sizet size, sizet alignment) override {
+            std::lock_guard<std::mutex> guard(mutex);
+            return allocator->allocate(size, alignment);
+        }
 
-        return result;
+        void* allocate(sizet size, sizet alignment, cstring file, i32 line) override {
+            return allocate(size, alignment);
+        }
+
+        void deallocate(void* pointer) override {
+            // Memory is released all together in gltf_free.
+        }
+
+        Allocator* allocator = nullptr;
+        std::mutex mutex;
+    }; // struct GltfSharedAllocator
+
+    // JSON tokens ////////////////////////////////////////////////////////
+
+    enum JsonType : u8 {
+        JsonType_Object, JsonType_Array, JsonType_String, JsonType_Primitive
+    };
+
+    //
+    // Flat token list of the document, children follow their parent.
+    struct JsonToken {
+        u32         start;      // Offset in the text. Strings are unescaped and null terminated in place.
+        u32         count;      // Direct children: array elements, object keys and values.
+        u32         next;       // Index of the token following this one and all its children.
+        JsonType    type;
+    };
+
+    struct JsonDocument {
+        char*               text;
+        Array<JsonToken>    tokens;
+    };
+
+    static void json_add_token(Array<JsonToken>& tokens, Array<u32>& open_tokens, JsonType type, u32 start) {
+        if (open_tokens.size) {
+            ++tokens[open_tokens.back()].count;
+        }
+
+        tokens.push({ start, 0, tokens.size + 1, type });
     }
 
-    static void try_load_string(json& json_data, cstring key, StringBuffer& string_buffer, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end())
-            return;
+    static u32 json_hex_value(const char* hex) {
+        u32 value = 0;
+        for (u32 i = 0; i < 4; ++i) {
+            const char c = hex[i];
+            value <<= 4;
+            if (c >= '0' && c <= '9') value |= c - '0';
+            else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        }
+        return value;
+    }
+
+    // Writes the UTF-8 encoding of code_point, never longer than the escape it replaces.
+    static char* json_write_utf8(char* output, u32 code_point) {
+        if (code_point < 0x80) {
+            *output++ = (char)code_point;
+        }
+        else if (code_point < 0x800) {
+            *output++ = (char)(0xc0 | (code_point >> 6));
+            *output++ = (char)(0x80 | (code_point & 0x3f));
+        }
+        else if (code_point < 0x10000) {
+            *output++ = (char)(0xe0 | (code_point >> 12));
+            *output++ = (char)(0x80 | ((code_point >> 6) & 0x3f));
+            *output++ = (char)(0x80 | (code_point & 0x3f));
+        }
+        else {
+            *output++ = (char)(0xf0 | (code_point >> 18));
+            *output++ = (char)(0x80 | ((code_point >> 12) & 0x3f));
+            *output++ = (char)(0x80 | ((code_point >> 6) & 0x3f));
+            *output++ = (char)(0x80 | (code_point & 0x3f));
+        }
+        return output;
+    }
 
-        std::string value = json_data.value(key, "");
+    //
+    // Single pass over the text: containers, strings and primitives become tokens, nothing is copied.
+    // Returns false on unbalanced containers or unterminated strings.
+    static bool json_tokenize(char* text, sizet length, Array<JsonToken>& tokens, Allocator* allocator) {
+        Array<u32> open_tokens;
+        open_tokens.init(allocator, 16);
+
+        bool valid = true;
+        sizet i = 0;
+        while (i < length && valid) {
+            const char c = text[i];
+            switch (c) {
+                case '{':
+                case '[': {
+                    json_add_token(tokens, open_tokens, c == '{' ? JsonType_Object : JsonType_Array, (u32)i);
+                    open_tokens.push(tokens.size - 1);
+                    ++i;
+                    break;
+                }
+                case '}':
+                case ']': {
+                    if (open_tokens.size == 0) {
+                        valid = false;
+                        break;
+                    }
+                    tokens[open_tokens.back()].next = tokens.size;
+                    open_tokens.pop();
+                    ++i;
+                    break;
+                }
+                case '"': {
+                    const sizet start = i + 1;
+                    char* output = text + start;
+                    sizet read = start;
+                    while (read < length && text[read] != '"') {
+                        if (text[read] != '\\') {
+                            *output++ = text[read++];
+                            continue;
+                        }
+
+                        if (read + 1 >= length) {
+                            break;
+                        }
+
+                        const char escaped = text[read + 1];
+                        read += 2;
+                        switch (escaped) {
+                            case 'b': *output++ = '\b'; break;
+                            case 'f': *output++ = '\f'; break;
+                            case 'n': *output++ = '\n'; break;
+                            case 'r': *output++ = '\r'; break;
+                            case 't': *output++ = '\t'; break;
+                            case 'u': {
+                                if (read + 4 > length) {
+                                    read = length;
+                                    break;
+                                }
+                                u32 code_point = json_hex_value(text + read);
+                                read += 4;
+                                // Surrogate pair, the low half is a second escape.
+                                if (code_point >= 0xd800 && code_point < 0xdc00 && read + 6 <= length && text[read] == '\\' && text[read + 1] == 'u') {
+                                    const u32 low = json_hex_value(text + read + 2);
+                                    code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+                                    read += 6;
+                                }
+                                output = json_write_utf8(output, code_point);
+                                break;
+                            }
+                            default: *output++ = escaped; break;
+                        }
+                    }
+
+                    if (read >= length) {
+                        valid = false;
+                        break;
+                    }
+
+                    *output = 0;
+                    json_add_token(tokens, open_tokens, JsonType_String, (u32)start);
+                    i = read + 1;
+                    break;
+                }
+                case ' ':
+                case '\t':
+                case '\n':
+                case '\r':
+                case ',':
+                case ':': {
+                    ++i;
+                    break;
+                }
+                default: {
+                    // Numbers, true, false and null are converted when read.
+                    json_add_token(tokens, open_tokens, JsonType_Primitive, (u32)i);
+                    while (i < length && !strchr(",:]} \t\n\r", text[i])) {
+                        ++i;
+                    }
+                    break;
+                }
+            }
+        }
 
-        string_buffer.init(value.length() + 1, allocator);
-        string_buffer.append(value.c_str());
+        valid = valid && open_tokens.size == 0 && tokens.size > 0;
+        open_tokens.shutdown();
+
+        return valid;
     }
 
-    static void try_load_int(json& json_data, cstring key, i32& value) {
-        auto it = json_data.find(key);
-        if (it == json_data.end())
-        {
-            value = glTF::INVALID_INT_VALUE;
-            return;
+    // Returns the value token of key, or u32_max when the object does not have it.
+    static u32 json_find(const JsonDocument& json, u32 object, cstring key) {
+        const JsonToken& object_token = json.tokens[object];
+        if (object_token.type != JsonType_Object) {
+            return u32_max;
         }
 
-        value = json_data.value(key, 0);
+        u32 key_token = object + 1;
+        for (u32 member = 0; member < object_token.count / 2; ++member) {
+            const u32 value_token = key_token + 1;
+            if (strcmp(json.text + json.tokens[key_token].start, key) == 0) {
+                return value_token;
+            }
+            key_token = json.tokens[value_token].next;
+        }
+
+        return u32_max;
     }
 
-    static void try_load_float(json& json_data, cstring key, f32& value) {
-        auto it = json_data.find(key);
-        if (it == json_data.end())
-        {
-            value = glTF::INVALID_FLOAT_VALUE;
-            return;
+    static u32 json_count(const JsonDocument& json, u32 token) {
+        return json.tokens[token].type == JsonType_Array ? json.tokens[token].count : 0;
+    }
+
+    static char* json_string(const JsonDocument& json, u32 token) {
+        return json.text + json.tokens[token].start;
+    }
+
+    static i32 json_int(const JsonDocument& json, u32 token) {
+        return (i32)strtol(json.text + json.tokens[token].start, nullptr, 10);
+    }
+
+    static f32 json_float(const JsonDocument& json, u32 token) {
+        return strtof(json.text + json.tokens[token].start, nullptr);
+    }
+
+    //
+    // Elements of the same glTF array are independent, so they are parsed in parallel.
+    template<typename T>
+    struct GltfLoadArrayContext {
+        const JsonDocument* json;
+        const u32* elements;
+        T* values;
+        void (*load)(const JsonDocument&, u32, T&, Allocator*);
+        Allocator* allocator;
+    };
+
+    template<typename T>
+    static void load_array_range(u32 start, u32 end, u32 thread_index, void* user_data) {
+        GltfLoadArrayContext<T>* context = (GltfLoadArrayContext<T>*)user_data;
+
+        for (u32 i = start; i < end; ++i) {
+            context->load(*context->json, context->elements[i], context->values[i], context->allocator);
+        }
+    }
+
+    template<typename T>
+    static void load_array_parallel(const JsonDocument& json, u32 array, T* values, sizet count, void (*load)(const JsonDocument&, u32, T&, Allocator*), Allocator* allocator) {
+        static const u32 k_elements_per_task = 16;
+
+        // Element tokens are found by skipping subtrees, tasks then jump straight to their elements.
+        Allocator* heap_allocator = &MemoryService::instance()->system_allocator;
+        Array<u32> elements;
+        elements.init(heap_allocator, (u32)count + 1);
+
+        u32 element = array + 1;
+        for (sizet i = 0; i < count; ++i) {
+            elements.push(element);
+            element = json.tokens[element].next;
         }
 
-        value = json_data.value(key, 0.0f);
+        GltfLoadArrayContext<T> context{ &json, elements.data, values, load, allocator };
+        TaskScheduler::instance()->parallel_for((u32)count, k_elements_per_task, load_array_range<T>, &context);
+
+        elements.shutdown();
     }
 
-    static void try_load_bool(json& json_data, cstring key, bool& value) {
-        auto it = json_data.find(key);
-        if (it == json_data.end())
-        {
-            value = false;
-            return;
+    template<typename T>
+    static void load_array(const JsonDocument& json, u32 array, T* values, sizet count, void (*load)(const JsonDocument&, u32, T&, Allocator*), Allocator* allocator) {
+        u32 element = array + 1;
+        for (sizet i = 0; i < count; ++i) {
+            load(json, element, values[i], allocator);
+            element = json.tokens[element].next;
+        }
+    }
+
+    static void* allocate_and_zero(Allocator* allocator, sizet size)
+    {
+        if (size == 0) {
+            return nullptr;
         }
 
-        value = json_data.value(key, false);
+        void* result = allocator->allocate(size, 64);
+        memset(result, 0, size);
+
+        return result;
+    }
+
+    // Strings are not copied, the buffer points in the JSON text.
+    static void try_load_string(const JsonDocument& json, u32 object, cstring key, StringBuffer& string_buffer) {
+        const u32 token = json_find(json, object, key);
+        if (token == u32_max)
+            return;
+
+        string_buffer.data = json_string(json, token);
+        string_buffer.current_size = (u32)strlen(string_buffer.data);
+        string_buffer.buffer_size = string_buffer.current_size + 1;
+        string_buffer.allocator = nullptr;
+    }
+
+    static void try_load_int(const JsonDocument& json, u32 object, cstring key, i32& value) {
+        const u32 token = json_find(json, object, key);
+        value = token != u32_max ? json_int(json, token) : glTF::INVALID_INT_VALUE;
+    }
+
+    static void try_load_float(const JsonDocument& json, u32 object, cstring key, f32& value) {
+        const u32 token = json_find(json, object, key);
+        value = token != u32_max ? json_float(json, token) : glTF::INVALID_FLOAT_VALUE;
     }
 
-    static void try_load_type(json& json_data, cstring key, glTF::Accessor::Type& type) {
-        std::string value = json_data.value(key, "");
-        if (value == "SCALAR") {
+    static void try_load_bool(const JsonDocument& json, u32 object, cstring key, bool& value) {
+        const u32 token = json_find(json, object, key);
+        value = token != u32_max && json_string(json, token)[0] == 't';
+    }
+
+    static void try_load_type(const JsonDocument& json, u32 object, cstring key, glTF::Accessor::Type& type) {
+        const u32 token = json_find(json, object, key);
+        cstring value = token != u32_max ? json_string(json, token) : "";
+        if (strcmp(value, "SCALAR") == 0) {
             type = glTF::Accessor::Type::Scalar;
         }
-        else if (value == "VEC2") {
+        else if (strcmp(value, "VEC2") == 0) {
             type = glTF::Accessor::Type::Vec2;
         }
-        else if (value == "VEC3") {
+        else if (strcmp(value, "VEC3") == 0) {
             type = glTF::Accessor::Type::Vec3;
         }
-        else if (value == "VEC4") {
+        else if (strcmp(value, "VEC4") == 0) {
             type = glTF::Accessor::Type::Vec4;
         }
-        else if (value == "MAT2") {
+        else if (strcmp(value, "MAT2") == 0) {
             type = glTF::Accessor::Type::Mat2;
         }
-        else if (value == "MAT3") {
+        else if (strcmp(value, "MAT3") == 0) {
             type = glTF::Accessor::Type::Mat3;
         }
-        else if (value == "MAT4") {
+        else if (strcmp(value, "MAT4") == 0) {
             type = glTF::Accessor::Type::Mat4;
         }
         else {
@@ -90,266 +357,235 @@ namespace Engine
         }
     }
 
-    static void try_load_int_array(json& json_data, cstring key, u32& count, i32** array, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end()) {
+    static void try_load_int_array(const JsonDocument& json, u32 object, cstring key, u32& count, i32** array, Allocator* allocator) {
+        const u32 token = json_find(json, object, key);
+        if (token == u32_max) {
             count = 0;
             *array = nullptr;
             return;
         }
 
-        json json_array = json_data.at(key);
-
-        count = json_array.size();
+        count = json_count(json, token);
 
         i32* values = (i32*)allocate_and_zero(allocator, sizeof(i32) * count);
 
-        for (sizet i = 0; i < count; ++i) {
-            values[i] = json_array.at(i);
+        // Number elements have no children, they are the following tokens.
+        for (u32 i = 0; i < count; ++i) {
+            values[i] = json_int(json, token + 1 + i);
         }
 
         *array = values;
     }
 
-    static void try_load_float_array(json& json_data, cstring key, u32& count, float** array, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end()) {
+    static void try_load_float_array(const JsonDocument& json, u32 object, cstring key, u32& count, float** array, Allocator* allocator) {
+        const u32 token = json_find(json, object, key);
+        if (token == u32_max) {
             count = 0;
             *array = nullptr;
             return;
         }
 
-        json json_array = json_data.at(key);
-
-        count = json_array.size();
+        count = json_count(json, token);
 
         float* values = (float*)allocate_and_zero(allocator, sizeof(float) * count);
 
-        for (sizet i = 0; i < count; ++i) {
-            values[i] = json_array.at(i);
+        for (u32 i = 0; i < count; ++i) {
+            values[i] = json_float(json, token + 1 + i);
         }
 
         *array = values;
     }
 
-    static void load_asset(json& json_data, glTF::Asset& asset, Allocator* allocator) {
-        json json_asset = json_data["asset"];
-
-        try_load_string(json_asset, "copyright", asset.copyright, allocator);
-        try_load_string(json_asset, "generator", asset.generator, allocator);
-        try_load_string(json_asset, "minVersion", asset.minVersion, allocator);
-        try_load_string(json_asset, "version", asset.version, allocator);
+    static void load_asset(const JsonDocument& json, u32 json_asset, glTF::Asset& asset, Allocator* allocator) {
+        try_load_string(json, json_asset, "copyright", asset.copyright);
+        try_load_string(json, json_asset, "generator", asset.generator);
+        try_load_string(json, json_asset, "minVersion", asset.minVersion);
+        try_load_string(json, json_asset, "version", asset.version);
     }
 
-    static void load_scene(json& json_data, glTF::Scene& scene, Allocator* allocator) {
-        try_load_int_array(json_data, "nodes", scene.nodes_count, &scene.nodes, allocator);
+    static void load_scene(const JsonDocument& json, u32 json_data, glTF::Scene& scene, Allocator* allocator) {
+        try_load_int_array(json, json_data, "nodes", scene.nodes_count, &scene.nodes, allocator);
     }
 
-    static void load_scenes(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json scenes = json_data["scenes"];
-
-        sizet scene_count = scenes.size();
+    static void load_scenes(const JsonDocument& json, u32 scenes, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet scene_count = json_count(json, scenes);
         gltf_data.scenes = (glTF::Scene*)allocate_and_zero(allocator, sizeof(glTF::Scene) * scene_count);
         gltf_data.scenes_count = scene_count;
 
-        for (sizet i = 0; i < scene_count; ++i) {
-            load_scene(scenes[i], gltf_data.scenes[i], allocator);
-        }
+        load_array(json, scenes, gltf_data.scenes, scene_count, load_scene, allocator);
     }
 
-    static void load_buffer(json& json_data, glTF::Buffer& buffer, Allocator* allocator) {
-        try_load_string(json_data, "uri", buffer.uri, allocator);
-        try_load_int(json_data, "byteLength", buffer.byte_length);
-        try_load_string(json_data, "name", buffer.name, allocator);
+    static void load_buffer(const JsonDocument& json, u32 json_data, glTF::Buffer& buffer, Allocator* allocator) {
+        try_load_string(json, json_data, "uri", buffer.uri);
+        try_load_int(json, json_data, "byteLength", buffer.byte_length);
+        try_load_string(json, json_data, "name", buffer.name);
     }
 
-    static void load_buffers(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json buffers = json_data["buffers"];
-
-        sizet buffer_count = buffers.size();
+    static void load_buffers(const JsonDocument& json, u32 buffers, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet buffer_count = json_count(json, buffers);
         gltf_data.buffers = (glTF::Buffer*)allocate_and_zero(allocator, sizeof(glTF::Buffer) * buffer_count);
         gltf_data.buffers_count = buffer_count;
 
-        for (sizet i = 0; i < buffer_count; ++i) {
-            load_buffer(buffers[i], gltf_data.buffers[i], allocator);
-        }
+        load_array(json, buffers, gltf_data.buffers, buffer_count, load_buffer, allocator);
     }
 
-    static void load_buffer_view(json& json_data, glTF::BufferView& buffer_view, Allocator* allocator) {
-        try_load_int(json_data, "buffer", buffer_view.buffer);
-        try_load_int(json_data, "byteLength", buffer_view.byte_length);
-        try_load_int(json_data, "byteOffset", buffer_view.byte_offset);
-        try_load_int(json_data, "byteStride", buffer_view.byte_stride);
-        try_load_int(json_data, "target", buffer_view.target);
-        try_load_string(json_data, "name", buffer_view.name, allocator);
+    static void load_buffer_view(const JsonDocument& json, u32 json_data, glTF::BufferView& buffer_view, Allocator* allocator) {
+        try_load_int(json, json_data, "buffer", buffer_view.buffer);
+        try_load_int(json, json_data, "byteLength", buffer_view.byte_length);
+        try_load_int(json, json_data, "byteOffset", buffer_view.byte_offset);
+        try_load_int(json, json_data, "byteStride", buffer_view.byte_stride);
+        try_load_int(json, json_data, "target", buffer_view.target);
+        try_load_string(json, json_data, "name", buffer_view.name);
     }
 
-    static void load_buffer_views(json& json_data, glTF::glTF& gltf_data, Allocator* allocator)
+    static void load_buffer_views(const JsonDocument& json, u32 buffers, glTF::glTF& gltf_data, Allocator* allocator)
     {
-        json buffers = json_data["bufferViews"];
-
-        sizet buffer_count = buffers.size();
+        sizet buffer_count = json_count(json, buffers);
         gltf_data.buffer_views = (glTF::BufferView*)allocate_and_zero(allocator, sizeof(glTF::BufferView) * buffer_count);
         gltf_data.buffer_views_count = buffer_count;
 
-        for (sizet i = 0; i < buffer_count; ++i) {
-            load_buffer_view(buffers[i], gltf_data.buffer_views[i], allocator);
-        }
+        load_array_parallel(json, buffers, gltf_data.buffer_views, buffer_count, load_buffer_view, allocator);
     }
 
-    static void load_node(json& json_data, glTF::Node& node, Allocator* allocator) {
-        try_load_int(json_data, "camera", node.camera);
-        try_load_int(json_data, "mesh", node.mesh);
-        try_load_int(json_data, "skin", node.skin);
-        try_load_int_array(json_data, "children", node.children_count, &node.children, allocator);
-        try_load_float_array(json_data, "matrix", node.matrix_count, &node.matrix, allocator);
-        try_load_float_array(json_data, "rotation", node.rotation_count, &node.rotation, allocator);
-        try_load_float_array(json_data, "scale", node.scale_count, &node.scale, allocator);
-        try_load_float_array(json_data, "translation", node.translation_count, &node.translation, allocator);
-        try_load_float_array(json_data, "weights", node.weights_count, &node.weights, allocator);
-        try_load_string(json_data, "name", node.name, allocator);
+    static void load_node(const JsonDocument& json, u32 json_data, glTF::Node& node, Allocator* allocator) {
+        try_load_int(json, json_data, "camera", node.camera);
+        try_load_int(json, json_data, "mesh", node.mesh);
+        try_load_int(json, json_data, "skin", node.skin);
+        try_load_int_array(json, json_data, "children", node.children_count, &node.children, allocator);
+        try_load_float_array(json, json_data, "matrix", node.matrix_count, &node.matrix, allocator);
+        try_load_float_array(json, json_data, "rotation", node.rotation_count, &node.rotation, allocator);
+        try_load_float_array(json, json_data, "scale", node.scale_count, &node.scale, allocator);
+        try_load_float_array(json, json_data, "translation", node.translation_count, &node.translation, allocator);
+        try_load_float_array(json, json_data, "weights", node.weights_count, &node.weights, allocator);
+        try_load_string(json, json_data, "name", node.name);
     }
 
-    static void load_nodes(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["nodes"];
-
-        sizet array_count = array.size();
+    static void load_nodes(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.nodes = (glTF::Node*)allocate_and_zero(allocator, sizeof(glTF::Node) * array_count);
         gltf_data.nodes_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_node(array[i], gltf_data.nodes[i], allocator);
-        }
+        load_array_parallel(json, array, gltf_data.nodes, array_count, load_node, allocator);
     }
 
-    static void load_mesh_primitive(json& json_data, glTF::MeshPrimitive& mesh_primitive, Allocator* allocator) {
-        try_load_int(json_data, "indices", mesh_primitive.indices);
-        try_load_int(json_data, "material", mesh_primitive.material);
-        try_load_int(json_data, "mode", mesh_primitive.mode);
+    static void load_mesh_primitive(const JsonDocument& json, u32 json_data, glTF::MeshPrimitive& mesh_primitive, Allocator* allocator) {
+        try_load_int(json, json_data, "indices", mesh_primitive.indices);
+        try_load_int(json, json_data, "material", mesh_primitive.material);
+        try_load_int(json, json_data, "mode", mesh_primitive.mode);
 
-        json attributes = json_data["attributes"];
+        const u32 attributes = json_find(json, json_data, "attributes");
+        const u32 attribute_count = attributes != u32_max ? json.tokens[attributes].count / 2 : 0;
 
-        mesh_primitive.attributes = (glTF::MeshPrimitive::Attribute*)allocate_and_zero(allocator, sizeof(glTF::MeshPrimitive::Attribute) * attributes.size());
-        mesh_primitive.attribute_count = attributes.size();
+        mesh_primitive.attributes = (glTF::MeshPrimitive::Attribute*)allocate_and_zero(allocator, sizeof(glTF::MeshPrimitive::Attribute) * attribute_count);
+        mesh_primitive.attribute_count = attribute_count;
 
-        u32 index = 0;
-        for (auto json_attribute : attributes.items()) {
-            std::string key = json_attribute.key();
+        // Attribute values are accessor indices, keys and values alternate.
+        for (u32 index = 0; index < attribute_count; ++index) {
+            const u32 key = attributes + 1 + index * 2;
             glTF::MeshPrimitive::Attribute& attribute = mesh_primitive.attributes[index];
 
-            attribute.key.init(key.size() + 1, allocator);
-            attribute.key.append(key.c_str());
-
-            attribute.accessor_index = json_attribute.value();
+            attribute.key.data = json_string(json, key);
+            attribute.key.current_size = (u32)strlen(attribute.key.data);
+            attribute.key.buffer_size = attribute.key.current_size + 1;
+            attribute.key.allocator = nullptr;
 
-            ++index;
+            attribute.accessor_index = json_int(json, key + 1);
         }
     }
 
-    static void load_mesh_primitives(json& json_data, glTF::Mesh& mesh, Allocator* allocator) {
-        json array = json_data["primitives"];
-
-        sizet array_count = array.size();
+    static void load_mesh_primitives(const JsonDocument& json, u32 json_data, glTF::Mesh& mesh, Allocator* allocator) {
+        const u32 array = json_find(json, json_data, "primitives");
+        sizet array_count = array != u32_max ? json_count(json, array) : 0;
         mesh.primitives = (glTF::MeshPrimitive*)allocate_and_zero(allocator, sizeof(glTF::MeshPrimitive) * array_count);
         mesh.primitives_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_mesh_primitive(array[i], mesh.primitives[i], allocator);
-        }
+        load_array(json, array, mesh.primitives, array_count, load_mesh_primitive, allocator);
     }
 
-    static void load_mesh(json& json_data, glTF::Mesh& mesh, Allocator* allocator) {
-        load_mesh_primitives(json_data, mesh, allocator);
-        try_load_float_array(json_data, "weights", mesh.weights_count, &mesh.weights, allocator);
-        try_load_string(json_data, "name", mesh.name, allocator);
+    static void load_mesh(const JsonDocument& json, u32 json_data, glTF::Mesh& mesh, Allocator* allocator) {
+        load_mesh_primitives(json, json_data, mesh, allocator);
+        try_load_float_array(json, json_data, "weights", mesh.weights_count, &mesh.weights, allocator);
+        try_load_string(json, json_data, "name", mesh.name);
     }
 
-    static void load_meshes(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["meshes"];
-
-        sizet array_count = array.size();
+    static void load_meshes(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.meshes = (glTF::Mesh*)allocate_and_zero(allocator, sizeof(glTF::Mesh) * array_count);
         gltf_data.meshes_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_mesh(array[i], gltf_data.meshes[i], allocator);
-        }
+        load_array_parallel(json, array, gltf_data.meshes, array_count, load_mesh, allocator);
     }
 
-    static void load_accessor(json& json_data, glTF::Accessor& accessor, Allocator* allocator) {
-        try_load_int(json_data, "bufferView", accessor.buffer_view);
-        try_load_int(json_data, "byteOffset", accessor.byte_offset);
-        try_load_int(json_data, "componentType", accessor.component_type);
-        try_load_int(json_data, "count", accessor.count);
-        try_load_int(json_data, "sparse", accessor.sparse);
-        try_load_float_array(json_data, "max", accessor.max_count, &accessor.max, allocator);
-        try_load_float_array(json_data, "min", accessor.min_count, &accessor.min, allocator);
-        try_load_bool(json_data, "normalized", accessor.normalized);
-        try_load_type(json_data, "type", accessor.type);
+    static void load_accessor(const JsonDocument& json, u32 json_data, glTF::Accessor& accessor, Allocator* allocator) {
+        try_load_int(json, json_data, "bufferView", accessor.buffer_view);
+        try_load_int(json, json_data, "byteOffset", accessor.byte_offset);
+        try_load_int(json, json_data, "componentType", accessor.component_type);
+        try_load_int(json, json_data, "count", accessor.count);
+        try_load_int(json, json_data, "sparse", accessor.sparse);
+        try_load_float_array(json, json_data, "max", accessor.max_count, &accessor.max, allocator);
+        try_load_float_array(json, json_data, "min", accessor.min_count, &accessor.min, allocator);
+        try_load_bool(json, json_data, "normalized", accessor.normalized);
+        try_load_type(json, json_data, "type", accessor.type);
     }
 
-    static void load_accessors(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["accessors"];
-
-        sizet array_count = array.size();
+    static void load_accessors(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.accessors = (glTF::Accessor*)allocate_and_zero(allocator, sizeof(glTF::Accessor) * array_count);
         gltf_data.accessors_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_accessor(array[i], gltf_data.accessors[i], allocator);
-        }
+        load_array_parallel(json, array, gltf_data.accessors, array_count, load_accessor, allocator);
     }
 
-    static void try_load_TextureInfo(json& json_data, cstring key, glTF::TextureInfo** texture_info, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end()) {
+    static void try_load_TextureInfo(const JsonDocument& json, u32 json_data, cstring key, glTF::TextureInfo** texture_info, Allocator* allocator) {
+        const u32 it = json_find(json, json_data, key);
+        if (it == u32_max) {
             *texture_info = nullptr;
             return;
         }
 
         glTF::TextureInfo* ti = (glTF::TextureInfo*)allocator->allocate(sizeof(glTF::TextureInfo), 64);
 
-        try_load_int(*it, "index", ti->index);
-        try_load_int(*it, "texCoord", ti->texCoord);
+        try_load_int(json, it, "index", ti->index);
+        try_load_int(json, it, "texCoord", ti->texCoord);
 
         *texture_info = ti;
     }
 
-    static void try_load_MaterialNormalTextureInfo(json& json_data, cstring key, glTF::MaterialNormalTextureInfo** texture_info, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end()) {
+    static void try_load_MaterialNormalTextureInfo(const JsonDocument& json, u32 json_data, cstring key, glTF::MaterialNormalTextureInfo** texture_info, Allocator* allocator) {
+        const u32 it = json_find(json, json_data, key);
+        if (it == u32_max) {
             *texture_info = nullptr;
             return;
         }
 
         glTF::MaterialNormalTextureInfo* ti = (glTF::MaterialNormalTextureInfo*)allocator->allocate(sizeof(glTF::MaterialNormalTextureInfo), 64);
 
-        try_load_int(*it, "index", ti->index);
-        try_load_int(*it, "texCoord", ti->texcoord);
-        try_load_float(*it, "scale", ti->scale);
+        try_load_int(json, it, "index", ti->index);
+        try_load_int(json, it, "texCoord", ti->texcoord);
+        try_load_float(json, it, "scale", ti->scale);
 
         *texture_info = ti;
     }
 
-    static void try_load_MaterialOcclusionTextureInfo(json& json_data, cstring key, glTF::MaterialOcclusionTextureInfo** texture_info, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end()) {
+    static void try_load_MaterialOcclusionTextureInfo(const JsonDocument& json, u32 json_data, cstring key, glTF::MaterialOcclusionTextureInfo** texture_info, Allocator* allocator) {
+        const u32 it = json_find(json, json_data, key);
+        if (it == u32_max) {
             *texture_info = nullptr;
             return;
         }
 
         glTF::MaterialOcclusionTextureInfo* ti = (glTF::MaterialOcclusionTextureInfo*)allocator->allocate(sizeof(glTF::MaterialOcclusionTextureInfo), 64);
 
-        try_load_int(*it, "index", ti->index);
-        try_load_int(*it, "texCoord", ti->texcoord);
-        try_load_float(*it, "strength", ti->strength);
+        try_load_int(json, it, "index", ti->index);
+        try_load_int(json, it, "texCoord", ti->texcoord);
+        try_load_float(json, it, "strength", ti->strength);
 
         *texture_info = ti;
     }
 
-    static void try_load_MaterialPBRMetallicRoughness(json& json_data, cstring key, glTF::MaterialPBRMetallicRoughness** texture_info, Allocator* allocator) {
-        auto it = json_data.find(key);
-        if (it == json_data.end())
+    static void try_load_MaterialPBRMetallicRoughness(const JsonDocument& json, u32 json_data, cstring key, glTF::MaterialPBRMetallicRoughness** texture_info, Allocator* allocator) {
+        const u32 it = json_find(json, json_data, key);
+        if (it == u32_max)
         {
             *texture_info = nullptr;
             return;
@@ -357,179 +593,165 @@ namespace Engine
 
         glTF::MaterialPBRMetallicRoughness* ti = (glTF::MaterialPBRMetallicRoughness*)allocator->allocate(sizeof(glTF::MaterialPBRMetallicRoughness), 64);
 
-        try_load_float_array(*it, "baseColorFactor", ti->base_color_factor_count, &ti->base_color_factor, allocator);
-        try_load_TextureInfo(*it, "baseColorTexture", &ti->base_color_texture, allocator);
-        try_load_float(*it, "metallicFactor", ti->metallic_factor);
-        try_load_TextureInfo(*it, "metallicRoughnessTexture", &ti->metallic_roughness_texture, allocator);
-        try_load_float(*it, "roughnessFactor", ti->roughness_factor);
+        try_load_float_array(json, it, "baseColorFactor", ti->base_color_factor_count, &ti->base_color_factor, allocator);
+        try_load_TextureInfo(json, it, "baseColorTexture", &ti->base_color_texture, allocator);
+        try_load_float(json, it, "metallicFactor", ti->metallic_factor);
+        try_load_TextureInfo(json, it, "metallicRoughnessTexture", &ti->metallic_roughness_texture, allocator);
+        try_load_float(json, it, "roughnessFactor", ti->roughness_factor);
 
         *texture_info = ti;
     }
 
-    static void load_material(json& json_data, glTF::Material& material, Allocator* allocator) {
-        try_load_float_array(json_data, "emissiveFactor", material.emissive_factor_count, &material.emissive_factor, allocator);
-        try_load_float(json_data, "alphaCutoff", material.alpha_cutoff);
-        try_load_string(json_data, "alphaMode", material.alpha_mode, allocator);
-        try_load_bool(json_data, "doubleSided", material.double_sided);
+    static void load_material(const JsonDocument& json, u32 json_data, glTF::Material& material, Allocator* allocator) {
+        try_load_float_array(json, json_data, "emissiveFactor", material.emissive_factor_count, &material.emissive_factor, allocator);
+        try_load_float(json, json_data, "alphaCutoff", material.alpha_cutoff);
+        try_load_string(json, json_data, "alphaMode", material.alpha_mode);
+        try_load_bool(json, json_data, "doubleSided", material.double_sided);
 
-        try_load_TextureInfo(json_data, "emissiveTexture", &material.emissive_texture, allocator);
-        try_load_MaterialNormalTextureInfo(json_data, "normalTexture", &material.normal_texture, allocator);
-        try_load_MaterialOcclusionTextureInfo(json_data, "occlusionTexture", &material.occlusion_texture, allocator);
-        try_load_MaterialPBRMetallicRoughness(json_data, "pbrMetallicRoughness", &material.pbr_metallic_roughness, allocator);
+        try_load_TextureInfo(json, json_data, "emissiveTexture", &material.emissive_texture, allocator);
+        try_load_MaterialNormalTextureInfo(json, json_data, "normalTexture", &material.normal_texture, allocator);
+        try_load_MaterialOcclusionTextureInfo(json, json_data, "occlusionTexture", &material.occlusion_texture, allocator);
+        try_load_MaterialPBRMetallicRoughness(json, json_data, "pbrMetallicRoughness", &material.pbr_metallic_roughness, allocator);
 
-        try_load_string(json_data, "name", material.name, allocator);
+        try_load_string(json, json_data, "name", material.name);
     }
 
-    static void load_materials(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["materials"];
-
-        sizet array_count = array.size();
+    static void load_materials(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.materials = (glTF::Material*)allocate_and_zero(allocator, sizeof(glTF::Material) * array_count);
         gltf_data.materials_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_material(array[i], gltf_data.materials[i], allocator);
-        }
+        load_array_parallel(json, array, gltf_data.materials, array_count, load_material, allocator);
     }
 
-    static void load_texture(json& json_data, glTF::Texture& texture, Allocator* allocator) {
-        try_load_int(json_data, "sampler", texture.sampler);
-        try_load_int(json_data, "source", texture.source);
-        try_load_string(json_data, "name", texture.name, allocator);
+    static void load_texture(const JsonDocument& json, u32 json_data, glTF::Texture& texture, Allocator* allocator) {
+        try_load_int(json, json_data, "sampler", texture.sampler);
+        try_load_int(json, json_data, "source", texture.source);
+        try_load_string(json, json_data, "name", texture.name);
     }
 
-    static void load_textures(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["textures"];
-
-        sizet array_count = array.size();
+    static void load_textures(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.textures = (glTF::Texture*)allocate_and_zero(allocator, sizeof(glTF::Texture) * array_count);
         gltf_data.textures_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_texture(array[i], gltf_data.textures[i], allocator);
-        }
+        load_array(json, array, gltf_data.textures, array_count, load_texture, allocator);
     }
 
-    static void load_image(json& json_data, glTF::Image& image, Allocator* allocator) {
-        try_load_int(json_data, "bufferView", image.buffer_view);
-        try_load_string(json_data, "mimeType", image.mime_type, allocator);
-        try_load_string(json_data, "uri", image.uri, allocator);
+    static void load_image(const JsonDocument& json, u32 json_data, glTF::Image& image, Allocator* allocator) {
+        try_load_int(json, json_data, "bufferView", image.buffer_view);
+        try_load_string(json, json_data, "mimeType", image.mime_type);
+        try_load_string(json, json_data, "uri", image.uri);
     }
 
-    static void load_images(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["images"];
-
-        sizet array_count = array.size();
+    static void load_images(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.images = (glTF::Image*)allocate_and_zero(allocator, sizeof(glTF::Image) * array_count);
         gltf_data.images_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_image(array[i], gltf_data.images[i], allocator);
-        }
+        load_array(json, array, gltf_data.images, array_count, load_image, allocator);
     }
 
-    static void load_sampler(json& json_data, glTF::Sampler& sampler, Allocator* allocator) {
-        try_load_int(json_data, "magFilter", sampler.mag_filter);
-        try_load_int(json_data, "minFilter", sampler.min_filter);
-        try_load_int(json_data, "wrapS", sampler.wrap_s);
-        try_load_int(json_data, "wrapT", sampler.wrap_t);
+    static void load_sampler(const JsonDocument& json, u32 json_data, glTF::Sampler& sampler, Allocator* allocator) {
+        try_load_int(json, json_data, "magFilter", sampler.mag_filter);
+        try_load_int(json, json_data, "minFilter", sampler.min_filter);
+        try_load_int(json, json_data, "wrapS", sampler.wrap_s);
+        try_load_int(json, json_data, "wrapT", sampler.wrap_t);
     }
 
-    static void load_samplers(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["samplers"];
-
-        sizet array_count = array.size();
+    static void load_samplers(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.samplers = (glTF::Sampler*)allocate_and_zero(allocator, sizeof(glTF::Sampler) * array_count);
         gltf_data.samplers_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_sampler(array[i], gltf_data.samplers[i], allocator);
-        }
+        load_array(json, array, gltf_data.samplers, array_count, load_sampler, allocator);
     }
 
-    static void load_skin(json& json_data, glTF::Skin& skin, Allocator* allocator) {
-        try_load_int(json_data, "skeleton", skin.skeleton_root_node_index);
-        try_load_int(json_data, "inverseBindMatrices", skin.inverse_bind_matrices_buffer_index);
-        try_load_int_array(json_data, "joints", skin.joints_count, &skin.joints, allocator);
+    static void load_skin(const JsonDocument& json, u32 json_data, glTF::Skin& skin, Allocator* allocator) {
+        try_load_int(json, json_data, "skeleton", skin.skeleton_root_node_index);
+        try_load_int(json, json_data, "inverseBindMatrices", skin.inverse_bind_matrices_buffer_index);
+        try_load_int_array(json, json_data, "joints", skin.joints_count, &skin.joints, allocator);
     }
 
-    static void load_skins(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["skins"];
-
-        sizet array_count = array.size();
+    static void load_skins(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.skins = (glTF::Skin*)allocate_and_zero(allocator, sizeof(glTF::Skin) * array_count);
         gltf_data.skins_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_skin(array[i], gltf_data.skins[i], allocator);
-        }
+        load_array(json, array, gltf_data.skins, array_count, load_skin, allocator);
     }
 
-    static void load_animation(json& json_data, glTF::Animation& animation, Allocator* allocator) {
+    static void load_animation(const JsonDocument& json, u32 json_data, glTF::Animation& animation, Allocator* allocator) {
 
-        json json_array = json_data.at("samplers");
-        if (json_array.is_array()) {
-            sizet count = json_array.size();
+        u32 json_array = json_find(json, json_data, "samplers");
+        if (json_array != u32_max && json.tokens[json_array].type == JsonType_Array) {
+            sizet count = json_count(json, json_array);
 
             glTF::AnimationSampler* values = (glTF::AnimationSampler*)allocate_and_zero(allocator, sizeof(glTF::AnimationSampler) * count);
 
+            u32 element = json_array + 1;
             for (sizet i = 0; i < count; ++i) {
-                json element = json_array.at(i);
                 glTF::AnimationSampler& sampler = values[i];
 
-                try_load_int(element, "input", sampler.input_keyframe_buffer_index);
-                try_load_int(element, "output", sampler.output_keyframe_buffer_index);
+                try_load_int(json, element, "input", sampler.input_keyframe_buffer_index);
+                try_load_int(json, element, "output", sampler.output_keyframe_buffer_index);
 
-                std::string value = element.value("interpolation", "");
-                if (value == "LINEAR") {
+                const u32 interpolation = json_find(json, element, "interpolation");
+                cstring value = interpolation != u32_max ? json_string(json, interpolation) : "";
+                if (strcmp(value, "LINEAR") == 0) {
                     sampler.interpolation = glTF::AnimationSampler::Linear;
                 }
-                else if (value == "STEP") {
+                else if (strcmp(value, "STEP") == 0) {
                     sampler.interpolation = glTF::AnimationSampler::Step;
                 }
-                else if (value == "CUBICSPLINE") {
+                else if (strcmp(value, "CUBICSPLINE") == 0) {
                     sampler.interpolation = glTF::AnimationSampler::CubicSpline;
                 }
                 else {
                     sampler.interpolation = glTF::AnimationSampler::Linear;
                 }
+
+                element = json.tokens[element].next;
             }
 
             animation.samplers = values;
             animation.samplers_count = count;
         }
 
-        json_array = json_data.at("channels");
-        if (json_array.is_array()) {
-            sizet count = json_array.size();
+        json_array = json_find(json, json_data, "channels");
+        if (json_array != u32_max && json.tokens[json_array].type == JsonType_Array) {
+            sizet count = json_count(json, json_array);
 
             glTF::AnimationChannel* values = (glTF::AnimationChannel*)allocate_and_zero(allocator, sizeof(glTF::AnimationChannel) * count);
 
+            u32 element = json_array + 1;
             for (sizet i = 0; i < count; ++i) {
-                json element = json_array.at(i);
                 glTF::AnimationChannel& channel = values[i];
 
-                try_load_int(element, "sampler", channel.sampler);
-                json target = element.at("target");
-                try_load_int(target, "node", channel.target_node);
+                try_load_int(json, element, "sampler", channel.sampler);
+                const u32 target = json_find(json, element, "target");
+                try_load_int(json, target, "node", channel.target_node);
 
-                std::string target_path = target.value("path", "");
-                if (target_path == "scale") {
+                const u32 path = target != u32_max ? json_find(json, target, "path") : u32_max;
+                cstring target_path = path != u32_max ? json_string(json, path) : "";
+                if (strcmp(target_path, "scale") == 0) {
                     channel.target_type = glTF::AnimationChannel::Scale;
                 }
-                else if (target_path == "rotation") {
+                else if (strcmp(target_path, "rotation") == 0) {
                     channel.target_type = glTF::AnimationChannel::Rotation;
                 }
-                else if (target_path == "translation") {
+                else if (strcmp(target_path, "translation") == 0) {
                     channel.target_type = glTF::AnimationChannel::Translation;
                 }
-                else if (target_path == "weights") {
+                else if (strcmp(target_path, "weights") == 0) {
                     channel.target_type = glTF::AnimationChannel::Weights;
                 }
                 else {
-                    RASSERTM(false, "Error parsing target path %s\n", target_path.c_str());
+                    RASSERTM(false, "Error parsing target path %s\n", target_path);
                     channel.target_type = glTF::AnimationChannel::Count;
                 }
+
+                element = json.tokens[element].next;
             }
 
             animation.channels = values;
@@ -537,98 +759,234 @@ namespace Engine
         }
     }
 
-    static void load_animations(json& json_data, glTF::glTF& gltf_data, Allocator* allocator) {
-        json array = json_data["animations"];
-
-        sizet array_count = array.size();
+    static void load_animations(const JsonDocument& json, u32 array, glTF::glTF& gltf_data, Allocator* allocator) {
+        sizet array_count = json_count(json, array);
         gltf_data.animations = (glTF::Animation*)allocate_and_zero(allocator, sizeof(glTF::Animation) * array_count);
         gltf_data.animations_count = array_count;
 
-        for (sizet i = 0; i < array_count; ++i) {
-            load_animation(array[i], gltf_data.animations[i], allocator);
+        load_array(json, array, gltf_data.animations, array_count, load_animation, allocator);
+    }
+
+    // Upper bound of the memory the loaders take from the scene allocator: every object token can be
+    // a glTF struct, every string an attribute, every number a float, plus alignment for each container.
+    static sizet gltf_allocation_size(const JsonDocument& json) {
+        static const sizet k_struct_sizes[] = {
+            sizeof(glTF::Scene), sizeof(glTF::Buffer), sizeof(glTF::BufferView), sizeof(glTF::Node), sizeof(glTF::MeshPrimitive), sizeof(glTF::Mesh),
+            sizeof(glTF::Accessor), sizeof(glTF::TextureInfo), sizeof(glTF::MaterialNormalTextureInfo), sizeof(glTF::MaterialOcclusionTextureInfo),
+            sizeof(glTF::MaterialPBRMetallicRoughness), sizeof(glTF::Material), sizeof(glTF::Texture), sizeof(glTF::Image), sizeof(glTF::Sampler),
+            sizeof(glTF::Skin), sizeof(glTF::Animation), sizeof(glTF::AnimationSampler), sizeof(glTF::AnimationChannel) };
+
+        sizet max_struct_size = 0;
+        for (u32 i = 0; i < ArraySize(k_struct_sizes); ++i) {
+            max_struct_size = max(max_struct_size, k_struct_sizes[i]);
         }
+
+        static const sizet k_alignment = 64;
+
+        sizet size = 0;
+        for (u32 t = 0; t < json.tokens.size; ++t) {
+            switch (json.tokens[t].type) {
+                case JsonType_Object: size += max_struct_size + k_alignment; break;
+                case JsonType_Array: size += k_alignment; break;
+                case JsonType_String: size += sizeof(glTF::MeshPrimitive::Attribute); break;
+                case JsonType_Primitive: size += sizeof(f32); break;
+            }
+        }
+
+        return size + k_alignment;
     }
 
-    glTF::glTF gltf_load_file(cstring file_path)
-    {
-        glTF::glTF result{ };
+    // GLB container ////////////////////////////////////////////////////////
+
+    static const u32 k_glb_magic = 0x46546C67;         // 'glTF'
+    static const u32 k_glb_version = 2;
+    static const u32 k_glb_chunk_json = 0x4E4F534A;    // 'JSON'
+    static const u32 k_glb_chunk_bin = 0x004E4942;     // 'BIN'
+
+    struct GlbHeader {
+        u32 magic;
+        u32 version;
+        u32 length;
+    };
+
+    struct GlbChunkHeader {
+        u32 length;
+        u32 type;
+    };
+
+    //
+    // Finds the JSON and the optional binary chunk of a .glb file, returns false if it is malformed.
+    static bool glb_read_chunks(u8* data, sizet size, char** json_text, sizet* json_length, u8** binary_chunk, sizet* binary_chunk_size) {
+        if (size < sizeof(GlbHeader) + sizeof(GlbChunkHeader)) {
+            return false;
+        }
 
-        if (!file_exists(file_path))
-        {
-            rprint("Error: file %s does not exists.\n", file_path);
-            return result;
+        const GlbHeader* header = (const GlbHeader*)data;
+        if (header->version != k_glb_version || header->length > size) {
+            return false;
+        }
+
+        *json_text = nullptr;
+        *binary_chunk = nullptr;
+        *binary_chunk_size = 0;
+
+        // Chunks are 4 bytes aligned, JSON comes first and is padded with spaces.
+        sizet offset = sizeof(GlbHeader);
+        while (offset + sizeof(GlbChunkHeader) <= header->length) {
+            const GlbChunkHeader* chunk = (const GlbChunkHeader*)(data + offset);
+            offset += sizeof(GlbChunkHeader);
+            if (chunk->length > header->length - offset) {
+                return false;
+            }
+
+            if (chunk->type == k_glb_chunk_json && *json_text == nullptr) {
+                *json_text = (char*)(data + offset);
+                *json_length = chunk->length;
+            }
+            else if (chunk->type == k_glb_chunk_bin && *binary_chunk == nullptr) {
+                *binary_chunk = data + offset;
+                *binary_chunk_size = chunk->length;
+            }
+
+            offset += (chunk->length + 3) & ~3u;
         }
 
+        return *json_text != nullptr;
+    }
+
+    static bool gltf_parse_json(char* text, sizet length, glTF::glTF& result)
+    {
         Allocator* heap_allocator = &MemoryService::instance()->system_allocator;
 
-        FileReadResult read_result = file_read_text( file_path, heap_allocator );
+        JsonDocument json{ text, { } };
+        json.tokens.init( heap_allocator, (u32)( length / 8 ) + 16 );
+
+        if ( !json_tokenize( json.text, length, json.tokens, heap_allocator ) || json.tokens[ 0 ].type != JsonType_Object )
+        {
+            json.tokens.shutdown();
+            return false;
+        }
 
-        json gltf_data = json::parse( read_result.data );
+        result.allocator.init( gltf_allocation_size( json ) );
 
-        result.allocator.init( rmega(2) );
-        Allocator* allocator = &result.allocator;
+        GltfSharedAllocator shared_allocator;
+        shared_allocator.allocator = &result.allocator;
+        Allocator* allocator = &shared_allocator;
 
-        for (auto properties : gltf_data.items())
+        // Root members are visited once, in file order.
+        const JsonToken& root = json.tokens[ 0 ];
+        u32 key_token = 1;
+        for ( u32 member = 0; member < root.count / 2; ++member )
         {
-            if ( properties.key() == "asset" )
+            cstring key = json_string( json, key_token );
+            const u32 value = key_token + 1;
+
+            if ( strcmp( key, "asset" ) == 0 )
             {
-                load_asset(gltf_data, result.asset, allocator);
+                load_asset( json, value, result.asset, allocator );
             }
-            else if ( properties.key() == "scene" )
+            else if ( strcmp( key, "scene" ) == 0 )
             {
-                try_load_int(gltf_data, "scene", result.scene);
+                result.scene = json_int( json, value );
             }
-            else if ( properties.key() == "scenes" )
+            else if ( strcmp( key, "scenes" ) == 0 )
             {
-                load_scenes(gltf_data, result, allocator);
+                load_scenes( json, value, result, allocator );
             }
-            else if ( properties.key() == "buffers" )
+            else if ( strcmp( key, "buffers" ) == 0 )
             {
-                load_buffers(gltf_data, result, allocator);
+                load_buffers( json, value, result, allocator );
             }
-            else if ( properties.key() == "bufferViews" )
+            else if ( strcmp( key, "bufferViews" ) == 0 )
             {
-                load_buffer_views(gltf_data, result, allocator);
+                load_buffer_views( json, value, result, allocator );
             }
-            else if ( properties.key() == "nodes" )
+            else if ( strcmp( key, "nodes" ) == 0 )
             {
-                load_nodes(gltf_data, result, allocator);
+                load_nodes( json, value, result, allocator );
             }
-            else if ( properties.key() == "meshes" )
+            else if ( strcmp( key, "meshes" ) == 0 )
             {
-                load_meshes(gltf_data, result, allocator);
+                load_meshes( json, value, result, allocator );
             }
-            else if ( properties.key() == "accessors" )
+            else if ( strcmp( key, "accessors" ) == 0 )
             {
-                load_accessors( gltf_data, result, allocator );
+                load_accessors( json, value, result, allocator );
             }
-            else if ( properties.key() == "materials" )
+            else if ( strcmp( key, "materials" ) == 0 )
             {
-                load_materials( gltf_data, result, allocator );
+                load_materials( json, value, result, allocator );
             }
-            else if ( properties.key() == "textures" )
+            else if ( strcmp( key, "textures" ) == 0 )
             {
-                load_textures( gltf_data, result, allocator );
+                load_textures( json, value, result, allocator );
             }
-            else if ( properties.key() == "images" )
+            else if ( strcmp( key, "images" ) == 0 )
             {
-                load_images( gltf_data, result, allocator );
+                load_images( json, value, result, allocator );
             }
-            else if ( properties.key() == "samplers" )
+            else if ( strcmp( key, "samplers" ) == 0 )
             {
-                load_samplers( gltf_data, result, allocator );
+                load_samplers( json, value, result, allocator );
             }
-            else if ( properties.key() == "skins" )
+            else if ( strcmp( key, "skins" ) == 0 )
             {
-                load_skins( gltf_data, result, allocator );
+                load_skins( json, value, result, allocator );
             }
-            else if ( properties.key() == "animations" )
+            else if ( strcmp( key, "animations" ) == 0 )
             {
-                load_animations( gltf_data, result, allocator );
+                load_animations( json, value, result, allocator );
             }
+
+            key_token = json.tokens[ value ].next;
+        }
+
+        json.tokens.shutdown();
+
+        return true;
+    }
+
+    glTF::glTF gltf_load_file(cstring file_path)
+    {
+        glTF::glTF result{ };
+
+        if (!file_exists(file_path))
+        {
+            rprint("Error: file %s does not exists.\n", file_path);
+            return result;
         }
 
-        heap_allocator->deallocate(read_result.data);
+        // One read for the whole file, kept with the scene as strings and buffers point in it.
+        FileReadResult read_result = file_read_binary( file_path, &MemoryService::instance()->system_allocator );
+        result.file_data = read_result.data;
+
+        char* json_text = read_result.data;
+        sizet json_length = read_result.size;
+        u8* binary_chunk = nullptr;
+        sizet binary_chunk_size = 0;
+
+        const bool is_glb = read_result.size >= sizeof( GlbHeader ) && ( ( const GlbHeader* )read_result.data )->magic == k_glb_magic;
+        if ( is_glb && !glb_read_chunks( ( u8* )read_result.data, read_result.size, &json_text, &json_length, &binary_chunk, &binary_chunk_size ) )
+        {
+            rprint("Error: file %s is not a valid glb.\n", file_path);
+            return result;
+        }
+
+        if ( !gltf_parse_json( json_text, json_length, result ) )
+        {
+            rprint("Error: file %s is not valid JSON.\n", file_path);
+            return result;
+        }
+
+        // The binary chunk is the first buffer, the only one without uri.
+        for ( u32 buffer_index = 0; buffer_index < result.buffers_count; ++buffer_index )
+        {
+            glTF::Buffer& buffer = result.buffers[ buffer_index ];
+            if ( buffer.uri.data == nullptr && binary_chunk && buffer.byte_length >= 0 && ( sizet )buffer.byte_length <= binary_chunk_size )
+            {
+                buffer.data = binary_chunk;
+            }
+        }
 
         return result;
     }
@@ -636,6 +994,11 @@ namespace Engine
     void gltf_free(glTF::glTF& scene)
     {
         scene.allocator.shutdown();
+
+        if (scene.file_data) {
+            MemoryService::instance()->system_allocator.deallocate(scene.file_data);
+            scene.file_data = nullptr;
+        }
     }
 
     i32 gltf_get_attribute_accessor_index(glTF::MeshPrimitive::Attribute* attributes, u32 attribute_count, cstring attribute_name)
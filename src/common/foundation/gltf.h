@@ -284,6 +284,7 @@ namespace Engine
 			i32								byte_length;
 			StringBuffer					uri;
 			StringBuffer					name;
+			u8*								data;			// Binary chunk of a .glb file for the buffer without uri, nullptr otherwise.
 		};
 
 		struct CameraPerspective
@@ -375,6 +376,7 @@ namespace Engine
 			Texture*						textures;
 
 			LinearAllocator					allocator;
+			char*							file_data;		// Whole .gltf or .glb file, parsed in place. Strings and buffer data point in it. Released by gltf_free.
 		};
 
 
@@ -382,6 +384,7 @@ namespace Engine
 
 	} // namespace glTF
 
+	// Loads .gltf and binary .glb files, both with a single read.
 	glTF::glTF								gltf_load_file( cstring file_path );
 
 	void									gltf_free( glTF::glTF& scene );
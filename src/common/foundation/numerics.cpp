@@ -63,6 +63,69 @@ namespace Engine
 	hy_math_func_f32_f64( INT32_MAX, i32, round )
 	hy_math_func_f32_f64( INT16_MAX, i16, round )
 
+	// Vertex packing
+	u16 float_to_half( f32 value )
+	{
+		// Rounding is done by the float unit: denormals are aligned with a magic add,
+		// normals get the rounding bias added to the bits before dropping 13 mantissa bits.
+		union { u32 u; f32 f; } bits, infinity, half_max, denormal_magic;
+		infinity.u = 255 << 23;
+		half_max.u = ( 127 + 16 ) << 23;
+		denormal_magic.u = ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23;
+
+		bits.f = value;
+		const u32 sign = bits.u & 0x80000000u;
+		bits.u ^= sign;
+
+		u16 half;
+		if ( bits.u >= half_max.u )
+		{
+			half = bits.u > infinity.u ? 0x7e00 : 0x7c00;
+		}
+		else if ( bits.u < ( 113 << 23 ) )
+		{
+			bits.f += denormal_magic.f;
+			half = ( u16 )( bits.u - denormal_magic.u );
+		}
+		else
+		{
+			const u32 mantissa_odd = ( bits.u >> 13 ) & 1;
+			bits.u += ( ( u32 )( 15 - 127 ) << 23 ) + 0xfff + mantissa_odd;
+			half = ( u16 )( bits.u >> 13 );
+		}
+
+		return half | ( u16 )( sign >> 16 );
+	}
+
+	i16 float_to_snorm16( f32 value )
+	{
+		return roundi16( clamp( value, -1.f, 1.f ) * 32767.f );
+	}
+
+	void octahedral_encode( f32 x, f32 y, f32 z, f32* out_uv )
+	{
+		const f32 l1_norm = fabsf( x ) + fabsf( y ) + fabsf( z );
+		if ( l1_norm == 0.f )
+		{
+			out_uv[ 0 ] = out_uv[ 1 ] = 0.f;
+			return;
+		}
+
+		f32 u = x / l1_norm;
+		f32 v = y / l1_norm;
+		// Lower hemisphere is folded over the diagonals.
+		if ( z < 0.f )
+		{
+			const f32 folded_u = ( 1.f - fabsf( v ) ) * ( u >= 0.f ? 1.f : -1.f );
+			const f32 folded_v = ( 1.f - fabsf( u ) ) * ( v >= 0.f ? 1.f : -1.f );
+			u = folded_u;
+			v = folded_v;
+		}
+
+		out_uv[ 0 ] = u;
+		out_uv[ 1 ] = v;
+	}
+
 	f32 get_random_value( f32 min, f32 max )
 	{
 		RASSERT( min < max );
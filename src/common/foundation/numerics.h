@@ -32,6 +32,11 @@ namespace Engine
     i16                             roundi16(f32 value);
     i16                             roundi16(f64 value);
 
+    // Vertex packing /////////////////////////////////////////////////////////////////////////////
+    u16                             float_to_half( f32 value );                 // IEEE half, round to nearest even.
+    i16                             float_to_snorm16( f32 value );              // Clamps to [ -1, 1 ].
+    // Maps a non zero direction to the [ -1, 1 ] square of the octahedral parametrization.
+    void                            octahedral_encode( f32 x, f32 y, f32 z, f32* out_uv );
 
     f32                             get_random_value( f32 min, f32 max );
 
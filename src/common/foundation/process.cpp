@@ -1,13 +1,26 @@
 #include "process.h"
 #include "log.h"
+#include "assert.h"
 
 #include <stdio.h>
+#include <string.h>
 
 #if defined(_WIN64)
 #define Win32_LEAN_AND_MEAN
 #include <Windows.h>
 #else
-#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+// Spawn file actions can change the child working directory on glibc 2.29+ and macOS, elsewhere the child is forked.
+#if defined( __APPLE__ ) || ( defined( __GLIBC__ ) && ( __GLIBC__ > 2 || ( __GLIBC__ == 2 && __GLIBC_MINOR__ >= 29 ) ) )
+#define ENGINE_SPAWN_ADDCHDIR
+#endif
+
+extern char** environ;
 #endif
 
 namespace Engine
@@ -17,9 +30,33 @@ namespace Engine
 	char				s_process_log_buffer[ k_process_log_buffer ];
 	static char			k_process_output_buffer[ 1024 ];
 
+	bool process_execute( cstring working_directory, cstring process_fullpath, cstring arguments, cstring search_error_string )
+	{
+		Process process;
+		if ( !process_spawn( process, working_directory, process_fullpath, arguments ) )
+		{
+			return false;
+		}
+
+		const i32 exit_code = process_wait( process, k_process_output_buffer, ArraySize( k_process_output_buffer ) );
+		rprint( "%s\n", k_process_output_buffer );
+
+		bool execution_success = exit_code == 0;
+		if ( strlen( search_error_string ) > 0 && strstr( k_process_output_buffer, search_error_string ) )
+		{
+			execution_success = false;
+		}
+
+		return execution_success;
+	}
+
+	cstring process_get_output()
+	{
+		return k_process_output_buffer;
+	}
+
 #if defined( _WIN64 )
 
-	
 	void win32_get_error( char* buffer, u32 size )
 	{
 		DWORD errorCode = GetLastError();
@@ -36,170 +73,245 @@ namespace Engine
 		LocalFree( error_string );
 	}
 
-	bool process_execute( cstring working_directory, cstring process_fullpath, cstring arguments, cstring search_error_string )
+	bool process_spawn( Process& process, cstring working_directory, cstring process_fullpath, cstring arguments )
 	{
 		// From the post in https://stackoverflow.com/questions/35969730/how-to-read-output-from-cmd-exe-using-createprocess-and-createpipe/55718264#55718264
-		// Create pipes for redirecting output
-		HANDLE handle_stdin_pipe_read	= NULL;
-		HANDLE handle_stdin_pipe_write	= NULL;
+		// Create pipe for redirecting output
 		HANDLE handle_stdout_pipe_read	= NULL;
 		HANDLE handle_std_pipe_write	= NULL;
 
 		SECURITY_ATTRIBUTES security_attributes = { sizeof( SECURITY_ATTRIBUTES ), NULL, TRUE };
 
-		BOOL ok = CreatePipe( &handle_stdin_pipe_read, &handle_stdin_pipe_write, &security_attributes, 0 );
-		if( ok == FALSE )
+		BOOL ok = CreatePipe( &handle_stdout_pipe_read, &handle_std_pipe_write, &security_attributes, 0 );
+		if ( ok == FALSE )
 			return false;
 
-		ok = CreatePipe( &handle_stdout_pipe_read, &handle_std_pipe_write, &security_attributes, 0 );
-		if (ok == FALSE)
-			return false;
+		// Only the write end goes to the child, processes spawned later must not inherit the read end.
+		SetHandleInformation( handle_stdout_pipe_read, HANDLE_FLAG_INHERIT, 0 );
 
 		// Create startup informations with std redirection.
 		STARTUPINFOA startup_info	= {};
 		startup_info.cb				= sizeof( startup_info );
 		startup_info.dwFlags		= STARTF_USESHOWWINDOW | STARTF_USESTDHANDLES;
-		startup_info.hStdInput		= handle_stdin_pipe_read;
+		startup_info.hStdInput		= GetStdHandle( STD_INPUT_HANDLE );
 		startup_info.hStdError		= handle_std_pipe_write;
 		startup_info.hStdOutput		= handle_std_pipe_write;
 		startup_info.wShowWindow	= SW_SHOW;
 
-		bool execution_success = false;
 		// Execute the process
 		PROCESS_INFORMATION process_info = {};
 		BOOL inherit_handles = TRUE;
-		if ( CreateProcessA( process_fullpath, (char*)arguments, 0, 0, inherit_handles, 0, 0, working_directory, &startup_info, &process_info ) )
-		{
-
-			CloseHandle( process_info.hThread );
-			CloseHandle( process_info.hProcess );
-
-			execution_success = true;
-		}
-		else
+		if ( !CreateProcessA( process_fullpath, (char*)arguments, 0, 0, inherit_handles, 0, 0, working_directory, &startup_info, &process_info ) )
 		{
 			win32_get_error( &s_process_log_buffer[0], k_process_log_buffer );
 
 			rprint("Execute process error.\n Exe: \"%s\" - Args: \"%s\" - Work_dir: \"%s\"\n", process_fullpath, arguments, working_directory);
 			rprint("Message: %s\n", s_process_log_buffer);
+
+			CloseHandle( handle_stdout_pipe_read );
+			CloseHandle( handle_std_pipe_write );
+			return false;
 		}
 
-		CloseHandle(handle_stdin_pipe_read);
-		CloseHandle(handle_std_pipe_write);
+		CloseHandle( process_info.hThread );
+		// Close the parent copy of the write end, so reads end when the child exits.
+		CloseHandle( handle_std_pipe_write );
 
-		// Output.
-		DWORD bytes_read;
-		ok = ReadFile( handle_stdout_pipe_read, k_process_output_buffer, 1024, &bytes_read ,nullptr );
+		process.process_handle = process_info.hProcess;
+		process.output_pipe = handle_stdout_pipe_read;
 
-		// Consume all outputs.
-		// Terminate current read and initialize the next.
-		while ( ok == TRUE )
-		{
-			k_process_output_buffer[ bytes_read ] = 0;
-			rprint( "%s", k_process_output_buffer );
+		return true;
+	}
 
-			ok = ReadFile( handle_stdout_pipe_read, k_process_output_buffer, 1024, &bytes_read, nullptr );
+	i32 process_wait( Process& process, char* output, u32 output_size )
+	{
+		if ( !process.process_handle )
+		{
+			return -1;
 		}
 
-		if ( strlen( search_error_string ) > 0 && strstr( k_process_output_buffer, search_error_string ) )
+		// Consume all outputs, keeping what fits in the buffer.
+		u32 output_length = 0;
+		char read_buffer[ 1024 ];
+		DWORD bytes_read;
+		while ( ReadFile( process.output_pipe, read_buffer, sizeof( read_buffer ), &bytes_read, nullptr ) == TRUE && bytes_read > 0 )
 		{
-			execution_success = false;
+			const u32 copy_size = output_length + bytes_read < output_size ? bytes_read : output_size - output_length - 1;
+			memcpy( output + output_length, read_buffer, copy_size );
+			output_length += copy_size;
 		}
+		output[ output_length ] = 0;
 
-		rprint( "\n" );
-
-		// Close handles.
-		CloseHandle( handle_stdout_pipe_read );
-		CloseHandle( handle_stdin_pipe_write );
+		WaitForSingleObject( process.process_handle, INFINITE );
 
 		DWORD process_exit_code = 0;
-		GetExitCodeProcess( process_info.hProcess, &process_exit_code );
+		GetExitCodeProcess( process.process_handle, &process_exit_code );
 
-		return execution_success;
+		// Close handles.
+		CloseHandle( process.output_pipe );
+		CloseHandle( process.process_handle );
+		process.output_pipe = nullptr;
+		process.process_handle = nullptr;
+
+		return ( i32 )process_exit_code;
 	}
 
-	cstring process_get_output()
+	u32 process_get_id()
 	{
-		return k_process_output_buffer;
+		return ( u32 )GetCurrentProcessId();
 	}
 
 #else
 
-	bool process_execute(cstring working_directory, cstring process_fullpath, cstring arguments, cstring search_error_string)
+	bool process_spawn( Process& process, cstring working_directory, cstring process_fullpath, cstring arguments )
 	{
-		char current_dir[4096];
-		getcwd(current_dir, 4096);
-
-		int result = chdir(working_directory);
-		RASSERT(result == 0);
+		// Split arguments on spaces, honouring double quotes. Executable path is argv[0].
+		static const u32 k_max_arguments = 64;
+		char arguments_copy[ 4096 ];
+		char* argv[ k_max_arguments + 2 ];
+		u32 argc = 0;
+
+		strncpy( arguments_copy, arguments, sizeof( arguments_copy ) - 1 );
+		arguments_copy[ sizeof( arguments_copy ) - 1 ] = 0;
+
+		argv[ argc++ ] = ( char* )process_fullpath;
+		char* current = arguments_copy;
+		while ( *current && argc <= k_max_arguments )
+		{
+			while ( *current == ' ' )
+				++current;
+			if ( *current == 0 )
+				break;
 
-		Allocator* allocator = &MemoryService::instance()->system_allocator;
+			const bool quoted = *current == '"';
+			if ( quoted )
+				++current;
 
-		sizet full_cmd_size = strlen(process_fullpath) + 1 + strlen(arguments) + 1;
-		StringBuffer full_cmd_buffer;
-		full_cmd_buffer.init(full_cmd_size, allocator);
+			argv[ argc++ ] = current;
+			while ( *current && ( quoted ? *current != '"' : *current != ' ' ) )
+				++current;
 
-		char* full_cmd = full_cmd_buffer.append_use_f("%s %s", process_fullpath, arguments);
+			if ( *current )
+				*current++ = 0;
+		}
+		argv[ argc ] = nullptr;
 
-		// TODO(marco): this works only if one process is started at a time
-		FILE* cmd_stream = popen(full_cmd, "r");
-		bool execute_success = false;
-		if (cmd_stream != NULL)
+		// Pipe ends are close-on-exec so that concurrently spawned children only keep their own.
+		int pipe_fds[ 2 ];
+		if ( pipe( pipe_fds ) != 0 )
 		{
-			result = wait(NULL);
-
-			sizet read_chunk_size = 1024;
-			if (result != -1) {
-				sizet bytes_read = fread(k_process_output_buffer, 1, read_chunk_size, cmd_stream);
-				while (bytes_read == read_chunk_size) {
-					k_process_output_buffer[bytes_read] = 0;
-					rprint("%s", k_process_output_buffer);
+			rprint( "Execute process error, cannot create pipe. Error: %d\n", errno );
+			return false;
+		}
+		fcntl( pipe_fds[ 0 ], F_SETFD, FD_CLOEXEC );
+		fcntl( pipe_fds[ 1 ], F_SETFD, FD_CLOEXEC );
 
-					bytes_read = fread(k_process_output_buffer, 1, read_chunk_size, cmd_stream);
-				}
+		posix_spawn_file_actions_t file_actions;
+		posix_spawn_file_actions_init( &file_actions );
+		posix_spawn_file_actions_adddup2( &file_actions, pipe_fds[ 1 ], STDOUT_FILENO );
+		posix_spawn_file_actions_adddup2( &file_actions, pipe_fds[ 1 ], STDERR_FILENO );
 
-				k_process_output_buffer[bytes_read] = 0;
-				rprint("%s", k_process_output_buffer);
+		// The working directory is shared by all threads, only the child changes it.
+		const bool change_directory = working_directory && strcmp( working_directory, "." ) != 0;
 
-				if (strlen(search_error_string) > 0 && strstr(k_process_output_buffer, search_error_string)) {
-					execute_success = false;
+		pid_t pid;
+		int spawn_result;
+#if defined( ENGINE_SPAWN_ADDCHDIR )
+		if ( change_directory )
+		{
+			posix_spawn_file_actions_addchdir_np( &file_actions, working_directory );
+		}
+		spawn_result = posix_spawn( &pid, process_fullpath, &file_actions, nullptr, argv, environ );
+#else
+		if ( change_directory )
+		{
+			// Only async-signal-safe calls between fork and exec.
+			pid = fork();
+			if ( pid == 0 )
+			{
+				dup2( pipe_fds[ 1 ], STDOUT_FILENO );
+				dup2( pipe_fds[ 1 ], STDERR_FILENO );
+				if ( chdir( working_directory ) == 0 )
+				{
+					execve( process_fullpath, argv, environ );
 				}
-
-				rprint("\n");
+				_exit( 127 );
 			}
-			else
-			{
-				int err = errno;
+			spawn_result = pid < 0 ? errno : 0;
+		}
+		else
+		{
+			spawn_result = posix_spawn( &pid, process_fullpath, &file_actions, nullptr, argv, environ );
+		}
+#endif
 
-				rprint("Execute process error.\n Exe: \"%s\" - Args: \"%s\" - Work_dir: \"%s\"\n", process_fullpath, arguments, working_directory);
-				rprint("Error: %d\n", err);
+		posix_spawn_file_actions_destroy( &file_actions );
+		close( pipe_fds[ 1 ] );
 
-				execute_success = false;
-			}
+		if ( spawn_result != 0 )
+		{
+			rprint( "Execute process error.\n Exe: \"%s\" - Args: \"%s\" - Work_dir: \"%s\"\n", process_fullpath, arguments, working_directory );
+			rprint( "Error: %d\n", spawn_result );
 
-			pclose(cmd_stream);
+			close( pipe_fds[ 0 ] );
+			return false;
 		}
-		else
+
+		process.pid = pid;
+		process.output_pipe = pipe_fds[ 0 ];
+
+		return true;
+	}
+
+	i32 process_wait( Process& process, char* output, u32 output_size )
+	{
+		if ( process.pid < 0 )
 		{
-			int err = errno;
+			return -1;
+		}
 
-			rprint("Execute process error.\n Exe: \"%s\" - Args: \"%s\" - Work_dir: \"%s\"\n", process_fullpath, arguments, working_directory);
-			rprint("Error: %d\n", err);
-			execute_success = false;
+		// Consume all outputs, keeping what fits in the buffer.
+		u32 output_length = 0;
+		char read_buffer[ 1024 ];
+		for ( ;; )
+		{
+			const ssize_t bytes_read = read( process.output_pipe, read_buffer, sizeof( read_buffer ) );
+			if ( bytes_read < 0 && errno == EINTR )
+				continue;
+			if ( bytes_read <= 0 )
+				break;
+
+			const u32 copy_size = output_length + bytes_read < output_size ? ( u32 )bytes_read : output_size - output_length - 1;
+			memcpy( output + output_length, read_buffer, copy_size );
+			output_length += copy_size;
 		}
+		output[ output_length ] = 0;
+
+		close( process.output_pipe );
+
+		int status = 0;
+		pid_t result;
+		do
+		{
+			result = waitpid( process.pid, &status, 0 );
+		} while ( result < 0 && errno == EINTR );
 
-		chdir(current_dir);
+		process.output_pipe = -1;
+		process.pid = -1;
 
-		full_cmd_buffer.shutdown();
+		if ( result < 0 || !WIFEXITED( status ) )
+		{
+			return -1;
+		}
 
-		return execute_success;
+		return WEXITSTATUS( status );
 	}
 
-	cstring process_get_output()
+	u32 process_get_id()
 	{
-		return k_process_output_buffer;
+		return ( u32 )getpid();
 	}
 
 #endif // WIN64
 
-} // namespace Engine.
\ No newline at end of file
+} // namespace Engine.
@@ -4,8 +4,29 @@
 
 namespace Engine
 {
+	//
+	// Child process started with process_spawn, stdout and stderr are redirected to a pipe.
+	//
+	struct Process
+	{
+#if defined(_WIN64)
+		void*		process_handle	= nullptr;
+		void*		output_pipe		= nullptr;
+#else
+		i32			pid				= -1;
+		i32			output_pipe		= -1;
+#endif // _WIN64
+
+	}; // struct Process
 
 	bool		process_execute( cstring working_directory, cstring process_fullpath, cstring arguments, cstring search_error_string = "" );
 	cstring		process_get_output( cstring working_directory, cstring process_fullpath, cstring arguments, cstring search_error_string = "" );
 
-} // namespace Engine
\ No newline at end of file
+	// Starts the process without waiting for it. Several processes can run at the same time.
+	bool		process_spawn( Process& process, cstring working_directory, cstring process_fullpath, cstring arguments );
+	// Reads the process output until it exits, truncated to output_size. Returns the exit code, -1 on failure.
+	i32			process_wait( Process& process, char* output, u32 output_size );
+
+	u32			process_get_id();
+
+} // namespace Engine
@@ -1,22 +1,228 @@
 #include "resource_manager.h"
 
+#include "foundation/log.h"
+
+#include <new>
+#include <string.h>
+
 namespace Engine
 {
-	void ResourceManager::init(Allocator* allocator_, ResourceFilenameResolver* resolver_)
+	static void read_resource_task( u32 thread_index, void* user_data )
+	{
+		ResourceLoadRequest* request = ( ResourceLoadRequest* )user_data;
+		request->data = request->loader->read_file( request->path );
+	}
+
+	void ResourceManager::init(Allocator* allocator_, ResourceFilenameResolver* resolver_, TaskScheduler* task_scheduler_)
 	{
 		this->allocator = allocator_;
 		this->filename_resolver = resolver_;
+		this->task_scheduler = task_scheduler_;
 
 		loaders.init( allocator, 8 );
 		compilers.init( allocator, 8 );	
+
+		load_requests.init( allocator, k_max_pending_loads );
+		pending_loads.init( allocator, 16 );
+		pending_loads.set_default_value( u32_max );
+		pending_order.init( allocator, 16 );
+		load_callbacks.init( allocator, 16 );
+		load_names.init( allocator, 16 );
+		load_serial = 0;
 	}
 
 	void ResourceManager::shutdown()
 	{
+		// Pending loads are dropped, their reads have to complete first as they write in the requests.
+		for ( u32 i = 0; i < pending_order.size; ++i )
+		{
+			ResourceLoadRequest* request = load_requests.get( pending_order[ i ] );
+			if ( task_scheduler )
+			{
+				task_scheduler->wait( &request->counter );
+			}
+			if ( request->data )
+			{
+				request->loader->release_data( request->data );
+			}
+			request->~ResourceLoadRequest();
+			load_requests.release( request );
+		}
+
+		load_requests.shutdown();
+		pending_loads.shutdown();
+		pending_order.shutdown();
+		load_callbacks.shutdown();
+
+		FlatHashMapIterator it = load_names.iterator_begin();
+		while ( it.is_valid() )
+		{
+			rfree( load_names.get( it ), allocator );
+			load_names.iterator_advance( it );
+		}
+		load_names.shutdown();
+
 		loaders.shutdown();
 		compilers.shutdown();
 	}
 
+	ResourceLoadHandle ResourceManager::load_async( u64 type_hash, cstring name, bool reload, ResourceLoadCallback callback, void* user_data )
+	{
+		ResourceLoader* loader = loaders.get( type_hash );
+		if ( !loader )
+		{
+			return 0;
+		}
+
+		const u64 key = hash_calculate( name, type_hash );
+		u32 request_index = pending_loads.get( key );
+		if ( request_index == u32_max )
+		{
+			Resource* resource = loader->get( name );
+			if ( resource && !reload )
+			{
+				if ( callback )
+				{
+					callback( resource, user_data );
+				}
+				return 0;
+			}
+
+			ResourceLoadRequest* request = load_requests.obtain();
+			if ( !request )
+			{
+				rprint( "Too many pending resource loads, %s is not loaded\n", name );
+				return 0;
+			}
+			request_index = request->pool_index;
+
+			new ( request ) ResourceLoadRequest();
+			request->pool_index = request_index;
+			request->loader = loader;
+			request->name = copy_load_name( name );
+			request->path = resolve_path( request->name );
+			request->data = nullptr;
+			request->key = key;
+			request->handle = ( ( u64 )++load_serial << 32 ) | request_index;
+			request->reload = resource != nullptr;
+
+			// Without a task scheduler the file is read in update.
+			if ( task_scheduler && loader->async_read_supported() )
+			{
+				// Never run by a wait on the owning thread, so reads cannot stall its frame.
+				task_scheduler->add_background_task( read_resource_task, request, &request->counter );
+			}
+
+			pending_loads.insert( key, request_index );
+			pending_order.push( request_index );
+		}
+
+		ResourceLoadRequest* request = load_requests.get( request_index );
+		if ( callback )
+		{
+			load_callbacks.push( { request->handle, callback, user_data } );
+		}
+
+		return request->handle;
+	}
+
+	bool ResourceManager::is_loading( ResourceLoadHandle handle ) const
+	{
+		const u32 request_index = ( u32 )handle;
+		if ( handle == 0 || request_index >= k_max_pending_loads )
+		{
+			return false;
+		}
+
+		for ( u32 i = 0; i < pending_order.size; ++i )
+		{
+			if ( pending_order[ i ] == request_index )
+			{
+				return load_requests.get( request_index )->handle == handle;
+			}
+		}
+
+		return false;
+	}
+
+	void ResourceManager::update()
+	{
+		u32 num_created = 0;
+		for ( u32 i = 0; i < pending_order.size && num_created < k_max_loads_created_per_update; )
+		{
+			ResourceLoadRequest* request = load_requests.get( pending_order[ i ] );
+			if ( !request->counter.is_done() )
+			{
+				++i;
+				continue;
+			}
+
+			ResourceLoader* loader = request->loader;
+			const bool async_read = loader->async_read_supported();
+			if ( async_read && !task_scheduler )
+			{
+				request->data = loader->read_file( request->path );
+			}
+
+			// A failed read keeps the current resource of a reload, the callbacks get nullptr.
+			Resource* resource = nullptr;
+			if ( async_read && request->data == nullptr )
+			{
+				rprint( "Error reading resource %s from %s\n", request->name, request->path );
+			}
+			else
+			{
+				if ( request->reload )
+				{
+					loader->unload( request->name );
+				}
+				resource = async_read ? loader->create_from_data( request->name, request->path, request->data, this ) :
+										loader->create_from_file( request->name, request->path, this );
+			}
+			++num_created;
+
+			// Callbacks can request new loads, so the request is retired first.
+			const ResourceLoadHandle handle = request->handle;
+			pending_loads.remove( request->key );
+			pending_order.delete_swap( i );
+			request->~ResourceLoadRequest();
+			load_requests.release( request );
+
+			for ( u32 c = 0; c < load_callbacks.size; )
+			{
+				if ( load_callbacks[ c ].handle != handle )
+				{
+					++c;
+					continue;
+				}
+
+				const ResourceLoadCallbackEntry entry = load_callbacks[ c ];
+				load_callbacks.delete_swap( c );
+				entry.callback( resource, entry.user_data );
+			}
+		}
+	}
+
+	cstring ResourceManager::resolve_path( cstring name )
+	{
+		return filename_resolver ? filename_resolver->get_binary_path_from_name( name ) : name;
+	}
+
+	cstring ResourceManager::copy_load_name( cstring name )
+	{
+		const u64 hashed_name = hash_calculate( name );
+		char* copy = load_names.get( hashed_name );
+		if ( copy == nullptr )
+		{
+			const sizet size = strlen( name ) + 1;
+			copy = ( char* )ralloca( size, allocator );
+			memcpy( copy, name, size );
+			load_names.insert( hashed_name, copy );
+		}
+
+		return copy;
+	}
+
 	void ResourceManager::set_loader(cstring resource_type, ResourceLoader* loader)
 	{
 		const u64 hashed_name = hash_calculate( resource_type );
@@ -28,4 +234,4 @@ namespace Engine
 		const u64 hashed_name = hash_calculate( resource_type );
 		compilers.insert( hashed_name, compiler );
 	}
-}
\ No newline at end of file
+}
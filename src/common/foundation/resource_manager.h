@@ -3,6 +3,9 @@
 #include "foundation/platform.h"
 #include "foundation/assert.h"
 #include "foundation/hash_map.h"
+#include "foundation/data_structures.h"
+#include "foundation/array.h"
+#include "foundation/task_scheduler.h"
 
 namespace Engine
 {
@@ -36,7 +39,15 @@ namespace Engine
 		virtual Resource*	unload( cstring name )	= 0;
 
 		virtual Resource* create_from_file(cstring name, cstring filename, Engine::ResourceManager* resource_manager) { return nullptr; }
-		
+
+		// Asynchronous loading is split in two: read_file runs on a worker thread and returns the decoded data, nullptr on failure,
+		// create_from_data runs on the thread calling ResourceManager::update and owns the data.
+		// Loaders not supporting it are loaded with create_from_file on the owning thread.
+		virtual bool		async_read_supported() const	{ return false; }
+		virtual void*		read_file( cstring filename )	{ return nullptr; }
+		virtual Resource*	create_from_data( cstring name, cstring filename, void* data, Engine::ResourceManager* resource_manager ) { return nullptr; }
+		virtual void		release_data( void* data )		{ }		// Data of a load dropped at shutdown.
+
 	}; // struct ResourceLoader
 
 	//
@@ -47,9 +58,42 @@ namespace Engine
 
 	}; // struct ResourceFilenameResolver
 
+	//
+	// Identifies an asynchronous load while it is in flight. 0 is returned when no load is needed.
+	typedef u64								ResourceLoadHandle;
+
+	// Called on the thread calling ResourceManager::update. Resource is nullptr when the load failed.
+	typedef void							( *ResourceLoadCallback )( Resource* resource, void* user_data );
+
+	//
+	//
+	struct ResourceLoadRequest
+	{
+		ResourceLoader*						loader;
+		cstring								name;
+		cstring								path;
+		void*								data;
+
+		u64									key;
+		ResourceLoadHandle					handle;
+		bool								reload;
+
+		TaskCounter							counter;
+		u32									pool_index;
+
+	}; // struct ResourceLoadRequest
+
+	struct ResourceLoadCallbackEntry
+	{
+		ResourceLoadHandle					handle;
+		ResourceLoadCallback				callback;
+		void*								user_data;
+
+	}; // struct ResourceLoadCallbackEntry
+
 	struct ResourceManager
 	{
-		void								init( Allocator* allocator, ResourceFilenameResolver* resolver );
+		void								init( Allocator* allocator, ResourceFilenameResolver* resolver, TaskScheduler* task_scheduler = nullptr );
 		void								shutdown();
 
 		template <typename T>
@@ -64,14 +108,44 @@ namespace Engine
 		template <typename T>
 		T*									reload( cstring name );
 
+		// Returns immediately, files are read on the task scheduler workers and resources created in update. The name is copied.
+		// Requests for a name already loading share its handle, callbacks of resources already loaded are called before returning.
+		template <typename T>
+		ResourceLoadHandle					load_async( cstring name, ResourceLoadCallback callback = nullptr, void* user_data = nullptr );
+
+		// The current resource stays valid until the new one is created, and is kept when the read fails. Names not loaded yet are loaded.
+		template <typename T>
+		ResourceLoadHandle					reload_async( cstring name, ResourceLoadCallback callback = nullptr, void* user_data = nullptr );
+
+		ResourceLoadHandle					load_async( u64 type_hash, cstring name, bool reload, ResourceLoadCallback callback, void* user_data );
+
+		bool								is_loading( ResourceLoadHandle handle ) const;
+
+		// Creates the resources whose read completed and calls their callbacks, call it once per frame on the owning thread.
+		void								update();
+
+		cstring								resolve_path( cstring name );
+		cstring								copy_load_name( cstring name );
+
 		void								set_loader( cstring resource_type, ResourceLoader* loader);
 		void								set_compiler( cstring resource_type, ResourceCompiler* compiler );
 
 		FlatHashMap<u64, ResourceLoader*>	loaders;
 		FlatHashMap<u64, ResourceCompiler*>	compilers;
 
+		static constexpr u32				k_max_pending_loads				= 256;
+		static constexpr u32				k_max_loads_created_per_update	= 4;
+
+		ResourcePoolTyped<ResourceLoadRequest>	load_requests;
+		FlatHashMap<u64, u32>				pending_loads;					// Name and type key to request pool index.
+		Array<u32>							pending_order;					// Pool indices of the requests in pending_loads.
+		Array<ResourceLoadCallbackEntry>	load_callbacks;
+		u32									load_serial;
+		FlatHashMap<u64, char*>				load_names;						// Copies of the names given to load_async, resources keep them until shutdown.
+
 		Allocator*							allocator;
 		ResourceFilenameResolver*			filename_resolver;
+		TaskScheduler*						task_scheduler;
 
 	}; // struct ResourceManager
 
@@ -79,7 +153,7 @@ namespace Engine
 	template <typename T>
 	inline T* ResourceManager::load( cstring name )
 	{
-		ResourceLoader loader = loaders.get( T::k_type_hash );
+		ResourceLoader* loader = loaders.get( T::k_type_hash );
 
 		if (loader)
 		{
@@ -89,7 +163,7 @@ namespace Engine
 				return resource;
 
 			// Resource not in cache, create from file.
-			cstring path = filename_resolver->get_binary_path_from_name( name );
+			cstring path = resolve_path( name );
 			return (T*)loader->create_from_file( name, path, this );
 		}
 
@@ -99,7 +173,7 @@ namespace Engine
 	template <typename T>
 	inline T* ResourceManager::get( cstring name )
 	{
-		ResourceLoader loader = loaders.get(T::k_type_hash);
+		ResourceLoader* loader = loaders.get(T::k_type_hash);
 
 		if (loader)
 		{
@@ -112,7 +186,7 @@ namespace Engine
 	template <typename T>
 	inline T* ResourceManager::get( u64 hashed_name )
 	{
-		ResourceLoader loader = loaders.get( T::k_type_hash );
+		ResourceLoader* loader = loaders.get( T::k_type_hash );
 
 		if( loader )
 		{
@@ -125,7 +199,7 @@ namespace Engine
 	template <typename T>
 	inline T* ResourceManager::reload(cstring name)
 	{
-		ResourceLoader loader = loaders.get( T::k_type_hash );
+		ResourceLoader* loader = loaders.get( T::k_type_hash );
 		if (loader)
 		{
 			T* resource = ( T* )loader->get( name );
@@ -134,7 +208,7 @@ namespace Engine
 				loader->unload(name);
 
 				// Resource not in cache, create from file.
-				cstring path = filename_resolver->get_binary_path_from_name( name );
+				cstring path = resolve_path( name );
 				return ( T* )loader->create_from_file( name, path, this );
 			}
 		}
@@ -142,4 +216,16 @@ namespace Engine
 		return nullptr;
 	}
 
+	template <typename T>
+	inline ResourceLoadHandle ResourceManager::load_async( cstring name, ResourceLoadCallback callback, void* user_data )
+	{
+		return load_async( T::k_type_hash, name, false, callback, user_data );
+	}
+
+	template <typename T>
+	inline ResourceLoadHandle ResourceManager::reload_async( cstring name, ResourceLoadCallback callback, void* user_data )
+	{
+		return load_async( T::k_type_hash, name, true, callback, user_data );
+	}
+
 }	// Namespace Engine.
\ No newline at end of file
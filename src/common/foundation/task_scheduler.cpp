@@ -0,0 +1,464 @@
+#include "foundation/task_scheduler.h"
+#include "foundation/memory.h"
+#include "foundation/array.h"
+#include "foundation/assert.h"
+#include "foundation/log.h"
+#include "foundation/numerics.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <new>
+
+namespace Engine
+{
+	//
+	// Bounded deque owned by a single thread. The owner pushes and pops at the tail,
+	// other threads steal from the head.
+	//
+	struct TaskQueue
+	{
+		void								init( Allocator* allocator, u32 capacity );
+		void								shutdown( Allocator* allocator );
+
+		bool								push( const Task& task );
+		bool								pop( Task& task );
+		bool								steal( Task& task );
+
+		std::mutex							lock;
+
+		Task*								tasks		= nullptr;
+		u32									head		= 0;
+		u32									tail		= 0;
+		u32									mask		= 0;
+
+	}; // struct TaskQueue
+
+	//
+	//
+	struct TaskSchedulerState
+	{
+		std::thread*						workers		= nullptr;
+
+		std::mutex							sleep_lock;
+		std::condition_variable				sleep_condition;
+
+		std::atomic<u32>					pending_tasks{ 0 };
+		std::atomic<bool>					running{ false };
+
+		std::mutex							waiting_lock;
+		Array<Task>							waiting_tasks;
+
+		TaskQueue							background_queue;		// Shared by the workers, they steal from it when out of other work.
+
+	}; // struct TaskSchedulerState
+
+	// Task Scheduler Service /////////////////////////////////////////////////
+	static TaskScheduler				s_task_scheduler;
+
+	static thread_local u32				s_thread_index = 0;
+
+	static void							worker_main( TaskScheduler* scheduler, u32 thread_index );
+	static void							execute_task( TaskScheduler* scheduler, const Task& task, u32 thread_index );
+
+	TaskScheduler* TaskScheduler::instance()
+	{
+		return &s_task_scheduler;
+	}
+
+	void TaskScheduler::init( void* configuration )
+	{
+		TaskSchedulerConfiguration default_configuration{ };
+		TaskSchedulerConfiguration* task_configuration = configuration ? static_cast< TaskSchedulerConfiguration* >( configuration ) : &default_configuration;
+
+		num_threads = task_configuration->num_threads;
+		if ( num_threads == 0 )
+		{
+			num_threads = std::thread::hardware_concurrency();
+		}
+		if ( task_configuration->max_threads && num_threads > task_configuration->max_threads )
+		{
+			num_threads = task_configuration->max_threads;
+		}
+		num_threads = num_threads ? num_threads : 1;
+
+		const u32 capacity = task_configuration->max_tasks_per_queue;
+		RASSERTM( ( capacity & ( capacity - 1 ) ) == 0, "Task queue capacity %u must be a power of two", capacity );
+
+		allocator = &MemoryService::instance()->system_allocator;
+
+		state = new ( rallocaa( sizeof( TaskSchedulerState ), allocator, alignof( TaskSchedulerState ) ) ) TaskSchedulerState();
+		state->waiting_tasks.init( allocator, capacity );
+		state->background_queue.init( allocator, capacity );
+		state->running.store( true );
+
+		queues = ( TaskQueue* )rallocaa( sizeof( TaskQueue ) * num_threads, allocator, alignof( TaskQueue ) );
+		for ( u32 i = 0; i < num_threads; ++i )
+		{
+			new ( &queues[ i ] ) TaskQueue();
+			queues[ i ].init( allocator, capacity );
+		}
+
+		// Thread 0 is the calling thread, spawn the others.
+		s_thread_index = 0;
+		state->workers = ( std::thread* )rallocaa( sizeof( std::thread ) * num_threads, allocator, alignof( std::thread ) );
+		for ( u32 i = 1; i < num_threads; ++i )
+		{
+			new ( &state->workers[ i ] ) std::thread( worker_main, this, i );
+		}
+
+		rprint( "Task Scheduler Init: %u threads\n", num_threads );
+	}
+
+	void TaskScheduler::shutdown()
+	{
+		if ( !state )
+		{
+			return;
+		}
+
+		state->running.store( false );
+		state->sleep_condition.notify_all();
+
+		for ( u32 i = 1; i < num_threads; ++i )
+		{
+			state->workers[ i ].join();
+			state->workers[ i ].~thread();
+		}
+		rfree( state->workers, allocator );
+
+		for ( u32 i = 0; i < num_threads; ++i )
+		{
+			queues[ i ].shutdown( allocator );
+			queues[ i ].~TaskQueue();
+		}
+		rfree( queues, allocator );
+
+		state->waiting_tasks.shutdown();
+		state->background_queue.shutdown( allocator );
+		state->~TaskSchedulerState();
+		rfree( state, allocator );
+
+		queues = nullptr;
+		state = nullptr;
+		num_threads = 1;
+
+		rprint( "Task Scheduler Shutdown\n" );
+	}
+
+	void TaskScheduler::add_task( TaskFunction function, void* user_data, TaskCounter* counter, TaskCounter* dependency )
+	{
+		Task task{ };
+		task.function = function;
+		task.user_data = user_data;
+		task.counter = counter;
+		task.dependency = dependency;
+
+		add_task( task );
+	}
+
+	void TaskScheduler::add_background_task( TaskFunction function, void* user_data, TaskCounter* counter )
+	{
+		Task task{ };
+		task.function = function;
+		task.user_data = user_data;
+		task.counter = counter;
+		task.background = true;
+
+		add_task( task );
+	}
+
+	// Background tasks go to the shared queue, the others to the queue of the calling thread.
+	static bool push_task( TaskScheduler* scheduler, const Task& task, u32 thread_index )
+	{
+		return task.background ? scheduler->state->background_queue.push( task ) : scheduler->queues[ thread_index ].push( task );
+	}
+
+	void TaskScheduler::add_task( const Task& task )
+	{
+		if ( task.counter )
+		{
+			task.counter->value.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		// Without the service running everything executes in place.
+		if ( !state )
+		{
+			RASSERTM( !task.dependency || task.dependency->is_done(), "Task dependency can not be satisfied without running the task scheduler" );
+			execute_task( this, task, 0 );
+			return;
+		}
+
+		if ( task.dependency && !task.dependency->is_done() )
+		{
+			std::lock_guard<std::mutex> guard( state->waiting_lock );
+			// Check again: the dependency could have completed before taking the lock.
+			if ( !task.dependency->is_done() )
+			{
+				RASSERTM( state->waiting_tasks.size < state->waiting_tasks.capacity, "Too many tasks waiting on dependencies" );
+				state->waiting_tasks.push( task );
+				return;
+			}
+		}
+
+		const u32 thread_index = s_thread_index;
+		if ( !push_task( this, task, thread_index ) )
+		{
+			// Queue is full, run it now.
+			execute_task( this, task, thread_index );
+			return;
+		}
+
+		state->pending_tasks.fetch_add( 1, std::memory_order_release );
+		state->sleep_condition.notify_one();
+	}
+
+	void TaskScheduler::parallel_for( u32 count, u32 granularity, ParallelForFunction function, void* user_data )
+	{
+		if ( count == 0 )
+		{
+			return;
+		}
+
+		if ( granularity == 0 )
+		{
+			// Aim for a few chunks per thread so that stealing can balance uneven work.
+			granularity = count / ( num_threads * 4 );
+			granularity = granularity ? granularity : 1;
+		}
+
+		if ( !state || num_threads == 1 || count <= granularity )
+		{
+			function( 0, count, s_thread_index, user_data );
+			return;
+		}
+
+		TaskCounter counter;
+
+		for ( u32 start = 0; start < count; start += granularity )
+		{
+			Task task{ };
+			task.range_function = function;
+			task.user_data = user_data;
+			task.start = start;
+			task.end = min( start + granularity, count );
+			task.counter = &counter;
+
+			add_task( task );
+		}
+
+		wait( &counter );
+	}
+
+	void TaskScheduler::wait( TaskCounter* counter )
+	{
+		const u32 thread_index = s_thread_index;
+
+		while ( !counter->is_done() )
+		{
+			if ( !state || !execute_next_task( thread_index ) )
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	u32 TaskScheduler::get_thread_index() const
+	{
+		return s_thread_index;
+	}
+
+	bool TaskScheduler::execute_next_task( u32 thread_index )
+	{
+		if ( state->pending_tasks.load( std::memory_order_acquire ) == 0 )
+		{
+			return false;
+		}
+
+		Task task;
+		bool found = queues[ thread_index ].pop( task );
+
+		for ( u32 i = 1; i < num_threads && !found; ++i )
+		{
+			const u32 victim = ( thread_index + i ) % num_threads;
+			found = queues[ victim ].steal( task );
+		}
+
+		// The main thread leaves background tasks to the workers, unless there are none.
+		if ( !found && ( thread_index != 0 || num_threads == 1 ) )
+		{
+			found = state->background_queue.steal( task );
+		}
+
+		if ( !found )
+		{
+			return false;
+		}
+
+		state->pending_tasks.fetch_sub( 1, std::memory_order_relaxed );
+		execute_task( this, task, thread_index );
+
+		return true;
+	}
+
+	void TaskScheduler::release_dependent_tasks()
+	{
+		if ( !state )
+		{
+			return;
+		}
+
+		static const u32 k_max_released_tasks = 64;
+
+		const u32 thread_index = s_thread_index;
+
+		for ( ;; )
+		{
+			Task ready_tasks[ k_max_released_tasks ];
+			u32 ready_count = 0;
+			{
+				std::lock_guard<std::mutex> guard( state->waiting_lock );
+
+				for ( u32 i = 0; i < state->waiting_tasks.size && ready_count < k_max_released_tasks; )
+				{
+					const Task& task = state->waiting_tasks[ i ];
+					if ( !task.dependency->is_done() )
+					{
+						++i;
+						continue;
+					}
+
+					ready_tasks[ ready_count++ ] = task;
+					state->waiting_tasks.delete_swap( i );
+				}
+			}
+
+			// Tasks are queued outside of the lock, as running one in place can release more tasks.
+			u32 released = 0;
+			for ( u32 i = 0; i < ready_count; ++i )
+			{
+				if ( push_task( this, ready_tasks[ i ], thread_index ) )
+				{
+					++released;
+				}
+				else
+				{
+					execute_task( this, ready_tasks[ i ], thread_index );
+				}
+			}
+
+			if ( released )
+			{
+				state->pending_tasks.fetch_add( released, std::memory_order_release );
+				state->sleep_condition.notify_all();
+			}
+
+			if ( ready_count < k_max_released_tasks )
+			{
+				break;
+			}
+		}
+	}
+
+	void execute_task( TaskScheduler* scheduler, const Task& task, u32 thread_index )
+	{
+		if ( task.range_function )
+		{
+			task.range_function( task.start, task.end, thread_index, task.user_data );
+		}
+		else
+		{
+			task.function( thread_index, task.user_data );
+		}
+
+		if ( task.counter && task.counter->value.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+		{
+			scheduler->release_dependent_tasks();
+		}
+	}
+
+	void worker_main( TaskScheduler* scheduler, u32 thread_index )
+	{
+		s_thread_index = thread_index;
+
+		TaskSchedulerState* state = scheduler->state;
+
+		while ( state->running.load( std::memory_order_acquire ) )
+		{
+			if ( scheduler->execute_next_task( thread_index ) )
+			{
+				continue;
+			}
+
+			// Nothing to run or steal: sleep until new work is pushed. The timeout covers
+			// a notification racing with the predicate check.
+			std::unique_lock<std::mutex> lock( state->sleep_lock );
+			state->sleep_condition.wait_for( lock, std::chrono::milliseconds( 1 ), [ state ]()
+			{
+				return state->pending_tasks.load( std::memory_order_acquire ) > 0 || !state->running.load( std::memory_order_acquire );
+			} );
+		}
+	}
+
+	// TaskQueue //////////////////////////////////////////////////////////////
+	void TaskQueue::init( Allocator* allocator, u32 capacity )
+	{
+		tasks = ( Task* )rallocaa( sizeof( Task ) * capacity, allocator, alignof( Task ) );
+		head = 0;
+		tail = 0;
+		mask = capacity - 1;
+	}
+
+	void TaskQueue::shutdown( Allocator* allocator )
+	{
+		rfree( tasks, allocator );
+		tasks = nullptr;
+	}
+
+	bool TaskQueue::push( const Task& task )
+	{
+		std::lock_guard<std::mutex> guard( lock );
+
+		if ( tail - head > mask )
+		{
+			return false;
+		}
+
+		tasks[ tail & mask ] = task;
+		++tail;
+
+		return true;
+	}
+
+	bool TaskQueue::pop( Task& task )
+	{
+		std::lock_guard<std::mutex> guard( lock );
+
+		if ( tail == head )
+		{
+			return false;
+		}
+
+		--tail;
+		task = tasks[ tail & mask ];
+
+		return true;
+	}
+
+	bool TaskQueue::steal( Task& task )
+	{
+		std::lock_guard<std::mutex> guard( lock );
+
+		if ( tail == head )
+		{
+			return false;
+		}
+
+		task = tasks[ head & mask ];
+		++head;
+
+		return true;
+	}
+
+} // namespace Engine
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "foundation/platform.h"
+#include "foundation/service.h"
+
+#include <atomic>
+
+namespace Engine
+{
+	struct Allocator;
+	struct TaskQueue;
+	struct TaskSchedulerState;
+
+	// Task Methods ///////////////////////////////////////////////////////
+
+	typedef void						( *TaskFunction )( u32 thread_index, void* user_data );
+	typedef void						( *ParallelForFunction )( u32 start, u32 end, u32 thread_index, void* user_data );
+
+	// Task Structs ///////////////////////////////////////////////////////
+
+	//
+	// Counts the tasks still in flight. Tasks can depend on a counter reaching zero.
+	//
+	struct TaskCounter
+	{
+		std::atomic<i32>					value{ 0 };
+
+		bool								is_done() const { return value.load( std::memory_order_acquire ) == 0; }
+
+	}; // struct TaskCounter
+
+	//
+	//
+	struct Task
+	{
+		TaskFunction						function			= nullptr;
+		ParallelForFunction					range_function		= nullptr;
+		void*								user_data			= nullptr;
+
+		u32									start				= 0;
+		u32									end					= 0;
+
+		TaskCounter*						counter				= nullptr;		// Decremented when the task completes.
+		TaskCounter*						dependency			= nullptr;		// Task is held back until this reaches zero.
+
+		bool								background			= false;		// Only run by worker threads, see add_background_task.
+
+	}; // struct Task
+
+	// Task Scheduler Service /////////////////////////////////////////////
+	//
+	//
+	struct TaskSchedulerConfiguration
+	{
+		u32									num_threads			= 0;		// Including the main thread. 0 means use all hardware threads.
+		u32									max_tasks_per_queue	= 4096;		// Must be a power of two.
+		u32									max_threads			= 0;		// Upper bound on num_threads, 0 means no limit.
+
+	}; // struct TaskSchedulerConfiguration
+
+	//
+	// Work-stealing scheduler: every thread owns a deque, pops its own work LIFO
+	// and steals FIFO from the others when it runs dry. Thread 0 is the main thread.
+	//
+	struct TaskScheduler : public Service
+	{
+		ENGINE_DECLARE_SERVICE( TaskScheduler )
+
+		virtual void						init( void* configuration );
+		virtual void						shutdown();
+
+		void								add_task( TaskFunction function, void* user_data, TaskCounter* counter, TaskCounter* dependency = nullptr );
+		void								add_task( const Task& task );
+
+		// For blocking work like file reads: only worker threads run it, so it never stalls a wait on the main thread.
+		// Without workers the main thread runs it.
+		void								add_background_task( TaskFunction function, void* user_data, TaskCounter* counter );
+
+		// Split [0, count) in chunks of granularity elements and run them on all threads.
+		// Returns when every chunk has completed.
+		void								parallel_for( u32 count, u32 granularity, ParallelForFunction function, void* user_data );
+
+		// Waits for the counter to reach zero, executing pending tasks in the meantime.
+		void								wait( TaskCounter* counter );
+
+		u32									get_thread_index() const;
+
+		bool								execute_next_task( u32 thread_index );
+		void								release_dependent_tasks();
+
+		TaskQueue*							queues				= nullptr;
+		TaskSchedulerState*					state				= nullptr;
+		Allocator*							allocator			= nullptr;
+
+		u32									num_threads			= 1;
+
+		static constexpr cstring			k_name = "raptor_task_scheduler_service";
+
+	}; // struct TaskScheduler
+
+} // namespace Engine
@@ -1,15 +1,42 @@
 #include "graphics/command_buffer.h"
 #include "graphics/gpu_device.h"
 
+#include <string.h>
+
 
 namespace Engine
 {
+	void ElidedBindCounters::add( const ElidedBindCounters& other )
+	{
+		pipelines += other.pipelines;
+		vertex_buffers += other.vertex_buffers;
+		index_buffers += other.index_buffers;
+		descriptor_sets += other.descriptor_sets;
+	}
+
 	void CommandBuffer::reset()
 	{
 		is_recording = false;
 		current_render_pass = nullptr;
 		current_pipeline = nullptr;
 		current_command = 0;
+
+		invalidate_bindings();
+		elided_binds = {};
+	}
+
+	void CommandBuffer::invalidate_bindings()
+	{
+		bound_pipeline = VK_NULL_HANDLE;
+		bound_pipeline_layout = VK_NULL_HANDLE;
+
+		for ( u32 i = 0; i < k_max_vertex_streams; ++i )
+		{
+			bound_vertex_buffers[ i ] = VK_NULL_HANDLE;
+		}
+
+		bound_index_buffer = VK_NULL_HANDLE;
+		num_bound_descriptor_sets = 0;
 	}
 
 	void CommandBuffer::init(QueueType::Enum type, u32 buffer_size, u32 submit_size, bool baked)
@@ -24,11 +51,37 @@ namespace Engine
 		is_recording = false;
 	}
 
+	void CommandBuffer::begin_secondary( RenderPass* current_render_pass_ )
+	{
+		VkCommandBufferInheritanceInfo inheritance{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+		inheritance.renderPass = current_render_pass_->vk_render_pass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = current_render_pass_->type == RenderPassType::Swapchain ? device->vulkan_swapchain_framebuffers[ device->vulkan_image_index ] : current_render_pass_->vk_frame_buffer;
+
+		VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		begin_info.pInheritanceInfo = &inheritance;
+
+		vkBeginCommandBuffer( vk_command_buffer, &begin_info );
+
+		is_recording = true;
+
+		// The pass is already begun by the primary, bind_pass on it will not restart it.
+		current_render_pass = current_render_pass_;
+	}
+
+	void CommandBuffer::end()
+	{
+		vkEndCommandBuffer( vk_command_buffer );
+
+		is_recording = false;
+	}
+
 	//
 	// Commands Interface
 	//
 
-	void CommandBuffer::bind_pass(RenderPassHandle handle)
+	void CommandBuffer::bind_pass(RenderPassHandle handle, bool use_secondary)
 	{
 		is_recording = true;
 
@@ -53,20 +106,45 @@ namespace Engine
 			render_pass_begin.clearValueCount = 2;
 			render_pass_begin.pClearValues = clears;
 
-			vkCmdBeginRenderPass( vk_command_buffer, &render_pass_begin, VK_SUBPASS_CONTENTS_INLINE );
+			vkCmdBeginRenderPass( vk_command_buffer, &render_pass_begin, use_secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE );
 		}
 
 		// Cache render pass.
 		current_render_pass	 = render_pass;
 	}
 
+	void CommandBuffer::end_current_render_pass()
+	{
+		if ( is_recording && current_render_pass && ( current_render_pass->type != RenderPassType::Compute ) )
+		{
+			vkCmdEndRenderPass( vk_command_buffer );
+		}
+
+		current_render_pass = nullptr;
+	}
+
 	void CommandBuffer::bind_pipeline(PipelineHandle handle)
 	{
 		Pipeline* pipeline = device->access_pipeline( handle );
-		vkCmdBindPipeline( vk_command_buffer, pipeline->vk_bind_point, pipeline->vk_pipeline );
 
 		// Cache Pipeline.
 		current_pipeline = pipeline;
+
+		if ( pipeline->vk_pipeline == bound_pipeline )
+		{
+			++elided_binds.pipelines;
+			return;
+		}
+
+		vkCmdBindPipeline( vk_command_buffer, pipeline->vk_bind_point, pipeline->vk_pipeline );
+		bound_pipeline = pipeline->vk_pipeline;
+
+		// Bindless textures stay bound across draws, binding the lower sets later does not disturb them.
+		if ( pipeline->bindless_set_index != u32_max )
+		{
+			vkCmdBindDescriptorSets( vk_command_buffer, pipeline->vk_bind_point, pipeline->vk_pipeline_layout, pipeline->bindless_set_index, 1,
+				&device->vulkan_bindless_descriptor_set, 0, nullptr );
+		}
 	}
 
 	void CommandBuffer::bind_vertex_buffer(BufferHandle handle, u32 binding, u32 offset)
@@ -83,7 +161,16 @@ namespace Engine
 			offsets[ 0 ] = buffer->global_offset;
 		}
 
+		RASSERT( binding < k_max_vertex_streams );
+		if ( bound_vertex_buffers[ binding ] == vk_buffer && bound_vertex_offsets[ binding ] == offsets[ 0 ] )
+		{
+			++elided_binds.vertex_buffers;
+			return;
+		}
+
 		vkCmdBindVertexBuffers( vk_command_buffer, binding, 1, &vk_buffer, offsets );
+		bound_vertex_buffers[ binding ] = vk_buffer;
+		bound_vertex_offsets[ binding ] = offsets[ 0 ];
 	}
 
 	void CommandBuffer::bind_index_buffer(BufferHandle handle, u32 offset_, VkIndexType index_type)
@@ -100,7 +187,16 @@ namespace Engine
 			offset = buffer->global_offset;
 		}
 
+		if ( bound_index_buffer == vk_buffer && bound_index_offset == offset && bound_index_type == index_type )
+		{
+			++elided_binds.index_buffers;
+			return;
+		}
+
 		vkCmdBindIndexBuffer( vk_command_buffer, vk_buffer, offset, index_type );
+		bound_index_buffer = vk_buffer;
+		bound_index_offset = offset;
+		bound_index_type = index_type;
 	}
 
 	void CommandBuffer::bind_descriptor_set(DescriptorSetHandle* handles, u32 num_lists, u32* offset, u32 num_offsets )
@@ -132,9 +228,32 @@ namespace Engine
 			}
 		}
 
+		// Same sets with the same dynamic offsets, bound with a compatible layout.
+		bool same_bindings = current_pipeline->vk_pipeline_layout == bound_pipeline_layout && num_lists == num_bound_descriptor_sets && num_offsets == num_bound_dynamic_offsets;
+		for ( u32 l = 0; same_bindings && l < num_lists; ++l )
+		{
+			same_bindings = vk_descriptor_sets[ l ] == bound_descriptor_sets[ l ];
+		}
+		for ( u32 o = 0; same_bindings && o < num_offsets; ++o )
+		{
+			same_bindings = offsets_cache[ o ] == bound_dynamic_offsets[ o ];
+		}
+
+		if ( same_bindings )
+		{
+			++elided_binds.descriptor_sets;
+			return;
+		}
+
 		const u32 k_first_set = 0;
 		vkCmdBindDescriptorSets( vk_command_buffer, current_pipeline->vk_bind_point, current_pipeline->vk_pipeline_layout, k_first_set, num_lists,
 			vk_descriptor_sets, num_offsets, offsets_cache);
+
+		bound_pipeline_layout = current_pipeline->vk_pipeline_layout;
+		num_bound_descriptor_sets = num_lists;
+		num_bound_dynamic_offsets = num_offsets;
+		memcpy( bound_descriptor_sets, vk_descriptor_sets, sizeof( VkDescriptorSet ) * num_lists );
+		memcpy( bound_dynamic_offsets, offsets_cache, sizeof( u32 ) * num_offsets );
 	}
 
 	void	CommandBuffer::set_viewport(const Viewport* viewport)
@@ -222,6 +341,51 @@ namespace Engine
 		vkCmdFillBuffer( vk_command_buffer, vk_buffer->vk_buffer, VkDeviceSize( offset ), size ? VkDeviceSize( size ) : VkDeviceSize( vk_buffer->size), data );
 	}
 
+	void CommandBuffer::copy_buffer( BufferHandle source, u32 source_offset, BufferHandle destination, u32 destination_offset, u32 size )
+	{
+		Buffer* vk_source = device->access_buffer( source );
+		Buffer* vk_destination = device->access_buffer( destination );
+
+		static const VkPipelineStageFlags k_shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		// Write after read: an execution dependency is enough.
+		vkCmdPipelineBarrier( vk_command_buffer, k_shader_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr );
+
+		VkBufferCopy region{ source_offset, destination_offset, size };
+		vkCmdCopyBuffer( vk_command_buffer, vk_source->vk_buffer, vk_destination->vk_buffer, 1, &region );
+
+		VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = vk_destination->vk_buffer;
+		barrier.offset = destination_offset;
+		barrier.size = size;
+		vkCmdPipelineBarrier( vk_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, k_shader_stages, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+	}
+
+	void CommandBuffer::execute_commands( CommandBuffer** secondary_command_buffers, u32 num_command_buffers )
+	{
+		static const u32 k_max_batch = 16;
+		VkCommandBuffer vk_command_buffers[ k_max_batch ];
+
+		for ( u32 first = 0; first < num_command_buffers; first += k_max_batch )
+		{
+			const u32 count = num_command_buffers - first < k_max_batch ? num_command_buffers - first : k_max_batch;
+
+			for ( u32 i = 0; i < count; ++i )
+			{
+				vk_command_buffers[ i ] = secondary_command_buffers[ first + i ]->vk_command_buffer;
+			}
+
+			vkCmdExecuteCommands( vk_command_buffer, count, vk_command_buffers );
+		}
+
+		// State bound by the primary is undefined after executing secondary buffers.
+		invalidate_bindings();
+	}
+
 	void CommandBuffer::push_marker(const char* name)
 	{
 		device->push_gpu_timestamp( this, name );
@@ -4,6 +4,20 @@
 
 namespace Engine
 {
+	//
+	// Binds skipped because the same state was already bound in the command buffer.
+	//
+	struct ElidedBindCounters
+	{
+		u32						pipelines			= 0;
+		u32						vertex_buffers		= 0;
+		u32						index_buffers		= 0;
+		u32						descriptor_sets		= 0;
+
+		void					add( const ElidedBindCounters& other );
+
+	}; // struct ElidedBindCounters
+
 	//
 	//
 	struct CommandBuffer
@@ -11,11 +25,15 @@ namespace Engine
 		void					init( QueueType:: Enum type, u32 buffer_size, u32 submit_size, bool baked );
 		void					terminate();
 
+		void					begin_secondary( RenderPass* current_render_pass );	// Secondary buffers continue the render pass of the primary that executes them.
+		void					end();
+
 		//
 		// Commands Interface
 		//
 
-		void					bind_pass( RenderPassHandle handle );
+		void					bind_pass( RenderPassHandle handle, bool use_secondary = false );		// When use_secondary is set the pass content is recorded into secondary buffers.
+		void					end_current_render_pass();
 		void					bind_pipeline( PipelineHandle handle );
 		void					bind_vertex_buffer( BufferHandle handle, u32 binding, u32 offset );
 		void					bind_index_buffer( BufferHandle handle, u32 offset, VkIndexType index_type );
@@ -31,9 +49,13 @@ namespace Engine
 
 
 		void					fill_buffer( BufferHandle buffer, u32 offset, u32 size, u32 data );
+		// Outside of render passes. Waits for previous shader reads of the destination and makes the copy visible to later ones.
+		void					copy_buffer( BufferHandle source, u32 source_offset, BufferHandle destination, u32 destination_offset, u32 size );
+		void					execute_commands( CommandBuffer** secondary_command_buffers, u32 num_command_buffers );
 		void					push_marker( const char* name );
 		void					pop_marker();
 		void					reset();
+		void					invalidate_bindings();	// Forget the bound state, next binds are always emitted.
 
 		VkCommandBuffer			vk_command_buffer;
 
@@ -41,6 +63,21 @@ namespace Engine
 
 		VkDescriptorSet			vk_descriptor_sets[16];
 
+		// Last bound state, used to skip redundant binds.
+		VkPipeline				bound_pipeline;
+		VkBuffer				bound_vertex_buffers[ k_max_vertex_streams ];
+		VkDeviceSize			bound_vertex_offsets[ k_max_vertex_streams ];
+		VkBuffer				bound_index_buffer;
+		VkDeviceSize			bound_index_offset;
+		VkIndexType				bound_index_type;
+		VkPipelineLayout		bound_pipeline_layout;
+		VkDescriptorSet			bound_descriptor_sets[ 16 ];
+		u32						bound_dynamic_offsets[ 8 ];
+		u32						num_bound_descriptor_sets;
+		u32						num_bound_dynamic_offsets;
+
+		ElidedBindCounters		elided_binds;
+
 		RenderPass*				current_render_pass;
 		Pipeline*				current_pipeline;
 		VkClearValue			clears[2];						// 0 = color, 1 = depth_stencil
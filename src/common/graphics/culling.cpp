@@ -0,0 +1,198 @@
+#include "graphics/culling.h"
+
+#include <math.h>
+#include <immintrin.h>
+
+namespace Engine
+{
+	// Frustum //////////////////////////////////////////////////////////////
+
+	void Frustum::set_from_matrix( const f32* m )
+	{
+		// Gribb-Hartmann: planes are sums and differences of the 4th row with the other rows.
+		// Near uses the -w <= z convention, that is conservative for a [ 0, 1 ] depth range.
+		for ( u32 p = 0; p < 6; ++p )
+		{
+			const u32 row = p / 2;
+			const f32 sign = ( p & 1 ) ? -1.f : 1.f;
+
+			f32* plane = planes[ p ];
+			for ( u32 c = 0; c < 4; ++c )
+			{
+				plane[ c ] = m[ c * 4 + 3 ] + sign * m[ c * 4 + row ];
+			}
+
+			const f32 length = sqrtf( plane[ 0 ] * plane[ 0 ] + plane[ 1 ] * plane[ 1 ] + plane[ 2 ] * plane[ 2 ] );
+			if ( length > 0.f )
+			{
+				for ( u32 c = 0; c < 4; ++c )
+				{
+					plane[ c ] /= length;
+				}
+			}
+		}
+	}
+
+	// BoundsSoA ////////////////////////////////////////////////////////////
+
+	void BoundsSoA::init( Allocator* allocator, u32 initial_capacity )
+	{
+		center_x.init( allocator, initial_capacity );
+		center_y.init( allocator, initial_capacity );
+		center_z.init( allocator, initial_capacity );
+		extent_x.init( allocator, initial_capacity );
+		extent_y.init( allocator, initial_capacity );
+		extent_z.init( allocator, initial_capacity );
+
+		size = 0;
+	}
+
+	void BoundsSoA::shutdown()
+	{
+		center_x.shutdown();
+		center_y.shutdown();
+		center_z.shutdown();
+		extent_x.shutdown();
+		extent_y.shutdown();
+		extent_z.shutdown();
+	}
+
+	u32 BoundsSoA::add( const f32* min, const f32* max )
+	{
+		const u32 index = size++;
+
+		// Grow by whole lanes, unused lanes hold empty boxes at the origin.
+		if ( index == center_x.size )
+		{
+			Array<f32>* components[] = { &center_x, &center_y, &center_z, &extent_x, &extent_y, &extent_z };
+			for ( u32 c = 0; c < ArraySize( components ); ++c )
+			{
+				for ( u32 lane = 0; lane < k_lane_count; ++lane )
+				{
+					components[ c ]->push( 0.f );
+				}
+			}
+		}
+
+		center_x[ index ] = ( min[ 0 ] + max[ 0 ] ) * 0.5f;
+		center_y[ index ] = ( min[ 1 ] + max[ 1 ] ) * 0.5f;
+		center_z[ index ] = ( min[ 2 ] + max[ 2 ] ) * 0.5f;
+		extent_x[ index ] = ( max[ 0 ] - min[ 0 ] ) * 0.5f;
+		extent_y[ index ] = ( max[ 1 ] - min[ 1 ] ) * 0.5f;
+		extent_z[ index ] = ( max[ 2 ] - min[ 2 ] ) * 0.5f;
+
+		return index;
+	}
+
+	// Culling //////////////////////////////////////////////////////////////
+
+	// A box is outside a plane when its center distance plus its extents projected on the normal is negative.
+	u32 frustum_cull( const Frustum& frustum, const BoundsSoA& bounds, u8* out_visible )
+	{
+		const f32* center_x = bounds.center_x.data;
+		const f32* center_y = bounds.center_y.data;
+		const f32* center_z = bounds.center_z.data;
+		const f32* extent_x = bounds.extent_x.data;
+		const f32* extent_y = bounds.extent_y.data;
+		const f32* extent_z = bounds.extent_z.data;
+
+		u32 num_visible = 0;
+
+#if defined( __AVX__ )
+		static const u32 k_width = 8;
+
+		__m256 plane_x[ 6 ], plane_y[ 6 ], plane_z[ 6 ], plane_d[ 6 ];
+		__m256 abs_x[ 6 ], abs_y[ 6 ], abs_z[ 6 ];
+		for ( u32 p = 0; p < 6; ++p )
+		{
+			const f32* plane = frustum.planes[ p ];
+			plane_x[ p ] = _mm256_set1_ps( plane[ 0 ] );
+			plane_y[ p ] = _mm256_set1_ps( plane[ 1 ] );
+			plane_z[ p ] = _mm256_set1_ps( plane[ 2 ] );
+			plane_d[ p ] = _mm256_set1_ps( plane[ 3 ] );
+			abs_x[ p ] = _mm256_set1_ps( fabsf( plane[ 0 ] ) );
+			abs_y[ p ] = _mm256_set1_ps( fabsf( plane[ 1 ] ) );
+			abs_z[ p ] = _mm256_set1_ps( fabsf( plane[ 2 ] ) );
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+		for ( u32 i = 0; i < bounds.size; i += k_width )
+		{
+			const __m256 cx = _mm256_loadu_ps( center_x + i );
+			const __m256 cy = _mm256_loadu_ps( center_y + i );
+			const __m256 cz = _mm256_loadu_ps( center_z + i );
+			const __m256 ex = _mm256_loadu_ps( extent_x + i );
+			const __m256 ey = _mm256_loadu_ps( extent_y + i );
+			const __m256 ez = _mm256_loadu_ps( extent_z + i );
+
+			__m256 inside = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+			for ( u32 p = 0; p < 6; ++p )
+			{
+				__m256 distance = _mm256_add_ps( _mm256_mul_ps( cx, plane_x[ p ] ), plane_d[ p ] );
+				distance = _mm256_add_ps( distance, _mm256_mul_ps( cy, plane_y[ p ] ) );
+				distance = _mm256_add_ps( distance, _mm256_mul_ps( cz, plane_z[ p ] ) );
+				distance = _mm256_add_ps( distance, _mm256_mul_ps( ex, abs_x[ p ] ) );
+				distance = _mm256_add_ps( distance, _mm256_mul_ps( ey, abs_y[ p ] ) );
+				distance = _mm256_add_ps( distance, _mm256_mul_ps( ez, abs_z[ p ] ) );
+
+				inside = _mm256_and_ps( inside, _mm256_cmp_ps( distance, zero, _CMP_GE_OQ ) );
+			}
+
+			const u32 mask = ( u32 )_mm256_movemask_ps( inside );
+#else
+		static const u32 k_width = 4;
+
+		__m128 plane_x[ 6 ], plane_y[ 6 ], plane_z[ 6 ], plane_d[ 6 ];
+		__m128 abs_x[ 6 ], abs_y[ 6 ], abs_z[ 6 ];
+		for ( u32 p = 0; p < 6; ++p )
+		{
+			const f32* plane = frustum.planes[ p ];
+			plane_x[ p ] = _mm_set1_ps( plane[ 0 ] );
+			plane_y[ p ] = _mm_set1_ps( plane[ 1 ] );
+			plane_z[ p ] = _mm_set1_ps( plane[ 2 ] );
+			plane_d[ p ] = _mm_set1_ps( plane[ 3 ] );
+			abs_x[ p ] = _mm_set1_ps( fabsf( plane[ 0 ] ) );
+			abs_y[ p ] = _mm_set1_ps( fabsf( plane[ 1 ] ) );
+			abs_z[ p ] = _mm_set1_ps( fabsf( plane[ 2 ] ) );
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+		for ( u32 i = 0; i < bounds.size; i += k_width )
+		{
+			const __m128 cx = _mm_loadu_ps( center_x + i );
+			const __m128 cy = _mm_loadu_ps( center_y + i );
+			const __m128 cz = _mm_loadu_ps( center_z + i );
+			const __m128 ex = _mm_loadu_ps( extent_x + i );
+			const __m128 ey = _mm_loadu_ps( extent_y + i );
+			const __m128 ez = _mm_loadu_ps( extent_z + i );
+
+			__m128 inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+			for ( u32 p = 0; p < 6; ++p )
+			{
+				__m128 distance = _mm_add_ps( _mm_mul_ps( cx, plane_x[ p ] ), plane_d[ p ] );
+				distance = _mm_add_ps( distance, _mm_mul_ps( cy, plane_y[ p ] ) );
+				distance = _mm_add_ps( distance, _mm_mul_ps( cz, plane_z[ p ] ) );
+				distance = _mm_add_ps( distance, _mm_mul_ps( ex, abs_x[ p ] ) );
+				distance = _mm_add_ps( distance, _mm_mul_ps( ey, abs_y[ p ] ) );
+				distance = _mm_add_ps( distance, _mm_mul_ps( ez, abs_z[ p ] ) );
+
+				inside = _mm_and_ps( inside, _mm_cmpge_ps( distance, zero ) );
+			}
+
+			const u32 mask = ( u32 )_mm_movemask_ps( inside );
+#endif // __AVX__
+
+			// Padding lanes past the last box are not written.
+			const u32 num_lanes = bounds.size - i < k_width ? bounds.size - i : k_width;
+			for ( u32 lane = 0; lane < num_lanes; ++lane )
+			{
+				const u8 visible = ( mask >> lane ) & 1;
+				out_visible[ i + lane ] = visible;
+				num_visible += visible;
+			}
+		}
+
+		return num_visible;
+	}
+
+} // namespace Engine
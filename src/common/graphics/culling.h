@@ -0,0 +1,52 @@
+#pragma once
+
+#include "foundation/array.h"
+
+namespace Engine
+{
+	// Frustum //////////////////////////////////////////////////////////////
+
+	//
+	// Six planes ( a, b, c, d ), a point is inside when a * x + b * y + c * z + d >= 0 for every plane.
+	//
+	struct Frustum
+	{
+		// Extracts the planes from a column major clip matrix, in the space the matrix transforms from.
+		void								set_from_matrix( const f32* clip_matrix );
+
+		f32									planes[ 6 ][ 4 ];
+
+	}; // struct Frustum
+
+	// BoundsSoA ////////////////////////////////////////////////////////////
+
+	//
+	// Axis aligned boxes stored as center and half extents, one array per component.
+	// Arrays are padded with empty boxes to a multiple of k_lane_count so the culling loop has no tail.
+	//
+	struct BoundsSoA
+	{
+		void								init( Allocator* allocator, u32 initial_capacity );
+		void								shutdown();
+
+		u32									add( const f32* min, const f32* max );		// Returns the index of the box.
+
+		static const u32					k_lane_count		= 8;
+
+		Array<f32>							center_x;
+		Array<f32>							center_y;
+		Array<f32>							center_z;
+		Array<f32>							extent_x;
+		Array<f32>							extent_y;
+		Array<f32>							extent_z;
+
+		u32									size				= 0;
+
+	}; // struct BoundsSoA
+
+	// Writes 1 for boxes intersecting the frustum and 0 for the others, out_visible needs bounds.size entries.
+	// Boxes are tested 8 at a time with AVX when the build enables it, 4 at a time with SSE otherwise.
+	// Returns the number of visible boxes.
+	u32										frustum_cull( const Frustum& frustum, const BoundsSoA& bounds, u8* out_visible );
+
+} // namespace Engine
@@ -0,0 +1,152 @@
+#include "graphics/geometry_arena.h"
+#include "graphics/gpu_device.h"
+
+#include <string.h>
+
+namespace Engine
+{
+	// GeometryArena ////////////////////////////////////////////////////////
+
+	void GeometryArena::init( GpuDevice* gpu_, Allocator* allocator, const u32* stream_strides_, u32 num_streams_ )
+	{
+		RASSERT( num_streams_ <= k_max_streams );
+
+		gpu = gpu_;
+		num_streams = num_streams_;
+		num_vertices = 0;
+		num_indices_16 = 0;
+		num_indices_32 = 0;
+
+		for ( u32 s = 0; s < num_streams; ++s )
+		{
+			stream_strides[ s ] = stream_strides_[ s ];
+			vertex_data[ s ].init( allocator, 1024 * stream_strides[ s ] );
+			vertex_buffers[ s ] = k_invalid_buffer;
+		}
+
+		index_data_16.init( allocator, 1024 );
+		index_data_32.init( allocator, 1024 );
+		index_buffer_16 = k_invalid_buffer;
+		index_buffer_32 = k_invalid_buffer;
+	}
+
+	void GeometryArena::shutdown()
+	{
+		for ( u32 s = 0; s < num_streams; ++s )
+		{
+			vertex_data[ s ].shutdown();
+			if ( vertex_buffers[ s ].index != k_invalid_index )
+			{
+				gpu->destroy_buffer( vertex_buffers[ s ] );
+			}
+		}
+
+		index_data_16.shutdown();
+		index_data_32.shutdown();
+		if ( index_buffer_16.index != k_invalid_index )
+		{
+			gpu->destroy_buffer( index_buffer_16 );
+			gpu->destroy_buffer( index_buffer_32 );
+		}
+	}
+
+	u32 GeometryArena::allocate_vertices( u32 vertex_count )
+	{
+		RASSERTM( index_buffer_16.index == k_invalid_index, "Geometry arena already uploaded" );
+
+		const u32 vertex_offset = num_vertices;
+		num_vertices += vertex_count;
+
+		for ( u32 s = 0; s < num_streams; ++s )
+		{
+			Array<u8>& stream = vertex_data[ s ];
+			stream.set_size( num_vertices * stream_strides[ s ] );
+			memset( stream.data + vertex_offset * stream_strides[ s ], 0, vertex_count * stream_strides[ s ] );
+		}
+
+		return vertex_offset;
+	}
+
+	u32 GeometryArena::allocate_indices( u32 index_count, VkIndexType index_type )
+	{
+		RASSERTM( index_buffer_16.index == k_invalid_index, "Geometry arena already uploaded" );
+
+		if ( index_type == VK_INDEX_TYPE_UINT16 )
+		{
+			const u32 first_index = num_indices_16;
+			num_indices_16 += index_count;
+			index_data_16.set_size( num_indices_16 );
+
+			return first_index;
+		}
+
+		const u32 first_index = num_indices_32;
+		num_indices_32 += index_count;
+		index_data_32.set_size( num_indices_32 );
+
+		return first_index;
+	}
+
+	u8* GeometryArena::get_vertex_data( u32 stream, u32 vertex )
+	{
+		return vertex_data[ stream ].data + vertex * stream_strides[ stream ];
+	}
+
+	u16* GeometryArena::get_index_data_16( u32 first_index )
+	{
+		return index_data_16.data + first_index;
+	}
+
+	u32* GeometryArena::get_index_data_32( u32 first_index )
+	{
+		return index_data_32.data + first_index;
+	}
+
+	BufferHandle GeometryArena::get_index_buffer( VkIndexType index_type ) const
+	{
+		return index_type == VK_INDEX_TYPE_UINT16 ? index_buffer_16 : index_buffer_32;
+	}
+
+	void GeometryArena::upload( cstring name )
+	{
+		const u8* stream_data[ k_max_streams ];
+		for ( u32 s = 0; s < num_streams; ++s )
+		{
+			stream_data[ s ] = vertex_data[ s ].data;
+		}
+
+		upload( name, stream_data, num_vertices, index_data_16.data, num_indices_16, index_data_32.data, num_indices_32 );
+
+		for ( u32 s = 0; s < num_streams; ++s )
+		{
+			vertex_data[ s ].shutdown();
+		}
+		index_data_16.shutdown();
+		index_data_32.shutdown();
+	}
+
+	void GeometryArena::upload( cstring name, const u8* const* stream_data, u32 vertex_count, const u16* indices_16, u32 index_count_16,
+								const u32* indices_32, u32 index_count_32 )
+	{
+		RASSERTM( index_buffer_16.index == k_invalid_index, "Geometry arena already uploaded" );
+
+		num_vertices = vertex_count;
+		num_indices_16 = index_count_16;
+		num_indices_32 = index_count_32;
+
+		// Zero sized buffers are still created so draws can always bind every stream.
+		BufferCreation creation;
+		for ( u32 s = 0; s < num_streams; ++s )
+		{
+			creation.reset().set( VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, ResourceUsageType::Immutable, num_vertices * stream_strides[ s ] ).set_data( ( void* )stream_data[ s ] ).set_name( name );
+			vertex_buffers[ s ] = gpu->create_buffer( creation );
+		}
+
+		creation.reset().set( VK_BUFFER_USAGE_INDEX_BUFFER_BIT, ResourceUsageType::Immutable, num_indices_16 * sizeof( u16 ) ).set_data( ( void* )indices_16 ).set_name( name );
+		index_buffer_16 = gpu->create_buffer( creation );
+
+		creation.reset().set( VK_BUFFER_USAGE_INDEX_BUFFER_BIT, ResourceUsageType::Immutable, num_indices_32 * sizeof( u32 ) ).set_data( ( void* )indices_32 ).set_name( name );
+		index_buffer_32 = gpu->create_buffer( creation );
+	}
+
+} // namespace Engine
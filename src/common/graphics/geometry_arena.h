@@ -0,0 +1,61 @@
+#pragma once
+
+#include "graphics/gpu_resource.h"
+
+#include "foundation/array.h"
+
+namespace Engine
+{
+	struct GpuDevice;
+
+	// GeometryArena ////////////////////////////////////////////////////////
+
+	//
+	// Static geometry packed in one vertex buffer per stream, a 16 bit and a 32 bit index buffer.
+	// Meshes are sub-allocated on the CPU while importing, then everything is uploaded at once.
+	// Draws address their mesh with first_index and vertex_offset, so all draws share the same bindings.
+	//
+	struct GeometryArena
+	{
+		void								init( GpuDevice* gpu, Allocator* allocator, const u32* stream_strides, u32 num_streams );
+		void								shutdown();
+
+		// Reserves vertex_count zeroed vertices in every stream. Returns the vertex offset of the first one.
+		u32									allocate_vertices( u32 vertex_count );
+		// Returns the first index of the range reserved in the index buffer of that type.
+		// Indices are relative to the vertex offset of the mesh, so 16 bits suffice below 65536 vertices per mesh.
+		u32									allocate_indices( u32 index_count, VkIndexType index_type );
+
+		u8*									get_vertex_data( u32 stream, u32 vertex );
+		u16*								get_index_data_16( u32 first_index );
+		u32*								get_index_data_32( u32 first_index );
+
+		BufferHandle						get_index_buffer( VkIndexType index_type ) const;
+
+		// Creates the device local buffers and releases the CPU copy, the arena cannot grow afterwards.
+		void								upload( cstring name );
+		// Same, from geometry packed by an earlier import instead of the arena CPU copy. Nothing is allocated on the arena side.
+		void								upload( cstring name, const u8* const* stream_data, u32 vertex_count, const u16* indices_16, u32 index_count_16,
+													const u32* indices_32, u32 index_count_32 );
+
+		static const u32					k_max_streams		= 8;
+
+		GpuDevice*							gpu					= nullptr;
+
+		Array<u8>							vertex_data[ k_max_streams ];
+		Array<u16>							index_data_16;
+		Array<u32>							index_data_32;
+
+		u32									stream_strides[ k_max_streams ];
+		u32									num_streams			= 0;
+		u32									num_vertices		= 0;
+		u32									num_indices_16		= 0;
+		u32									num_indices_32		= 0;
+
+		BufferHandle						vertex_buffers[ k_max_streams ];
+		BufferHandle						index_buffer_16;
+		BufferHandle						index_buffer_32;
+
+	}; // struct GeometryArena
+
+} // namespace Engine
@@ -45,6 +45,8 @@ constexpr const T& raptor_max(const T& a, const T& b) {
 #include <SDL.h>
 #include <SDL_vulkan.h>
 
+#include <stdlib.h>
+
 namespace Engine
 {
 
@@ -61,63 +63,88 @@ namespace Engine
 
         CommandBuffer* get_command_buffer(u32 frame, bool begin);
         CommandBuffer* get_command_buffer_instant(u32 frame, bool begin);
+        CommandBuffer* get_secondary_command_buffer(u32 frame, u32 thread_index);
 
         static u16              pool_from_index(u32 index) { return (u16)index / k_buffer_per_pool; }
+        static u16              pool_from_indices(u32 frame_index, u32 thread_index) { return (u16)(frame_index * k_max_threads + thread_index); }
 
-        static const u16        k_max_threads = 1;
+        static const u16        k_max_threads = GpuDevice::k_max_threads;
         static const u16        k_max_pools = k_max_swapchain_images * k_max_threads;
         static const u16        k_buffer_per_pool = 4;
         static const u16        k_max_buffers = k_buffer_per_pool * k_max_pools;
+        static const u16        k_secondary_buffer_per_pool = 40;
+        static const u16        k_max_secondary_buffers = k_secondary_buffer_per_pool * k_max_pools;
 
         GpuDevice* gpu;
         VkCommandPool           vulkan_command_pools[k_max_pools];
         CommandBuffer           command_buffers[k_max_buffers];
+        CommandBuffer           secondary_command_buffers[k_max_secondary_buffers];
         u8                      next_free_per_thread_frame[k_max_pools];
+        u32                     num_threads;
 
     }; // struct CommandBufferRing
 
     void CommandBufferRing::init(GpuDevice* gpu_) {
 
         gpu = gpu_;
+        // Pools are created only for the threads that can record, each frame in flight has its own set.
+        num_threads = gpu->num_threads;
 
-        for (u32 i = 0; i < k_max_pools; i++) {
-            VkCommandPoolCreateInfo cmd_pool_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr };
-            cmd_pool_info.queueFamilyIndex = gpu->vulkan_queue_family;
-            cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        for (u32 frame = 0; frame < k_max_swapchain_images; frame++) {
+            for (u32 thread = 0; thread < num_threads; thread++) {
+                const u32 pool_index = pool_from_indices(frame, thread);
 
-            check(vkCreateCommandPool(gpu->vulkan_device, &cmd_pool_info, gpu->vulkan_allocation_callbacks, &vulkan_command_pools[i]));
-        }
+                VkCommandPoolCreateInfo cmd_pool_info = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr };
+                cmd_pool_info.queueFamilyIndex = gpu->vulkan_queue_family;
+                cmd_pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-        for (u32 i = 0; i < k_max_buffers; i++) {
-            VkCommandBufferAllocateInfo cmd = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr };
-            const u32 pool_index = pool_from_index(i);
-            cmd.commandPool = vulkan_command_pools[pool_index];
-            cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-            cmd.commandBufferCount = 1;
-            check(vkAllocateCommandBuffers(gpu->vulkan_device, &cmd, &command_buffers[i].vk_command_buffer));
+                check(vkCreateCommandPool(gpu->vulkan_device, &cmd_pool_info, gpu->vulkan_allocation_callbacks, &vulkan_command_pools[pool_index]));
+
+                for (u32 b = 0; b < k_buffer_per_pool; b++) {
+                    const u32 i = pool_index * k_buffer_per_pool + b;
+
+                    VkCommandBufferAllocateInfo cmd = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr };
+                    cmd.commandPool = vulkan_command_pools[pool_index];
+                    cmd.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                    cmd.commandBufferCount = 1;
+                    check(vkAllocateCommandBuffers(gpu->vulkan_device, &cmd, &command_buffers[i].vk_command_buffer));
+
+                    command_buffers[i].device = gpu;
+                    command_buffers[i].handle = i;
+                    command_buffers[i].reset();
+                }
 
-            command_buffers[i].device = gpu;
-            command_buffers[i].handle = i;
-            command_buffers[i].reset();
+                // Secondary buffers are allocated on first use by the owning thread.
+                for (u32 b = 0; b < k_secondary_buffer_per_pool; b++) {
+                    secondary_command_buffers[pool_index * k_secondary_buffer_per_pool + b].vk_command_buffer = VK_NULL_HANDLE;
+                }
+
+                next_free_per_thread_frame[pool_index] = 0;
+            }
         }
     }
 
     void CommandBufferRing::shutdown() {
-        for (u32 i = 0; i < k_max_swapchain_images * k_max_threads; i++) {
-            vkDestroyCommandPool(gpu->vulkan_device, vulkan_command_pools[i], gpu->vulkan_allocation_callbacks);
+        for (u32 frame = 0; frame < k_max_swapchain_images; frame++) {
+            for (u32 thread = 0; thread < num_threads; thread++) {
+                vkDestroyCommandPool(gpu->vulkan_device, vulkan_command_pools[pool_from_indices(frame, thread)], gpu->vulkan_allocation_callbacks);
+            }
         }
     }
 
     void CommandBufferRing::reset_pools(u32 frame_index) {
 
-        for (u32 i = 0; i < k_max_threads; i++) {
-            vkResetCommandPool(gpu->vulkan_device, vulkan_command_pools[frame_index * k_max_threads + i], 0);
+        for (u32 i = 0; i < num_threads; i++) {
+            const u32 pool_index = pool_from_indices(frame_index, i);
+            vkResetCommandPool(gpu->vulkan_device, vulkan_command_pools[pool_index], 0);
+
+            next_free_per_thread_frame[pool_index] = 0;
         }
     }
 
     CommandBuffer* CommandBufferRing::get_command_buffer(u32 frame, bool begin) {
-        // TODO: take in account threads
-        CommandBuffer* cb = &command_buffers[frame * k_buffer_per_pool];
+        // Primary buffers are always recorded by the main thread.
+        CommandBuffer* cb = &command_buffers[pool_from_indices(frame, 0) * k_buffer_per_pool];
 
         if (begin) {
             cb->reset();
@@ -131,7 +158,36 @@ namespace Engine
     }
 
     CommandBuffer* CommandBufferRing::get_command_buffer_instant(u32 frame, bool begin) {
-        CommandBuffer* cb = &command_buffers[frame * k_buffer_per_pool + 1];
+        CommandBuffer* cb = &command_buffers[pool_from_indices(frame, 0) * k_buffer_per_pool + 1];
+        // Recorded from scratch by the caller, nothing is bound yet.
+        cb->invalidate_bindings();
+        return cb;
+    }
+
+    CommandBuffer* CommandBufferRing::get_secondary_command_buffer(u32 frame, u32 thread_index) {
+        RASSERTM(thread_index < num_threads, "Thread index %u has no command pool, device created with %u threads", thread_index, num_threads);
+
+        // Only the owning thread touches its pool and counter, no locking needed.
+        const u32 pool_index = pool_from_indices(frame, thread_index);
+        const u32 buffer_index = next_free_per_thread_frame[pool_index]++;
+        RASSERTM(buffer_index < k_secondary_buffer_per_pool, "Out of secondary command buffers for thread %u", thread_index);
+
+        const u32 i = pool_index * k_secondary_buffer_per_pool + buffer_index;
+        CommandBuffer* cb = &secondary_command_buffers[i];
+
+        if (cb->vk_command_buffer == VK_NULL_HANDLE) {
+            VkCommandBufferAllocateInfo cmd = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr };
+            cmd.commandPool = vulkan_command_pools[pool_index];
+            cmd.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            cmd.commandBufferCount = 1;
+            check(vkAllocateCommandBuffers(gpu->vulkan_device, &cmd, &cb->vk_command_buffer));
+
+            cb->device = gpu;
+            cb->handle = i;
+        }
+
+        cb->reset();
+
         return cb;
     }
 
@@ -269,6 +325,7 @@ namespace Engine
         // 1. Perform common code
         allocator = creation.allocator;
         temporary_allocator = creation.temporary_allocator;
+        num_threads = raptor_min<u32>(raptor_max<u32>(creation.num_threads, 1), CommandBufferRing::k_max_threads);
         string_buffer.init(1024 * 1024, creation.allocator);
 
         //////// Init Vulkan instance.
@@ -415,23 +472,70 @@ namespace Engine
         s_ubo_alignment = vulkan_physical_properties.limits.minUniformBufferOffsetAlignment;
         s_ssbo_alignemnt = vulkan_physical_properties.limits.minStorageBufferOffsetAlignment;
 
+        //////// Find a transfer only queue family, used for uploads in parallel with rendering.
+        vulkan_transfer_queue_family = vulkan_queue_family;
+        {
+            u32 queue_family_count = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(vulkan_physical_device, &queue_family_count, nullptr);
+
+            VkQueueFamilyProperties* queue_families = (VkQueueFamilyProperties*)ralloca(sizeof(VkQueueFamilyProperties) * queue_family_count, allocator);
+            vkGetPhysicalDeviceQueueFamilyProperties(vulkan_physical_device, &queue_family_count, queue_families);
+
+            for (u32 family_index = 0; family_index < queue_family_count; ++family_index) {
+                VkQueueFamilyProperties queue_family = queue_families[family_index];
+                if (queue_family.queueCount > 0 && (queue_family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT)) == VK_QUEUE_TRANSFER_BIT) {
+                    vulkan_transfer_queue_family = family_index;
+                    break;
+                }
+            }
+
+            rfree(queue_families, allocator);
+        }
+
         //////// Create logical device
         u32 device_extension_count = 1;
         const char* device_extensions[] = { "VK_KHR_swapchain" };
         const float queue_priority[] = { 1.0f };
-        VkDeviceQueueCreateInfo queue_info[1] = {};
+        VkDeviceQueueCreateInfo queue_info[2] = {};
         queue_info[0].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queue_info[0].queueFamilyIndex = vulkan_queue_family;
         queue_info[0].queueCount = 1;
         queue_info[0].pQueuePriorities = queue_priority;
 
+        queue_info[1].sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queue_info[1].queueFamilyIndex = vulkan_transfer_queue_family;
+        queue_info[1].queueCount = 1;
+        queue_info[1].pQueuePriorities = queue_priority;
+
         // Enable all features: just pass the physical features 2 struct.
         VkPhysicalDeviceFeatures2 physical_features2 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+
+        // Descriptor indexing is core from Vulkan 1.2, chain its features to query and enable them with the rest.
+        VkPhysicalDeviceDescriptorIndexingFeatures indexing_features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES };
+        if (vulkan_physical_properties.apiVersion >= VK_API_VERSION_1_2) {
+            physical_features2.pNext = &indexing_features;
+        }
+
         vkGetPhysicalDeviceFeatures2(vulkan_physical_device, &physical_features2);
 
+        bindless_supported = indexing_features.descriptorBindingPartiallyBound && indexing_features.runtimeDescriptorArray &&
+            indexing_features.shaderSampledImageArrayNonUniformIndexing && indexing_features.descriptorBindingSampledImageUpdateAfterBind &&
+            indexing_features.descriptorBindingUpdateUnusedWhilePending;
+        rprint("Bindless textures %s\n", bindless_supported ? "supported" : "not supported");
+
+        // Scene images are compressed to these formats at import, they must be sampleable with optimal tiling.
+        texture_compression_bc_supported = physical_features2.features.textureCompressionBC == VK_TRUE;
+        const VkFormat bc_formats[] = { VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC5_UNORM_BLOCK, VK_FORMAT_BC7_UNORM_BLOCK };
+        for (u32 f = 0; f < ArraySize(bc_formats) && texture_compression_bc_supported; ++f) {
+            VkFormatProperties format_properties;
+            vkGetPhysicalDeviceFormatProperties(vulkan_physical_device, bc_formats[f], &format_properties);
+            texture_compression_bc_supported = (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+        }
+        rprint("BC texture compression %s\n", texture_compression_bc_supported ? "supported" : "not supported");
+
         VkDeviceCreateInfo device_create_info = {};
         device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        device_create_info.queueCreateInfoCount = sizeof(queue_info) / sizeof(queue_info[0]);
+        device_create_info.queueCreateInfoCount = vulkan_transfer_queue_family != vulkan_queue_family ? 2 : 1;
         device_create_info.pQueueCreateInfos = queue_info;
         device_create_info.enabledExtensionCount = device_extension_count;
         device_create_info.ppEnabledExtensionNames = device_extensions;
@@ -448,6 +552,7 @@ namespace Engine
         }
 
         vkGetDeviceQueue(vulkan_device, vulkan_queue_family, 0, &vulkan_queue);
+        vkGetDeviceQueue(vulkan_device, vulkan_transfer_queue_family, 0, &vulkan_transfer_queue);
 
         // Create Framebuffers
         int window_width, window_height;
@@ -505,6 +610,55 @@ namespace Engine
         result = vmaCreateAllocator(&allocatorInfo, &vma_allocator);
         check(result);
 
+        upload_manager.init(this, creation.staging_buffer_size);
+
+        //////// Create pipeline cache, seeded from the previous run when it comes from the same device and driver.
+        pipeline_cache_path[0] = 0;
+        if (creation.pipeline_cache_path) {
+            const int path_length = snprintf(pipeline_cache_path, ArraySize(pipeline_cache_path), "%s", creation.pipeline_cache_path);
+            if (path_length < 0 || path_length >= (int)ArraySize(pipeline_cache_path)) {
+                // A truncated path would read and write an unrelated file.
+                rprint("Pipeline cache path %s is too long, the cache is disabled.\n", creation.pipeline_cache_path);
+                pipeline_cache_path[0] = 0;
+            }
+        }
+
+        FileReadResult pipeline_cache_file{ nullptr, 0 };
+        if (pipeline_cache_path[0] && file_exists(pipeline_cache_path)) {
+            pipeline_cache_file = file_read_binary(pipeline_cache_path, allocator);
+        }
+
+        VkPipelineCacheCreateInfo pipeline_cache_info{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+        if (pipeline_cache_file.data && pipeline_cache_file.size >= sizeof(VkPipelineCacheHeaderVersionOne)) {
+            const VkPipelineCacheHeaderVersionOne* cache_header = (const VkPipelineCacheHeaderVersionOne*)pipeline_cache_file.data;
+
+            const bool cache_valid = cache_header->headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                cache_header->vendorID == vulkan_physical_properties.vendorID &&
+                cache_header->deviceID == vulkan_physical_properties.deviceID &&
+                memcmp(cache_header->pipelineCacheUUID, vulkan_physical_properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+            if (cache_valid) {
+                pipeline_cache_info.initialDataSize = pipeline_cache_file.size;
+                pipeline_cache_info.pInitialData = pipeline_cache_file.data;
+            }
+            else {
+                rprint("Pipeline cache %s was created by a different device or driver, discarding it.\n", pipeline_cache_path);
+            }
+        }
+
+        result = vkCreatePipelineCache(vulkan_device, &pipeline_cache_info, vulkan_allocation_callbacks, &vulkan_pipeline_cache);
+        if (result != VK_SUCCESS && pipeline_cache_info.pInitialData) {
+            // Header matched but the driver still refused the data, start empty.
+            pipeline_cache_info.initialDataSize = 0;
+            pipeline_cache_info.pInitialData = nullptr;
+            result = vkCreatePipelineCache(vulkan_device, &pipeline_cache_info, vulkan_allocation_callbacks, &vulkan_pipeline_cache);
+        }
+        check(result);
+
+        if (pipeline_cache_file.data) {
+            rfree(pipeline_cache_file.data, allocator);
+        }
+
         ////////  Create pools
         static const u32 k_global_pool_elements = 128;
         VkDescriptorPoolSize pool_sizes[] =
@@ -530,6 +684,55 @@ namespace Engine
         result = vkCreateDescriptorPool(vulkan_device, &pool_info, vulkan_allocation_callbacks, &vulkan_descriptor_pool);
         check(result);
 
+        //////// Create the global bindless texture array. Every texture is written at the index of its handle.
+        vulkan_bindless_descriptor_pool = VK_NULL_HANDLE;
+        vulkan_bindless_descriptor_set_layout = VK_NULL_HANDLE;
+        vulkan_bindless_descriptor_set = VK_NULL_HANDLE;
+
+        if (bindless_supported) {
+            VkDescriptorPoolSize bindless_pool_sizes[] =
+            {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, k_max_bindless_resources },
+            };
+
+            pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+            pool_info.maxSets = 1;
+            pool_info.poolSizeCount = (u32)ArraySize(bindless_pool_sizes);
+            pool_info.pPoolSizes = bindless_pool_sizes;
+            result = vkCreateDescriptorPool(vulkan_device, &pool_info, vulkan_allocation_callbacks, &vulkan_bindless_descriptor_pool);
+            check(result);
+
+            VkDescriptorSetLayoutBinding vk_binding{};
+            vk_binding.binding = k_bindless_texture_binding;
+            vk_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+            vk_binding.descriptorCount = k_max_bindless_resources;
+            vk_binding.stageFlags = VK_SHADER_STAGE_ALL;
+
+            // Slots without a texture are never written, slots of textures used by frames in flight are never rewritten.
+            VkDescriptorBindingFlags bindless_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+            VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+            binding_flags_info.bindingCount = 1;
+            binding_flags_info.pBindingFlags = &bindless_flags;
+
+            VkDescriptorSetLayoutCreateInfo layout_info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+            layout_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+            layout_info.bindingCount = 1;
+            layout_info.pBindings = &vk_binding;
+            layout_info.pNext = &binding_flags_info;
+
+            result = vkCreateDescriptorSetLayout(vulkan_device, &layout_info, vulkan_allocation_callbacks, &vulkan_bindless_descriptor_set_layout);
+            check(result);
+
+            VkDescriptorSetAllocateInfo alloc_info{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+            alloc_info.descriptorPool = vulkan_bindless_descriptor_pool;
+            alloc_info.descriptorSetCount = 1;
+            alloc_info.pSetLayouts = &vulkan_bindless_descriptor_set_layout;
+
+            result = vkAllocateDescriptorSets(vulkan_device, &alloc_info, &vulkan_bindless_descriptor_set);
+            check(result);
+        }
+
         // Create timestamp query pool used for GPU timings.
         VkQueryPoolCreateInfo vqpci{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, nullptr, 0, VK_QUERY_TYPE_TIMESTAMP, creation.gpu_time_queries_per_frame * 2u * k_max_frames, 0 };
         vkCreateQueryPool(vulkan_device, &vqpci, vulkan_allocation_callbacks, &vulkan_timestamp_query_pool);
@@ -579,6 +782,7 @@ namespace Engine
 
         resource_deletion_queue.init(allocator, 16);
         descriptor_set_updates.init(allocator, 16);
+        texture_to_update_bindless.init(allocator, 16);
 
         //
         // Init primitive resources
@@ -623,11 +827,30 @@ namespace Engine
         strcpy(vulkan_binaries_path, compiler_path);
         string_buffer.clear();
 
+        // Shader cache: measure what previous runs left, trimming it if the budget shrank.
+        shader_cache_path[0] = 0;
+        shader_cache_max_size = creation.shader_cache_max_size;
+        if (creation.shader_cache_path) {
+            const int path_length = snprintf(shader_cache_path, ArraySize(shader_cache_path), "%s", creation.shader_cache_path);
+            if (path_length < 0 || path_length >= (int)ArraySize(shader_cache_path)) {
+                // Same as the pipeline cache, a truncated path names an unrelated directory.
+                rprint("Shader cache path %s is too long, the cache is disabled.\n", creation.shader_cache_path);
+                shader_cache_path[0] = 0;
+            }
+            else if (!directory_create(shader_cache_path)) {
+                shader_cache_path[0] = 0;
+            }
+            else {
+                evict_shader_cache();
+            }
+        }
+
         // Dynamic buffer handling
         // TODO:
         dynamic_per_frame_size = 1024 * 1024 * 10;
         BufferCreation bc;
-        bc.set(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, ResourceUsageType::Immutable, dynamic_per_frame_size * k_max_frames).set_name("Dynamic_Persistent_Buffer");
+        // Also a copy source: data staged in it is copied to device local buffers.
+        bc.set(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, ResourceUsageType::Stream, dynamic_per_frame_size * k_max_frames).set_name("Dynamic_Persistent_Buffer").set_persistent(true);
         dynamic_buffer = create_buffer(bc);
 
         MapBufferParameters cb_map = { dynamic_buffer, 0, 0 };
@@ -643,6 +866,8 @@ namespace Engine
 
         command_buffer_ring.shutdown();
 
+        upload_manager.shutdown();
+
         for (size_t i = 0; i < k_max_swapchain_images; i++) {
             vkDestroySemaphore(vulkan_device, vulkan_render_complete_semaphore[i], vulkan_allocation_callbacks);
             vkDestroyFence(vulkan_device, vulkan_command_buffer_executed_fence[i], vulkan_allocation_callbacks);
@@ -666,6 +891,13 @@ namespace Engine
         destroy_buffer(dummy_constant_buffer);
         destroy_sampler(default_sampler);
 
+        // Textures destroyed below must not be written to the bindless array anymore.
+        if (bindless_supported) {
+            vkDestroyDescriptorSetLayout(vulkan_device, vulkan_bindless_descriptor_set_layout, vulkan_allocation_callbacks);
+            vkDestroyDescriptorPool(vulkan_device, vulkan_bindless_descriptor_pool, vulkan_allocation_callbacks);
+            vulkan_bindless_descriptor_set = VK_NULL_HANDLE;
+        }
+
         // Destroy all pending resources.
         for (u32 i = 0; i < resource_deletion_queue.size; i++) {
             ResourceUpdate& resource_deletion = resource_deletion_queue[i];
@@ -748,6 +980,7 @@ namespace Engine
 
         resource_deletion_queue.shutdown();
         descriptor_set_updates.shutdown();
+        texture_to_update_bindless.shutdown();
 
         //command_buffers.shutdown();
         pipelines.shutdown();
@@ -770,6 +1003,23 @@ namespace Engine
         vkDestroyDescriptorPool(vulkan_device, vulkan_descriptor_pool, vulkan_allocation_callbacks);
         vkDestroyQueryPool(vulkan_device, vulkan_timestamp_query_pool, vulkan_allocation_callbacks);
 
+        // Save pipeline cache for the next run.
+        if (pipeline_cache_path[0]) {
+            sizet cache_data_size = 0;
+            vkGetPipelineCacheData(vulkan_device, vulkan_pipeline_cache, &cache_data_size, nullptr);
+
+            if (cache_data_size) {
+                void* cache_data = ralloca(cache_data_size, allocator);
+                if (vkGetPipelineCacheData(vulkan_device, vulkan_pipeline_cache, &cache_data_size, cache_data) == VK_SUCCESS) {
+                    if (!file_write_binary(pipeline_cache_path, cache_data, cache_data_size)) {
+                        rprint("Cannot write pipeline cache to %s\n", pipeline_cache_path);
+                    }
+                }
+                rfree(cache_data, allocator);
+            }
+        }
+        vkDestroyPipelineCache(vulkan_device, vulkan_pipeline_cache, vulkan_allocation_callbacks);
+
         vkDestroyDevice(vulkan_device, vulkan_allocation_callbacks);
 
         vkDestroyInstance(vulkan_instance, vulkan_allocation_callbacks);
@@ -828,11 +1078,33 @@ namespace Engine
         texture->height = creation.height;
         texture->depth = creation.depth;
         texture->mipmaps = creation.mipmaps;
+
+        const bool generate_mips = (creation.flags & TextureFlags::GenerateMips_mask) == TextureFlags::GenerateMips_mask;
+        if (generate_mips) {
+            // Blits need linear filtering support, otherwise the texture keeps its single level.
+            VkFormatProperties format_properties;
+            vkGetPhysicalDeviceFormatProperties(gpu.vulkan_physical_device, creation.format, &format_properties);
+            const VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+            if ((format_properties.optimalTilingFeatures & blit_features) == blit_features) {
+                u32 max_dimension = raptor_max(raptor_max(creation.width, creation.height), creation.depth);
+                u8 mip_count = 1;
+                while (max_dimension > 1) {
+                    max_dimension >>= 1;
+                    ++mip_count;
+                }
+                texture->mipmaps = mip_count;
+            }
+            else {
+                texture->mipmaps = 1;
+            }
+        }
         texture->type = creation.type;
         texture->name = creation.name;
         texture->vk_format = creation.format;
         texture->sampler = nullptr;
         texture->flags = creation.flags;
+        texture->upload = 0;
 
         texture->handle = handle;
 
@@ -844,7 +1116,7 @@ namespace Engine
         image_info.extent.width = creation.width;
         image_info.extent.height = creation.height;
         image_info.extent.depth = creation.depth;
-        image_info.mipLevels = creation.mipmaps;
+        image_info.mipLevels = texture->mipmaps;
         image_info.arrayLayers = 1;
         image_info.samples = VK_SAMPLE_COUNT_1_BIT;
         image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -865,6 +1137,7 @@ namespace Engine
         else {
             image_info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // TODO
             image_info.usage |= is_render_target ? VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT : 0;
+            image_info.usage |= texture->mipmaps > 1 ? VK_IMAGE_USAGE_TRANSFER_SRC_BIT : 0;
         }
 
         image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -894,7 +1167,7 @@ namespace Engine
             info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
         }
 
-        info.subresourceRange.levelCount = 1;
+        info.subresourceRange.levelCount = texture->mipmaps;
         info.subresourceRange.layerCount = 1;
         check(vkCreateImageView(gpu.vulkan_device, &info, gpu.vulkan_allocation_callbacks, &texture->vk_image_view));
 
@@ -903,6 +1176,20 @@ namespace Engine
         texture->vk_image_layout = VK_IMAGE_LAYOUT_UNDEFINED;
     }
 
+    // Recorded into the current upload batch, submitted at the latest before the next frame.
+    // Pre-built mips follow level 0 in the data, largest first. Generated mips only need level 0.
+    static void vulkan_upload_texture_data(GpuDevice& gpu, Texture* texture, void* data) {
+        const bool generate_mips = (texture->flags & TextureFlags::GenerateMips_mask) == TextureFlags::GenerateMips_mask;
+        const u32 provided_levels = generate_mips ? 1 : texture->mipmaps;
+
+        u32 image_size = 0;
+        for (u32 level = 0; level < provided_levels; ++level) {
+            image_size += TextureFormat::level_size(texture->vk_format, raptor_max(texture->width >> level, 1), raptor_max(texture->height >> level, 1),
+                                                    raptor_max(texture->depth >> level, 1));
+        }
+        texture->upload = gpu.upload_manager.upload_texture(texture, data, image_size);
+    }
+
     TextureHandle GpuDevice::create_texture(const TextureCreation& creation) {
 
         u32 resource_index = textures.obtain_resource();
@@ -917,72 +1204,12 @@ namespace Engine
 
         //// Copy buffer_data if present
         if (creation.initial_data) {
-            // Create stating buffer
-            VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-            buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-            u32 image_size = creation.width * creation.height * 4;
-            buffer_info.size = image_size;
-
-            VmaAllocationCreateInfo memory_info{};
-            memory_info.flags = VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT;
-            memory_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
-
-            VmaAllocationInfo allocation_info{};
-            VkBuffer staging_buffer;
-            VmaAllocation staging_allocation;
-            check(vmaCreateBuffer(vma_allocator, &buffer_info, &memory_info,
-                &staging_buffer, &staging_allocation, &allocation_info));
-
-            // Copy buffer_data
-            void* destination_data;
-            vmaMapMemory(vma_allocator, staging_allocation, &destination_data);
-            memcpy(destination_data, creation.initial_data, static_cast<size_t>(image_size));
-            vmaUnmapMemory(vma_allocator, staging_allocation);
-
-            // Execute command buffer
-            VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-            CommandBuffer* command_buffer = get_instant_command_buffer();
-            vkBeginCommandBuffer(command_buffer->vk_command_buffer, &beginInfo);
-
-            VkBufferImageCopy region = {};
-            region.bufferOffset = 0;
-            region.bufferRowLength = 0;
-            region.bufferImageHeight = 0;
-
-            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            region.imageSubresource.mipLevel = 0;
-            region.imageSubresource.baseArrayLayer = 0;
-            region.imageSubresource.layerCount = 1;
-
-            region.imageOffset = { 0, 0, 0 };
-            region.imageExtent = { creation.width, creation.height, creation.depth };
-
-            // Transition
-            transition_image_layout(command_buffer->vk_command_buffer, texture->vk_image, texture->vk_format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, false);
-            // Copy
-            vkCmdCopyBufferToImage(command_buffer->vk_command_buffer, staging_buffer, texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-            // Transition
-            transition_image_layout(command_buffer->vk_command_buffer, texture->vk_image, texture->vk_format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, false);
-
-            vkEndCommandBuffer(command_buffer->vk_command_buffer);
-
-            // Submit command buffer
-            VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-            submitInfo.commandBufferCount = 1;
-            submitInfo.pCommandBuffers = &command_buffer->vk_command_buffer;
-
-            vkQueueSubmit(vulkan_queue, 1, &submitInfo, VK_NULL_HANDLE);
-            vkQueueWaitIdle(vulkan_queue);
-
-            vmaDestroyBuffer(vma_allocator, staging_buffer, staging_allocation);
-
-            // TODO: free command buffer
-            vkResetCommandBuffer(command_buffer->vk_command_buffer, VK_COMMAND_BUFFER_RESET_RELEASE_RESOURCES_BIT);
+            vulkan_upload_texture_data(*this, texture, creation.initial_data);
+        }
 
-            texture->vk_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        if (bindless_supported) {
+            RASSERTM(handle.index < k_max_bindless_resources, "Texture index %u does not fit the bindless array.", handle.index);
+            texture_to_update_bindless.push({ ResourceDeletionType::Texture, handle.index, current_frame });
         }
 
         return handle;
@@ -1023,73 +1250,257 @@ namespace Engine
         }
     }
 
+    // Bump when the compiler invocation changes in a way the cache key does not capture.
+    static const u32            k_shader_cache_version = 1;
+    static cstring              k_shader_compiler_target = "vulkan1.2";
+
+    static bool is_valid_spirv(const u32* code, sizet size) {
+        // Header is 5 words, starting with the SPIR-V magic number.
+        return code && size >= 20 && (size % 4) == 0 && code[0] == 0x07230203;
+    }
+
+    //
+    // Working state of a ShaderCompileJob while its compiler process runs.
+    struct ShaderCompileState {
+        char*                   stage_define;
+        char*                   cache_filename;
+        char*                   temp_filename;
+        char*                   spirv_filename;
+        Process                 process;
+    }; // struct ShaderCompileState
+
+    static const u32            k_shader_compile_output_size = rkilo(4);
+
     VkShaderModuleCreateInfo GpuDevice::compile_shader(cstring code, u32 code_size, VkShaderStageFlagBits stage, cstring name) {
 
-        VkShaderModuleCreateInfo shader_create_info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+        ShaderCompileJob job;
+        job.code = code;
+        job.code_size = code_size;
+        job.stage = stage;
+        job.name = name;
 
-        // Compile from glsl to SpirV.
-        // TODO: detect if input is HLSL.
-        const char* temp_filename = "temp.shader";
+        compile_shaders(&job, 1);
 
-        // Write current shader to file.
-        FILE* temp_shader_file = fopen(temp_filename, "w");
-        fwrite(code, code_size, 1, temp_shader_file);
-        fclose(temp_shader_file);
+        return job.shader_create_info;
+    }
+
+    u32 GpuDevice::compile_shaders(ShaderCompileJob* jobs, u32 count) {
 
-        sizet current_marker = temporary_allocator->get_marker();
         StringBuffer temp_string_buffer;
-        temp_string_buffer.init(rkilo(1), temporary_allocator);
+        temp_string_buffer.init(rkilo(2) * count, temporary_allocator);
+
+        ShaderCompileState* states = (ShaderCompileState*)ralloca(sizeof(ShaderCompileState) * count, temporary_allocator);
+        u32* pending_jobs = (u32*)ralloca(sizeof(u32) * count, temporary_allocator);
+        u32* running_jobs = (u32*)ralloca(sizeof(u32) * count, temporary_allocator);
+        u32 num_pending_jobs = 0;
+        u32 num_compiled = 0;
+
+        for (u32 j = 0; j < count; ++j) {
+            ShaderCompileJob& job = jobs[j];
+            ShaderCompileState& state = states[j];
+
+            job.shader_create_info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+            job.output = nullptr;
+            job.exit_code = 0;
+
+            state.cache_filename = nullptr;
+
+            // Add uppercase define as STAGE_NAME
+            state.stage_define = temp_string_buffer.append_use_f("%s_%s", to_stage_defines(job.stage), job.name);
+            sizet stage_define_length = strlen(state.stage_define);
+            for (u32 i = 0; i < stage_define_length; ++i) {
+                state.stage_define[i] = toupper(state.stage_define[i]);
+            }
 
-        // Add uppercase define as STAGE_NAME
-        char* stage_define = temp_string_buffer.append_use_f("%s_%s", to_stage_defines(stage), name);
-        sizet stage_define_length = strlen(stage_define);
-        for (u32 i = 0; i < stage_define_length; ++i) {
-            stage_define[i] = toupper(stage_define[i]);
+            // Look for SPIR-V compiled from the same source, stage, defines and target before spawning the compiler.
+            if (shader_cache_path[0]) {
+                char* cache_key_string = temp_string_buffer.append_use_f("%s %s %s %s", to_compiler_extension(job.stage), state.stage_define, to_stage_defines(job.stage), k_shader_compiler_target);
+                u64 cache_key = hash_bytes((void*)job.code, job.code_size, k_shader_cache_version);
+                cache_key = hash_bytes(cache_key_string, strlen(cache_key_string), cache_key);
+
+                state.cache_filename = temp_string_buffer.append_use_f("%s/%016llx.spv", shader_cache_path, (unsigned long long)cache_key);
+
+                sizet cached_size = 0;
+                char* cached_code = file_read_binary(state.cache_filename, temporary_allocator, &cached_size);
+                if (is_valid_spirv(reinterpret_cast<const u32*>(cached_code), cached_size)) {
+                    job.shader_create_info.pCode = reinterpret_cast<const u32*>(cached_code);
+                    job.shader_create_info.codeSize = cached_size;
+                    ++num_compiled;
+                    continue;
+                }
+            }
+
+            pending_jobs[num_pending_jobs++] = j;
         }
-        // Compile to SPV
+
+        // One compiler process per thread at most, jobs complete in launch order.
+        const u32 max_running = num_threads;
+        const u32 process_id = process_get_id();
+        u32 num_launched = 0;
+        u32 num_collected = 0;
+
+        for (u32 p = 0; p < num_pending_jobs || num_collected < num_launched;) {
+
+            if (p < num_pending_jobs && num_launched - num_collected < max_running) {
+                const u32 job_index = pending_jobs[p++];
+                ShaderCompileJob& job = jobs[job_index];
+                ShaderCompileState& state = states[job_index];
+
+                // Compile from glsl to SpirV.
+                // TODO: detect if input is HLSL.
+                // Names are unique per process and compile, so jobs (and other running instances) do not collide.
+                const u32 compile_index = shader_compile_counter++;
+                state.temp_filename = temp_string_buffer.append_use_f("temp_%u_%u.shader", process_id, compile_index);
+                state.spirv_filename = temp_string_buffer.append_use_f("temp_%u_%u.spv", process_id, compile_index);
+
+                // Write current shader to file.
+                FILE* temp_shader_file = fopen(state.temp_filename, "w");
+                if (!temp_shader_file) {
+                    rprint("Cannot write temporary shader file %s\n", state.temp_filename);
+                    job.exit_code = -1;
+                    continue;
+                }
+                fwrite(job.code, job.code_size, 1, temp_shader_file);
+                fclose(temp_shader_file);
+
+                // Compile to SPV
 #if defined(_MSC_VER)
-        char* glsl_compiler_path = temp_string_buffer.append_use_f("%sglslangValidator.exe", vulkan_binaries_path);
-        char* final_spirv_filename = temp_string_buffer.append_use("shader_final.spv");
-        // TODO: add optional debug information in shaders (option -g).
-        char* arguments = temp_string_buffer.append_use_f("glslangValidator.exe %s -V --target-env vulkan1.2 -o %s -S %s --D %s --D %s", temp_filename, final_spirv_filename, to_compiler_extension(stage), stage_define, to_stage_defines(stage));
+                char* glsl_compiler_path = temp_string_buffer.append_use_f("%sglslangValidator.exe", vulkan_binaries_path);
+                // TODO: add optional debug information in shaders (option -g).
+                char* arguments = temp_string_buffer.append_use_f("glslangValidator.exe %s -V --target-env %s -o %s -S %s --D %s --D %s", state.temp_filename, k_shader_compiler_target, state.spirv_filename, to_compiler_extension(job.stage), state.stage_define, to_stage_defines(job.stage));
 #else
-        char* glsl_compiler_path = temp_string_buffer.append_use_f("%sglslangValidator", vulkan_binaries_path);
-        char* final_spirv_filename = temp_string_buffer.append_use("shader_final.spv");
-        char* arguments = temp_string_buffer.append_use_f("%s -V --target-env vulkan1.2 -o %s -S %s --D %s --D %s", temp_filename, final_spirv_filename, to_compiler_extension(stage), stage_define, to_stage_defines(stage));
+                char* glsl_compiler_path = temp_string_buffer.append_use_f("%sglslangValidator", vulkan_binaries_path);
+                char* arguments = temp_string_buffer.append_use_f("%s -V --target-env %s -o %s -S %s --D %s --D %s", state.temp_filename, k_shader_compiler_target, state.spirv_filename, to_compiler_extension(job.stage), state.stage_define, to_stage_defines(job.stage));
 #endif
-        process_execute(".", glsl_compiler_path, arguments, "");
+                if (!process_spawn(state.process, ".", glsl_compiler_path, arguments)) {
+                    job.exit_code = -1;
+                    file_delete(state.temp_filename);
+                    continue;
+                }
 
-        bool optimize_shaders = false;
+                running_jobs[num_launched++] = job_index;
+                continue;
+            }
+
+            // Collect the oldest running compile.
+            const u32 job_index = running_jobs[num_collected++];
+
+            ShaderCompileJob& job = jobs[job_index];
+            ShaderCompileState& state = states[job_index];
+
+            char* output = (char*)ralloca(k_shader_compile_output_size, temporary_allocator);
+            job.exit_code = process_wait(state.process, output, k_shader_compile_output_size);
+            job.output = output;
 
-        if (optimize_shaders) {
-            // TODO: add optional optimization stage
-            //"spirv-opt -O input -o output
-            char* spirv_optimizer_path = temp_string_buffer.append_use_f("%sspirv-opt.exe", vulkan_binaries_path);
-            char* optimized_spirv_filename = temp_string_buffer.append_use_f("shader_opt.spv");
-            char* spirv_opt_arguments = temp_string_buffer.append_use_f("spirv-opt.exe -O --preserve-bindings %s -o %s", final_spirv_filename, optimized_spirv_filename);
+            bool optimize_shaders = false;
 
-            process_execute(".", spirv_optimizer_path, spirv_opt_arguments, "");
+            if (optimize_shaders) {
+                // TODO: add optional optimization stage
+                //"spirv-opt -O input -o output
+                char* spirv_optimizer_path = temp_string_buffer.append_use_f("%sspirv-opt.exe", vulkan_binaries_path);
+                char* optimized_spirv_filename = temp_string_buffer.append_use_f("temp_%u_%u_opt.spv", process_id, shader_compile_counter++);
+                char* spirv_opt_arguments = temp_string_buffer.append_use_f("spirv-opt.exe -O --preserve-bindings %s -o %s", state.spirv_filename, optimized_spirv_filename);
 
-            // Read back SPV file.
-            shader_create_info.pCode = reinterpret_cast<const u32*>(file_read_binary(optimized_spirv_filename, temporary_allocator, &shader_create_info.codeSize));
+                process_execute(".", spirv_optimizer_path, spirv_opt_arguments, "");
 
-            file_delete(optimized_spirv_filename);
+                // Read back SPV file.
+                job.shader_create_info.pCode = reinterpret_cast<const u32*>(file_read_binary(optimized_spirv_filename, temporary_allocator, &job.shader_create_info.codeSize));
+
+                file_delete(optimized_spirv_filename);
+            }
+            else {
+                // Read back SPV file.
+                job.shader_create_info.pCode = reinterpret_cast<const u32*>(file_read_binary(state.spirv_filename, temporary_allocator, &job.shader_create_info.codeSize));
+            }
+
+            // Handling compilation error
+            if (job.shader_create_info.pCode == nullptr) {
+                rprint("%s\n", job.output);
+
+                StringBuffer dump_string_buffer;
+                dump_string_buffer.init(rkilo(1), temporary_allocator);
+                dump_shader_code(dump_string_buffer, job.code, job.stage, job.name);
+            }
+            else {
+                ++num_compiled;
+
+                if (state.cache_filename && is_valid_spirv(job.shader_create_info.pCode, job.shader_create_info.codeSize)) {
+                    if (file_write_binary(state.cache_filename, (void*)job.shader_create_info.pCode, job.shader_create_info.codeSize)) {
+                        shader_cache_size += job.shader_create_info.codeSize;
+                    }
+                }
+            }
+
+            // Temporary files cleanup
+            file_delete(state.temp_filename);
+            file_delete(state.spirv_filename);
         }
-        else {
-            // Read back SPV file.
-            shader_create_info.pCode = reinterpret_cast<const u32*>(file_read_binary(final_spirv_filename, temporary_allocator, &shader_create_info.codeSize));
+
+        if (shader_cache_path[0] && shader_cache_size > shader_cache_max_size) {
+            evict_shader_cache();
+        }
+
+        return num_compiled;
+    }
+
+    struct ShaderCacheEntry {
+        u64                     key;
+        u64                     last_write_time;
+        sizet                   size;
+    }; // struct ShaderCacheEntry
+
+    static void shader_cache_enumerate(cstring path, sizet size, u64 last_write_time, void* user_data) {
+        Array<ShaderCacheEntry>& entries = *(Array<ShaderCacheEntry>*)user_data;
+
+        cstring filename = strrchr(path, '/');
+        if (!filename) {
+            filename = strrchr(path, '\\');
         }
+        filename = filename ? filename + 1 : path;
 
-        // Handling compilation error
-        if (shader_create_info.pCode == nullptr) {
-            dump_shader_code(temp_string_buffer, code, stage, name);
+        // Only files named as cache keys belong to the cache.
+        char* key_end = nullptr;
+        const u64 key = strtoull(filename, &key_end, 16);
+        if (key_end == filename || strcmp(key_end, ".spv") != 0) {
+            return;
         }
 
-        // Temporary files cleanup
-        file_delete(temp_filename);
-        file_delete(final_spirv_filename);
+        entries.push({ key, last_write_time, size });
+    }
 
-        return shader_create_info;
+    static int shader_cache_entry_compare(const void* a, const void* b) {
+        const ShaderCacheEntry* entry_a = (const ShaderCacheEntry*)a;
+        const ShaderCacheEntry* entry_b = (const ShaderCacheEntry*)b;
+        return entry_a->last_write_time < entry_b->last_write_time ? -1 : (entry_a->last_write_time > entry_b->last_write_time ? 1 : 0);
+    }
+
+    void GpuDevice::evict_shader_cache() {
+
+        Array<ShaderCacheEntry> entries;
+        entries.init(allocator, 64);
+
+        directory_enumerate_files(shader_cache_path, shader_cache_enumerate, &entries);
+
+        shader_cache_size = 0;
+        for (u32 i = 0; i < entries.size; ++i) {
+            shader_cache_size += entries[i].size;
+        }
+
+        if (shader_cache_size > shader_cache_max_size) {
+            // Delete the oldest written entries, leaving headroom so that the next compiles do not evict again.
+            qsort(entries.data, entries.size, sizeof(ShaderCacheEntry), shader_cache_entry_compare);
+
+            const sizet target_size = shader_cache_max_size / 4 * 3;
+            char entry_path[k_max_path];
+            for (u32 i = 0; i < entries.size && shader_cache_size > target_size; ++i) {
+                snprintf(entry_path, k_max_path, "%s/%016llx.spv", shader_cache_path, (unsigned long long)entries[i].key);
+                if (file_delete(entry_path)) {
+                    shader_cache_size -= entries[i].size;
+                }
+            }
+        }
+
+        entries.shutdown();
     }
 
     ShaderStateHandle GpuDevice::create_shader_state(const ShaderStateCreation& creation) {
@@ -1115,6 +1526,19 @@ namespace Engine
 
         sizet current_temporary_marker = temporary_allocator->get_marker();
 
+        // Compile all stages at once, each in its own compiler process.
+        ShaderCompileJob compile_jobs[k_max_shader_stages];
+        if (!creation.spv_input) {
+            for (u32 i = 0; i < creation.stages_count; ++i) {
+                compile_jobs[i].code = creation.stages[i].code;
+                compile_jobs[i].code_size = creation.stages[i].code_size;
+                compile_jobs[i].stage = creation.stages[i].type;
+                compile_jobs[i].name = creation.name;
+            }
+
+            compile_shaders(compile_jobs, creation.stages_count);
+        }
+
         for (compiled_shaders = 0; compiled_shaders < creation.stages_count; ++compiled_shaders) {
             const ShaderStage& stage = creation.stages[compiled_shaders];
 
@@ -1130,7 +1554,7 @@ namespace Engine
                 shader_create_info.pCode = reinterpret_cast<const u32*>(stage.code);
             }
             else {
-                shader_create_info = compile_shader(stage.code, stage.code_size, stage.type, creation.name);
+                shader_create_info = compile_jobs[compiled_shaders].shader_create_info;
             }
 
             // Compile shader module
@@ -1208,9 +1632,18 @@ namespace Engine
             vk_layouts[l] = pipeline->descriptor_set_layout[l]->vk_descriptor_set_layout;
         }
 
+        // The bindless textures set follows the pipeline own sets.
+        u32 num_vk_layouts = creation.num_active_layouts;
+        pipeline->bindless_set_index = u32_max;
+        if (bindless_supported) {
+            RASSERT(num_vk_layouts < k_max_descriptor_set_layouts);
+            pipeline->bindless_set_index = num_vk_layouts;
+            vk_layouts[num_vk_layouts++] = vulkan_bindless_descriptor_set_layout;
+        }
+
         VkPipelineLayoutCreateInfo pipeline_layout_info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
         pipeline_layout_info.pSetLayouts = vk_layouts;
-        pipeline_layout_info.setLayoutCount = creation.num_active_layouts;
+        pipeline_layout_info.setLayoutCount = num_vk_layouts;
 
         VkPipelineLayout pipeline_layout;
         check(vkCreatePipelineLayout(vulkan_device, &pipeline_layout_info, vulkan_allocation_callbacks, &pipeline_layout));
@@ -1394,7 +1827,7 @@ namespace Engine
 
             pipeline_info.pDynamicState = &dynamic_state;
 
-            vkCreateGraphicsPipelines(vulkan_device, VK_NULL_HANDLE, 1, &pipeline_info, vulkan_allocation_callbacks, &pipeline->vk_pipeline);
+            vkCreateGraphicsPipelines(vulkan_device, vulkan_pipeline_cache, 1, &pipeline_info, vulkan_allocation_callbacks, &pipeline->vk_pipeline);
 
             pipeline->vk_bind_point = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_GRAPHICS;
         }
@@ -1404,7 +1837,7 @@ namespace Engine
             pipeline_info.stage = shader_state_data->shader_stage_info[0];
             pipeline_info.layout = pipeline_layout;
 
-            vkCreateComputePipelines(vulkan_device, VK_NULL_HANDLE, 1, &pipeline_info, vulkan_allocation_callbacks, &pipeline->vk_pipeline);
+            vkCreateComputePipelines(vulkan_device, vulkan_pipeline_cache, 1, &pipeline_info, vulkan_allocation_callbacks, &pipeline->vk_pipeline);
 
             pipeline->vk_bind_point = VkPipelineBindPoint::VK_PIPELINE_BIND_POINT_COMPUTE;
         }
@@ -1440,9 +1873,17 @@ namespace Engine
         buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | creation.type_flags;
         buffer_info.size = creation.size > 0 ? creation.size : 1;       // 0 sized creations are not permitted.
 
+        // Immutable data is never written by the CPU after creation: keep it in device local memory
+        // and fill it with a staging copy. Host visible memory is left to Stream and Dynamic buffers.
+        const bool device_local = creation.usage == ResourceUsageType::Immutable;
+        RASSERTM(!(device_local && creation.persistent), "Immutable buffers are device local and cannot be persistently mapped.");
+
         VmaAllocationCreateInfo memory_info{};
         memory_info.flags = VMA_ALLOCATION_CREATE_STRATEGY_BEST_FIT_BIT;
-        memory_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        memory_info.usage = device_local ? VMA_MEMORY_USAGE_GPU_ONLY : VMA_MEMORY_USAGE_CPU_TO_GPU;
+        if (creation.persistent && !device_local) {
+            memory_info.flags |= VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        }
 
         VmaAllocationInfo allocation_info{};
         check(vmaCreateBuffer(vma_allocator, &buffer_info, &memory_info,
@@ -1451,20 +1892,27 @@ namespace Engine
         set_resource_name(VK_OBJECT_TYPE_BUFFER, (u64)buffer->vk_buffer, creation.name);
 
         buffer->vk_device_memory = allocation_info.deviceMemory;
-
-        if (creation.initial_data) {
+        buffer->upload = 0;
+        // Stays valid until the buffer is destroyed.
+        buffer->mapped_data = (u8*)allocation_info.pMappedData;
+
+        if (creation.initial_data && device_local) {
+            // Batched with the other pending uploads, submitted before the next frame.
+            if (creation.size > 0) {
+                buffer->upload = upload_manager.upload_buffer(buffer, 0, creation.initial_data, creation.size);
+            }
+        }
+        else if (creation.initial_data && buffer->mapped_data) {
+            memcpy(buffer->mapped_data, creation.initial_data, (size_t)creation.size);
+            vmaFlushAllocation(vma_allocator, buffer->vma_allocation, 0, creation.size);
+        }
+        else if (creation.initial_data) {
             void* data;
             vmaMapMemory(vma_allocator, buffer->vma_allocation, &data);
             memcpy(data, creation.initial_data, (size_t)creation.size);
             vmaUnmapMemory(vma_allocator, buffer->vma_allocation);
         }
 
-        // TODO
-        //if ( persistent )
-        //{
-        //    mapped_data = static_cast<uint8_t *>(allocation_info.pMappedData);
-        //}
-
         return handle;
     }
 
@@ -1491,6 +1939,7 @@ namespace Engine
         create_info.minFilter = creation.min_filter;
         create_info.magFilter = creation.mag_filter;
         create_info.mipmapMode = creation.mip_filter;
+        create_info.maxLod = VK_LOD_CLAMP_NONE;
         create_info.anisotropyEnable = 0;
         create_info.compareEnable = 0;
         create_info.unnormalizedCoordinates = 0;
@@ -1538,6 +1987,11 @@ namespace Engine
             binding.type = input_binding.type;
             binding.name = input_binding.name;
 
+            // Textures at the bindless binding are read from the global bindless set instead.
+            if (bindless_supported && binding.start == k_bindless_texture_binding && binding.type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER) {
+                continue;
+            }
+
             VkDescriptorSetLayoutBinding& vk_binding = descriptor_set_layout->vk_binding[used_bindings];
             ++used_bindings;
 
@@ -1811,40 +2265,13 @@ namespace Engine
         render_pass->width = gpu.swapchain_width;
         render_pass->height = gpu.swapchain_height;
 
-        // Manually transition the texture
-        VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        CommandBuffer* command_buffer = gpu.get_instant_command_buffer();
-        vkBeginCommandBuffer(command_buffer->vk_command_buffer, &beginInfo);
-
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-
-        region.imageOffset = { 0, 0, 0 };
-        region.imageExtent = { gpu.swapchain_width, gpu.swapchain_height, 1 };
+        // Manually transition the swapchain images. Executed on the graphics queue with the next upload batch.
+        VkCommandBuffer command_buffer = gpu.upload_manager.get_graphics_command_buffer();
 
         // Transition
         for (size_t i = 0; i < gpu.vulkan_swapchain_image_count; i++) {
-            transition_image_layout(command_buffer->vk_command_buffer, gpu.vulkan_swapchain_images[i], gpu.vulkan_surface_format.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false);
+            transition_image_layout(command_buffer, gpu.vulkan_swapchain_images[i], gpu.vulkan_surface_format.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, false);
         }
-
-        vkEndCommandBuffer(command_buffer->vk_command_buffer);
-
-        // Submit command buffer
-        VkSubmitInfo submitInfo = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &command_buffer->vk_command_buffer;
-
-        vkQueueSubmit(gpu.vulkan_queue, 1, &submitInfo, VK_NULL_HANDLE);
-        vkQueueWaitIdle(gpu.vulkan_queue);
     }
 
     static void vulkan_create_framebuffer(GpuDevice& gpu, RenderPass* render_pass, const TextureHandle* output_textures, u32 num_render_targets, TextureHandle depth_stencil_texture) {
@@ -2185,6 +2612,22 @@ namespace Engine
             //rprint( "Destroying image view %x %u\n", v_texture->vk_image_view, v_texture->handle.index );
             vkDestroyImageView(vulkan_device, v_texture->vk_image_view, vulkan_allocation_callbacks);
             vmaDestroyImage(vma_allocator, v_texture->vk_image, v_texture->vma_allocation);
+
+            // Frames that could sample it are done, point the bindless slot back to the dummy texture.
+            if (vulkan_bindless_descriptor_set != VK_NULL_HANDLE && texture != dummy_texture.index) {
+                Texture* dummy = access_texture(dummy_texture);
+
+                VkDescriptorImageInfo image_info{ access_sampler(default_sampler)->vk_sampler, dummy->vk_image_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+                VkWriteDescriptorSet descriptor_write{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+                descriptor_write.dstSet = vulkan_bindless_descriptor_set;
+                descriptor_write.dstBinding = k_bindless_texture_binding;
+                descriptor_write.dstArrayElement = texture;
+                descriptor_write.descriptorCount = 1;
+                descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptor_write.pImageInfo = &image_info;
+
+                vkUpdateDescriptorSets(vulkan_device, 1, &descriptor_write, 0, nullptr);
+            }
         }
         textures.release_resource(texture);
     }
@@ -2398,8 +2841,29 @@ namespace Engine
         vulkan_create_texture(gpu, tc, v_texture->handle, v_texture);
     }
 
+    TextureHandle GpuDevice::recreate_texture(TextureHandle texture, u16 width, u16 height, u8 mipmaps, void* data) {
+        Texture* vk_texture = access_texture(texture);
+        RASSERT(vk_texture != nullptr);
+
+        TextureCreation tc;
+        tc.set_flags(mipmaps, vk_texture->flags).set_format_type(vk_texture->vk_format, vk_texture->type).set_name(vk_texture->name).set_size(width, height, 1).set_data(data);
+
+        // A new handle is a new bindless slot: frames in flight keep sampling the previous image from the old one,
+        // which is released by the deferred deletion once they completed.
+        TextureHandle new_texture = create_texture(tc);
+        if (new_texture.index != k_invalid_index) {
+            access_texture(new_texture)->sampler = vk_texture->sampler;
+            destroy_texture(texture);
+        }
+
+        return new_texture;
+    }
+
     void GpuDevice::resize_swapchain() {
 
+        // Pending transitions reference the old swapchain images.
+        upload_manager.flush();
+
         vkDeviceWaitIdle(vulkan_device);
 
         VkSurfaceCapabilitiesKHR surface_capabilities;
@@ -2533,6 +2997,10 @@ namespace Engine
                 vulkan_resize_texture(*this, vk_texture, vk_texture_to_delete, new_width, new_height, 1);
 
                 destroy_texture(texture_to_delete);
+
+                if (bindless_supported) {
+                    texture_to_update_bindless.push({ ResourceDeletionType::Texture, texture.index, current_frame });
+                }
             }
 
             if (vk_render_pass->output_depth.index != k_invalid_index) {
@@ -2607,6 +3075,8 @@ namespace Engine
         vkResetFences(vulkan_device, 1, render_complete_fence);
         // Command pool reset
         command_buffer_ring.reset_pools(current_frame);
+        // Release staging memory of completed uploads
+        upload_manager.update();
         // Dynamic memory update
         const u32 used_size = dynamic_allocated_size - (dynamic_per_frame_size * previous_frame);
         dynamic_max_per_frame_size = raptor_max(used_size, dynamic_max_per_frame_size);
@@ -2660,6 +3130,55 @@ namespace Engine
             vkEndCommandBuffer(command_buffer->vk_command_buffer);
         }
 
+        // Write new and changed textures into the bindless array. Allowed after binding, the slots are not used by frames in flight:
+        // streaming recreates textures in new slots instead of rewriting the ones frames in flight sample.
+        if (texture_to_update_bindless.size) {
+            static const u32 k_max_bindless_writes = 64;
+            VkWriteDescriptorSet bindless_descriptor_writes[k_max_bindless_writes];
+            VkDescriptorImageInfo bindless_image_info[k_max_bindless_writes];
+
+            // Writes are applied in queue order, so the latest update of a slot wins.
+            Sampler* vk_default_sampler = access_sampler(default_sampler);
+            u32 current_write_index = 0;
+            for (u32 i = 0; i < texture_to_update_bindless.size; ++i) {
+                ResourceUpdate& texture_to_update = texture_to_update_bindless[i];
+
+                Texture* texture = (Texture*)textures.access_resource(texture_to_update.handle);
+                if (texture == nullptr || texture->vk_image_view == VK_NULL_HANDLE) {
+                    continue;
+                }
+
+                VkDescriptorImageInfo& descriptor_image_info = bindless_image_info[current_write_index];
+                descriptor_image_info.sampler = texture->sampler ? texture->sampler->vk_sampler : vk_default_sampler->vk_sampler;
+                descriptor_image_info.imageView = texture->vk_image_view;
+                descriptor_image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+                VkWriteDescriptorSet& descriptor_write = bindless_descriptor_writes[current_write_index];
+                descriptor_write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+                descriptor_write.dstSet = vulkan_bindless_descriptor_set;
+                descriptor_write.dstBinding = k_bindless_texture_binding;
+                descriptor_write.dstArrayElement = texture_to_update.handle;
+                descriptor_write.descriptorCount = 1;
+                descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                descriptor_write.pImageInfo = &descriptor_image_info;
+
+                ++current_write_index;
+                if (current_write_index == k_max_bindless_writes) {
+                    vkUpdateDescriptorSets(vulkan_device, current_write_index, bindless_descriptor_writes, 0, nullptr);
+                    current_write_index = 0;
+                }
+            }
+
+            if (current_write_index) {
+                vkUpdateDescriptorSets(vulkan_device, current_write_index, bindless_descriptor_writes, 0, nullptr);
+            }
+
+            texture_to_update_bindless.clear();
+        }
+
+        // Uploads recorded during the frame are queued ahead of the commands that use them.
+        upload_manager.flush();
+
         // Submit command buffers
         VkSemaphore wait_semaphores[] = { vulkan_image_acquired_semaphore };
         VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
@@ -2861,6 +3380,10 @@ namespace Engine
         Sampler* sampler_vk = access_sampler(sampler);
 
         texture_vk->sampler = sampler_vk;
+
+        if (bindless_supported) {
+            texture_to_update_bindless.push({ ResourceDeletionType::Texture, texture.index, current_frame });
+        }
     }
 
     void GpuDevice::frame_counters_advance()
@@ -2904,6 +3427,14 @@ namespace Engine
         return cb;
     }
 
+    //
+    //
+    CommandBuffer* GpuDevice::get_secondary_command_buffer( u32 thread_index )
+    {
+        CommandBuffer* cb = command_buffer_ring.get_secondary_command_buffer(current_frame, thread_index);
+        return cb;
+    }
+
     // Resource Description Query ///////////////////////////////////////////////////
 
     void GpuDevice::query_buffer(BufferHandle buffer, BufferDescription& out_description)
@@ -2917,6 +3448,7 @@ namespace Engine
             out_description.usage = buffer_data->usage;
             out_description.parent_handle = buffer_data->parent_buffer;
             out_description.native_handle = (void*)&buffer_data->vk_buffer;
+            out_description.mapped_data = buffer_data->mapped_data;
         }
     }
 
@@ -3008,6 +3540,7 @@ namespace Engine
             return nullptr;
 
         Buffer* buffer = access_buffer(parameters.buffer);
+        RASSERTM(buffer->usage != ResourceUsageType::Immutable, "Immutable buffers are device local and cannot be mapped, use Stream or Dynamic usage.");
 
         if (buffer->parent_buffer.index == dynamic_buffer.index) {
 
@@ -3016,6 +3549,11 @@ namespace Engine
             return dynamic_allocate(parameters.size == 0 ? buffer->size : parameters.size);
         }
 
+        // Persistent buffers are already mapped, unmap only flushes.
+        if (buffer->mapped_data) {
+            return buffer->mapped_data + parameters.offset;
+        }
+
         void* data;
         vmaMapMemory(vma_allocator, buffer->vma_allocation, &data);
 
@@ -3028,12 +3566,29 @@ namespace Engine
             return;
 
         Buffer* buffer = access_buffer(parameters.buffer);
-        if (buffer->parent_buffer.index == dynamic_buffer.index)
+        if (buffer->parent_buffer.index == dynamic_buffer.index) {
+            flush_buffer(dynamic_buffer, buffer->global_offset, parameters.size == 0 ? buffer->size : parameters.size);
+            return;
+        }
+
+        if (buffer->mapped_data) {
+            flush_buffer(parameters.buffer, parameters.offset, parameters.size);
             return;
+        }
 
         vmaUnmapMemory(vma_allocator, buffer->vma_allocation);
     }
 
+    void GpuDevice::flush_buffer(BufferHandle handle, u32 offset, u32 size)
+    {
+        if (handle.index == k_invalid_index)
+            return;
+
+        // VMA skips host coherent memory and aligns the range to nonCoherentAtomSize.
+        Buffer* buffer = access_buffer(handle);
+        vmaFlushAllocation(vma_allocator, buffer->vma_allocation, offset, size == 0 ? VK_WHOLE_SIZE : size);
+    }
+
     void* GpuDevice::dynamic_allocate(u32 size)
     {
         void* mapped_memory = dynamic_mapped_memory + dynamic_allocated_size;
@@ -3295,4 +3850,23 @@ namespace Engine
         return *this;
     }
 
+    DeviceCreation& DeviceCreation::set_num_threads( u32 value )
+    {
+        num_threads = (u16)value;
+        return *this;
+    }
+
+    DeviceCreation& DeviceCreation::set_pipeline_cache_path( cstring path )
+    {
+        pipeline_cache_path = path;
+        return *this;
+    }
+
+    DeviceCreation& DeviceCreation::set_shader_cache( cstring path, u32 max_size )
+    {
+        shader_cache_path = path;
+        shader_cache_max_size = max_size;
+        return *this;
+    }
+
 } // namespace Engine
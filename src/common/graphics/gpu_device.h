@@ -11,6 +11,7 @@
 #include <vulkan/vulkan.h>
 
 #include "graphics/gpu_resource.h"
+#include "graphics/upload_manager.h"
 
 #include "foundation/data_structures.h"
 #include "foundation/string.h"
@@ -143,6 +144,23 @@ namespace Engine
 	
 	}; // struct GPUTimestampManager
 
+	//
+	// Input and results of one shader stage compiled by GpuDevice::compile_shaders.
+	// Results are allocated from the temporary allocator.
+	//
+	struct ShaderCompileJob
+	{
+		cstring								code							= nullptr;
+		u32									code_size						= 0;
+		VkShaderStageFlagBits				stage							= VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
+		cstring								name							= nullptr;
+
+		VkShaderModuleCreateInfo			shader_create_info				= { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };	// pCode is nullptr if compilation failed.
+		cstring								output							= nullptr;		// Compiler messages, nullptr when found in the shader cache.
+		i32									exit_code						= 0;
+
+	}; // struct ShaderCompileJob
+
 	//
 	struct DeviceCreation
 	{
@@ -153,12 +171,20 @@ namespace Engine
 		u16									height							= 1;
 
 		u16									gpu_time_queries_per_frame		= 32;
+		u16									num_threads						= 1;
+		u32									staging_buffer_size				= 64 * 1024 * 1024;		// Size of the upload staging ring.
+		cstring								pipeline_cache_path				= "pipeline_cache.bin";	// Loaded at init and saved at shutdown. nullptr disables persistence.
+		cstring								shader_cache_path				= "shader_cache";		// Folder of compiled SPIR-V keyed by source hash. nullptr disables the cache.
+		u32									shader_cache_max_size			= 64 * 1024 * 1024;		// Oldest entries are evicted above this size.
 		bool								enable_gpu_time_queries			= false;
 		bool								debug							= false;
 
 		DeviceCreation&						set_window( u32 width, u32 height, void* handle );
 		DeviceCreation&						set_allocator( Allocator* allocator );
 		DeviceCreation&						set_linear_allocator( StackAllocator* allocator );
+		DeviceCreation&						set_num_threads( u32 value );
+		DeviceCreation&						set_pipeline_cache_path( cstring path );
+		DeviceCreation&						set_shader_cache( cstring path, u32 max_size );
 		
 
 	}; // struct DeviceCreation
@@ -206,6 +232,9 @@ namespace Engine
 
 		// Update/Reload resources /////////				///////////////////////////////////////////////////
 		void												resize_output_textures( RenderPassHandle render_pass, u32 width, u32 height );
+		// Creates a texture like the given one with new size and levels, keeping its linked sampler, and destroys the given one.
+		// Returns k_invalid_texture and keeps the given one if creation failed.
+		TextureHandle										recreate_texture( TextureHandle texture, u16 width, u16 height, u8 mipmaps, void* data );
 
 		void												update_descriptor_set( DescriptorSetHandle set );
 
@@ -219,6 +248,8 @@ namespace Engine
 		bool												get_family_queue( VkPhysicalDevice physical_device );
 
 		VkShaderModuleCreateInfo							compile_shader( cstring code, u32 code_size, VkShaderStageFlagBits stage, cstring name);
+		u32													compile_shaders( ShaderCompileJob* jobs, u32 count );								// Runs up to num_threads compilers at once. Returns the number of successful jobs.
+		void												evict_shader_cache();
 
 		// Swapchain ///////////////////////				///////////////////////////////////////////////////
 		void												create_swapchain();
@@ -228,6 +259,8 @@ namespace Engine
 		// Map/Unmap ///////////////////////				/////////////////////////////////////
 		void*												map_buffer( const MapBufferParameters& parameters );
 		void												unmap_buffer( const MapBufferParameters& parameters );
+		// Makes CPU writes to a persistently mapped buffer visible to the GPU, size 0 flushes to the end.
+		void												flush_buffer( BufferHandle buffer, u32 offset, u32 size );
 
 		void*												dynamic_allocate( u32 size );
 
@@ -236,6 +269,7 @@ namespace Engine
 		// Command Buffers /////////////////				//////////////////////////////////////
 		CommandBuffer*										get_command_buffer( QueueType::Enum type, bool begin );
 		CommandBuffer*										get_instant_command_buffer();
+		CommandBuffer*										get_secondary_command_buffer( u32 thread_index );							// Not begun: call begin_secondary with the render pass to continue.
 
 		void												queue_command_buffer( CommandBuffer* command_buffer );							// Queue command buffer that will not be executed until present is called.
 
@@ -328,6 +362,7 @@ namespace Engine
 		GPUTimestampManager*								gpu_timestamp_manager					= nullptr;
 
 		bool												bindless_supported						= false;
+		bool												texture_compression_bc_supported		= false;	// BC1, BC5 and BC7 can be sampled.
 		bool												timestamps_enabled						= false;
 		bool												resized									= false;
 		bool												vertical_sync							= false;
@@ -341,8 +376,15 @@ namespace Engine
 		VkDevice											vulkan_device;
 		VkQueue												vulkan_queue;
 		uint32_t											vulkan_queue_family;
+		VkQueue												vulkan_transfer_queue;
+		uint32_t											vulkan_transfer_queue_family;								// Same as vulkan_queue_family when there is no dedicated transfer family.
 		VkDescriptorPool									vulkan_descriptor_pool;
 
+		// Bindless textures: a single partially bound array written at the index of every texture handle.
+		VkDescriptorPool									vulkan_bindless_descriptor_pool;
+		VkDescriptorSetLayout								vulkan_bindless_descriptor_set_layout;
+		VkDescriptorSet										vulkan_bindless_descriptor_set;
+
 		// Swapchain
 		VkImage												vulkan_swapchain_images[ k_max_swapchain_images ];
 		VkImageView											vulkan_swapchain_image_views[ k_max_swapchain_images ];
@@ -357,6 +399,7 @@ namespace Engine
 		TextureHandle										depth_texture;
 
 		static const uint32_t								k_max_frames = 3;
+		static const uint32_t								k_max_threads = 64;			// Recording threads, each one owns command pools.
 
 		// Windows Specific.
 		VkSurfaceKHR										vulkan_window_surface;
@@ -371,10 +414,14 @@ namespace Engine
 		u32													vulkan_image_index;
 
 		VmaAllocator										vma_allocator;
+		VkPipelineCache										vulkan_pipeline_cache;
+
+		UploadManager										upload_manager;
 
 		// These are dynamic - so that workl				oad can be handled correctly.
 		Array<ResourceUpdate>								resource_deletion_queue;
 		Array<DescriptorSetUpdate>							descriptor_set_updates;
+		Array<ResourceUpdate>								texture_to_update_bindless;
 
 		u32													num_threads								= 1;
 		bool												gpu_timestamp_reset						= true;
@@ -401,6 +448,11 @@ namespace Engine
 		
 
 		char												vulkan_binaries_path [ 512 ];
+		char												pipeline_cache_path [ 512 ];
+		char												shader_cache_path [ 512 ];
+		u32													shader_compile_counter					= 0;
+		sizet												shader_cache_size						= 0;
+		sizet												shader_cache_max_size					= 0;
 
 		ShaderState*										access_shader_state( ShaderStateHandle shader );
 		const ShaderState*									access_shader_state( ShaderStateHandle shader ) const;
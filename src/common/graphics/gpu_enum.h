@@ -158,12 +158,12 @@ namespace Engine
 	{
 		enum Enum
 		{
-			Float, Float2, Float3, Float4, Mat4, Byte, Byte4N, UByte, UByte4N, Short2, Short2N, Short4, Short4N, Uint, Uint2, Uint4, Count
+			Float, Float2, Float3, Float4, Mat4, Byte, Byte4N, UByte, UByte4N, Short2, Short2N, Short4, Short4N, Uint, Uint2, Uint4, Half2, Half4, Count
 		};
 
 		static const char* s_values_names[] =
 		{
-			"Float", "Float2", "Float3", "Float4", "Mat4", "Byte", "Byte4N", "UByte", "UByte4N", "Short2", "Short2N", "Short4", "Short4N", "Uint", "Uint2", "Uint4", "Count"
+			"Float", "Float2", "Float3", "Float4", "Mat4", "Byte", "Byte4N", "UByte", "UByte4N", "Short2", "Short2N", "Short4", "Short4N", "Uint", "Uint2", "Uint4", "Half2", "Half4", "Count"
 		};
 
 		static const char* ToString(Enum e)
@@ -216,12 +216,12 @@ namespace Engine
 	{
 		enum Enum
 		{
-			Default, RenderTarget, Compute, Count
+			Default, RenderTarget, Compute, GenerateMips, Count
 		};
 		
 		enum Mask
 		{
-			Default_mask = 1 << 0, RenderTarget_mask = 1 << 1, Compute_mask = 1 << 2
+			Default_mask = 1 << 0, RenderTarget_mask = 1 << 1, Compute_mask = 1 << 2, GenerateMips_mask = 1 << 3		// GenerateMips: full mip chain, blitted from the uploaded level 0.
 		};
 
 	}; // namespace TextureFlags
@@ -15,6 +15,7 @@ namespace Engine
     static const u32                    k_invalid_index = 0xffffffff;
 
     typedef u32                         ResourceHandle;
+    typedef u64                         UploadHandle;       // Batch of copies submitted by the UploadManager, 0 is never issued.
 
     struct BufferHandle {
         ResourceHandle                  index;
@@ -69,6 +70,9 @@ namespace Engine
     static const u8                     k_max_vertex_streams = 16;
     static const u8                     k_max_vertex_attributes = 16;
 
+    static const u32                    k_bindless_texture_binding = 10;        // Binding of the global texture array, indexed by TextureHandle::index.
+    static const u32                    k_max_bindless_resources = 1024;
+
     static const u32                    k_submit_header_sentinel = 0xfefeb7ba;
     static const u32                    k_max_resource_deletions = 64;
 
@@ -201,10 +205,13 @@ namespace Engine
 
         const char* name = nullptr;
 
+        u8                              persistent = 0;     // Mapped for the whole buffer lifetime, not allowed for Immutable usage.
+
         BufferCreation& reset();
         BufferCreation& set(VkBufferUsageFlags flags, ResourceUsageType::Enum usage, u32 size);
         BufferCreation& set_data(void* data);
         BufferCreation& set_name(const char* name);
+        BufferCreation& set_persistent(bool value);
 
     }; // struct BufferCreation
 
@@ -478,6 +485,18 @@ namespace Engine
             return value >= VK_FORMAT_D16_UNORM && value <= VK_FORMAT_D32_SFLOAT_S8_UINT;
         }
 
+        inline bool                     is_block_compressed(VkFormat value) {
+            return value >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && value <= VK_FORMAT_BC7_SRGB_BLOCK;
+        }
+        // Bytes of one level of uploaded data: 4x4 blocks for BCn formats, 32 bit texels otherwise.
+        inline u32                      level_size(VkFormat value, u32 width, u32 height, u32 depth) {
+            if (is_block_compressed(value)) {
+                const u32 block_size = (value <= VK_FORMAT_BC1_RGBA_SRGB_BLOCK || value == VK_FORMAT_BC4_UNORM_BLOCK || value == VK_FORMAT_BC4_SNORM_BLOCK) ? 8 : 16;
+                return ((width + 3) / 4) * ((height + 3) / 4) * depth * block_size;
+            }
+            return width * height * depth * 4;
+        }
+
     } // namespace TextureFormat
 
     struct ResourceData {
@@ -521,6 +540,8 @@ namespace Engine
         u32                             size = 0;
         BufferHandle                    parent_handle;
 
+        void* mapped_data = nullptr;    // Non null for persistently mapped buffers.
+
     }; // struct BufferDescription
 
     //
@@ -667,6 +688,8 @@ namespace Engine
 
         BufferHandle                    handle;
         BufferHandle                    parent_buffer;
+        UploadHandle                    upload = 0;         // Initial data copy of Immutable buffers, poll with UploadManager::is_complete.
+        u8*                             mapped_data = nullptr;  // Persistent mapping, see BufferCreation::persistent.
 
         const char* name = nullptr;
 
@@ -709,6 +732,7 @@ namespace Engine
 
         TextureHandle                   handle;
         TextureType::Enum               type = TextureType::Texture2D;
+        UploadHandle                    upload = 0;         // Initial data copy, poll with UploadManager::is_complete.
 
         Sampler* sampler = nullptr;
 
@@ -783,6 +807,7 @@ namespace Engine
         const DescriptorSetLayout* descriptor_set_layout[k_max_descriptor_set_layouts];
         DescriptorSetLayoutHandle       descriptor_set_layout_handle[k_max_descriptor_set_layouts];
         u32                             num_active_layouts = 0;
+        u32                             bindless_set_index = u32_max;           // Set of the bindless textures, u32_max when bindless is not supported.
 
         DepthStencilCreation            depth_stencil;
         BlendStateCreation              blend_state;
@@ -868,10 +893,11 @@ namespace Engine
     //
     //
     static VkFormat to_vk_vertex_format(VertexComponentFormat::Enum value) {
-        // Float, Float2, Float3, Float4, Mat4, Byte, Byte4N, UByte, UByte4N, Short2, Short2N, Short4, Short4N, Uint, Uint2, Uint4, Count
+        // Float, Float2, Float3, Float4, Mat4, Byte, Byte4N, UByte, UByte4N, Short2, Short2N, Short4, Short4N, Uint, Uint2, Uint4, Half2, Half4, Count
         static VkFormat s_vk_vertex_formats[ VertexComponentFormat::Count ] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT, /*MAT4 TODO*/VK_FORMAT_R32G32B32A32_SFLOAT,
                                                                                 VK_FORMAT_R8_SINT, VK_FORMAT_R8G8B8A8_SNORM, VK_FORMAT_R8_UINT, VK_FORMAT_R8G8B8A8_UINT, VK_FORMAT_R16G16_SINT, VK_FORMAT_R16G16_SNORM,
-                                                                                VK_FORMAT_R16G16B16A16_SINT, VK_FORMAT_R16G16B16A16_SNORM, VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+                                                                                VK_FORMAT_R16G16B16A16_SINT, VK_FORMAT_R16G16B16A16_SNORM, VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32A32_UINT,
+                                                                                VK_FORMAT_R16G16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT };
 
         return s_vk_vertex_formats[value];
     }
@@ -53,6 +53,7 @@ namespace Engine
     BufferCreation& BufferCreation::reset() {
         size = 0;
         initial_data = nullptr;
+        persistent = 0;
 
         return *this;
     }
@@ -77,6 +78,12 @@ namespace Engine
         return *this;
     }
 
+    BufferCreation& BufferCreation::set_persistent(bool value) {
+        persistent = value ? 1 : 0;
+
+        return *this;
+    }
+
     // TextureCreation /////////////////////////////////////////
     TextureCreation& TextureCreation::set_size(u16 width_, u16 height_, u16 depth_) {
         width = width_;
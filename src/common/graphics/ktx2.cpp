@@ -0,0 +1,224 @@
+#include "graphics/ktx2.h"
+
+#include "foundation/file.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace Engine
+{
+	static const u8							k_ktx2_identifier[ 12 ]	= { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	struct Ktx2Header
+	{
+		u8									identifier[ 12 ];
+		u32									vk_format;
+		u32									type_size;
+		u32									pixel_width;
+		u32									pixel_height;
+		u32									pixel_depth;
+		u32									layer_count;
+		u32									face_count;
+		u32									level_count;
+		u32									supercompression_scheme;
+
+		u32									dfd_byte_offset;
+		u32									dfd_byte_length;
+		u32									kvd_byte_offset;
+		u32									kvd_byte_length;
+		u64									sgd_byte_offset;
+		u64									sgd_byte_length;
+	}; // struct Ktx2Header
+
+	struct Ktx2LevelIndex
+	{
+		u64									byte_offset;
+		u64									byte_length;
+		u64									uncompressed_byte_length;
+	}; // struct Ktx2LevelIndex
+
+	// Khronos data format descriptor values used by the writer.
+	static const u32						k_dfd_model_rgbsda		= 1;
+	static const u32						k_dfd_model_bc1a		= 128;
+	static const u32						k_dfd_model_bc5			= 132;
+	static const u32						k_dfd_model_bc7			= 134;
+	static const u32						k_dfd_primaries_bt709	= 1;
+	static const u32						k_dfd_transfer_linear	= 1;
+	static const u32						k_dfd_channel_alpha		= 15;
+
+	struct DfdSample
+	{
+		u32									bit_offset;
+		u32									bit_length;
+		u32									channel;
+		u32									upper;
+	}; // struct DfdSample
+
+	// Bytes per texel block, also the alignment of each level. Returns 0 for formats the writer does not describe.
+	static u32 ktx2_describe_format( VkFormat format, u32* model, DfdSample* samples, u32* num_samples )
+	{
+		switch ( format )
+		{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			{
+				*model = k_dfd_model_rgbsda;
+				*num_samples = 4;
+				for ( u32 c = 0; c < 4; ++c )
+				{
+					samples[ c ] = { c * 8, 7, c == 3 ? k_dfd_channel_alpha : c, 255 };
+				}
+				return 4;
+			}
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			{
+				*model = k_dfd_model_bc1a;
+				*num_samples = 1;
+				samples[ 0 ] = { 0, 63, 0, u32_max };
+				return 8;
+			}
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+			{
+				*model = k_dfd_model_bc5;
+				*num_samples = 2;
+				samples[ 0 ] = { 0, 63, 0, u32_max };
+				samples[ 1 ] = { 64, 63, 1, u32_max };
+				return 16;
+			}
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			{
+				*model = k_dfd_model_bc7;
+				*num_samples = 1;
+				samples[ 0 ] = { 0, 127, 0, u32_max };
+				return 16;
+			}
+			default:
+			{
+				return 0;
+			}
+		}
+	}
+
+	static u64 align_up( u64 value, u64 alignment )
+	{
+		return ( value + alignment - 1 ) / alignment * alignment;
+	}
+
+	// KTX2 /////////////////////////////////////////////////////////////////
+
+	bool ktx2_parse( const u8* data, sizet size, Ktx2Image* image )
+	{
+		if ( size < sizeof( Ktx2Header ) || memcmp( data, k_ktx2_identifier, sizeof( k_ktx2_identifier ) ) != 0 )
+		{
+			return false;
+		}
+
+		Ktx2Header header;
+		memcpy( &header, data, sizeof( Ktx2Header ) );
+
+		// Basis universal files have no Vulkan format and need transcoding, cubemaps and arrays are not used.
+		const u32 num_levels = header.level_count ? header.level_count : 1;
+		if ( header.vk_format == VK_FORMAT_UNDEFINED || header.supercompression_scheme != 0 || header.pixel_depth > 1 || header.layer_count > 1 ||
+			 header.face_count != 1 || num_levels > k_ktx2_max_levels || sizeof( Ktx2Header ) + num_levels * sizeof( Ktx2LevelIndex ) > size )
+		{
+			return false;
+		}
+
+		image->format = ( VkFormat )header.vk_format;
+		image->width = header.pixel_width;
+		image->height = header.pixel_height ? header.pixel_height : 1;
+		image->num_levels = num_levels;
+
+		for ( u32 level = 0; level < num_levels; ++level )
+		{
+			Ktx2LevelIndex index;
+			memcpy( &index, data + sizeof( Ktx2Header ) + level * sizeof( Ktx2LevelIndex ), sizeof( Ktx2LevelIndex ) );
+			if ( index.byte_offset > size || index.byte_length > size - index.byte_offset )
+			{
+				return false;
+			}
+
+			image->levels[ level ].data = data + index.byte_offset;
+			image->levels[ level ].size = ( sizet )index.byte_length;
+		}
+
+		return true;
+	}
+
+	bool ktx2_write( cstring path, const Ktx2Image& image )
+	{
+		u32 model, num_samples;
+		DfdSample samples[ 4 ];
+		const u32 block_bytes = ktx2_describe_format( image.format, &model, samples, &num_samples );
+		if ( block_bytes == 0 || image.num_levels == 0 || image.num_levels > k_ktx2_max_levels )
+		{
+			return false;
+		}
+		const bool block_compressed = image.format != VK_FORMAT_R8G8B8A8_UNORM;
+
+		// Basic descriptor block: 6 header words then 4 words per sample, after the total size.
+		u32 dfd[ 1 + 6 + 4 * 4 ] = { };
+		const u32 dfd_words = 1 + 6 + 4 * num_samples;
+		dfd[ 0 ] = dfd_words * 4;
+		dfd[ 2 ] = 2 | ( ( 24 + 16 * num_samples ) << 16 );
+		dfd[ 3 ] = model | ( k_dfd_primaries_bt709 << 8 ) | ( k_dfd_transfer_linear << 16 );
+		dfd[ 4 ] = block_compressed ? 3 | ( 3 << 8 ) : 0;
+		dfd[ 5 ] = block_bytes;
+		for ( u32 s = 0; s < num_samples; ++s )
+		{
+			u32* sample = dfd + 7 + s * 4;
+			sample[ 0 ] = samples[ s ].bit_offset | ( samples[ s ].bit_length << 16 ) | ( samples[ s ].channel << 24 );
+			sample[ 3 ] = samples[ s ].upper;
+		}
+
+		Ktx2Header header{ };
+		memcpy( header.identifier, k_ktx2_identifier, sizeof( k_ktx2_identifier ) );
+		header.vk_format = image.format;
+		header.type_size = 1;
+		header.pixel_width = image.width;
+		header.pixel_height = image.height;
+		header.face_count = 1;
+		header.level_count = image.num_levels;
+		header.dfd_byte_offset = ( u32 )( sizeof( Ktx2Header ) + image.num_levels * sizeof( Ktx2LevelIndex ) );
+		header.dfd_byte_length = dfd_words * 4;
+
+		// Levels are stored smallest first, each aligned to the texel block size.
+		Ktx2LevelIndex level_index[ k_ktx2_max_levels ];
+		u64 offset = header.dfd_byte_offset + header.dfd_byte_length;
+		for ( u32 level = image.num_levels; level-- > 0; )
+		{
+			offset = align_up( offset, block_bytes );
+			level_index[ level ] = { offset, image.levels[ level ].size, image.levels[ level ].size };
+			offset += image.levels[ level ].size;
+		}
+
+		FILE* file = fopen( path, "wb" );
+		if ( !file )
+		{
+			return false;
+		}
+
+		bool written = fwrite( &header, sizeof( Ktx2Header ), 1, file ) == 1 &&
+					   fwrite( level_index, sizeof( Ktx2LevelIndex ), image.num_levels, file ) == image.num_levels &&
+					   fwrite( dfd, 4, dfd_words, file ) == dfd_words;
+
+		static const u8 padding[ 16 ] = { };
+		u64 cursor = header.dfd_byte_offset + header.dfd_byte_length;
+		for ( u32 level = image.num_levels; level-- > 0 && written; )
+		{
+			const u64 padding_size = level_index[ level ].byte_offset - cursor;
+			written = ( padding_size == 0 || fwrite( padding, ( sizet )padding_size, 1, file ) == 1 ) &&
+					  ( image.levels[ level ].size == 0 || fwrite( image.levels[ level ].data, image.levels[ level ].size, 1, file ) == 1 );
+			cursor = level_index[ level ].byte_offset + image.levels[ level ].size;
+		}
+
+		fclose( file );
+
+		if ( !written )
+		{
+			file_delete( path );
+		}
+
+		return written;
+	}
+
+} // namespace Engine
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "foundation/platform.h"
+
+#include <vulkan/vulkan.h>
+
+namespace Engine
+{
+	// KTX2 /////////////////////////////////////////////////////////////////
+
+	//
+	// Reader and writer for the subset of KTX2 the renderer uses: single 2D images without supercompression,
+	// with their mip levels stored as is. The vkFormat of the file is used directly.
+	//
+
+	static const u32						k_ktx2_max_levels		= 16;
+
+	struct Ktx2Level
+	{
+		const u8*							data;
+		sizet								size;
+	}; // struct Ktx2Level
+
+	struct Ktx2Image
+	{
+		VkFormat							format;
+		u32									width;
+		u32									height;
+		u32									num_levels;
+
+		Ktx2Level							levels[ k_ktx2_max_levels ];		// Level 0 is the largest.
+	}; // struct Ktx2Image
+
+	// Levels point in data. Returns false if the file is malformed or uses features outside the subset.
+	bool									ktx2_parse( const u8* data, sizet size, Ktx2Image* image );
+
+	// Writes the image with a basic data format descriptor. Supports R8G8B8A8, BC1 RGB, BC5 and BC7 formats.
+	bool									ktx2_write( cstring path, const Ktx2Image& image );
+
+} // namespace Engine
@@ -0,0 +1,260 @@
+#include "graphics/mesh_optimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace Engine
+{
+	// Forsyth scoring, tuned values from the original article.
+	static const f32						k_last_triangle_score	= 0.75f;
+	static const f32						k_cache_decay_power		= 1.5f;
+	static const f32						k_valence_boost_scale	= 2.0f;
+	static const f32						k_valence_boost_power	= 0.5f;
+
+	static f32 vertex_score( i32 cache_position, u32 valence )
+	{
+		// No triangle left to emit with this vertex.
+		if ( valence == 0 )
+		{
+			return -1.f;
+		}
+
+		f32 score = 0.f;
+		if ( cache_position >= 0 )
+		{
+			// Vertices of the last triangle get a fixed score, so it is not favoured over its neighbours.
+			if ( cache_position < 3 )
+			{
+				score = k_last_triangle_score;
+			}
+			else
+			{
+				const f32 scaler = 1.f / ( k_vertex_cache_size - 3 );
+				score = powf( 1.f - ( cache_position - 3 ) * scaler, k_cache_decay_power );
+			}
+		}
+
+		// Boost vertices with few triangles left, to finish them off instead of leaving lone triangles behind.
+		score += k_valence_boost_scale * powf( ( f32 )valence, -k_valence_boost_power );
+
+		return score;
+	}
+
+	// Mesh optimizer ///////////////////////////////////////////////////////
+
+	sizet mesh_optimizer_scratch_size( u32 index_count, u32 vertex_count )
+	{
+		// Per vertex valence, adjacency offset, cache position and score, then adjacency, input copy and emitted flags.
+		const u32 triangle_count = index_count / 3;
+		return vertex_count * ( sizeof( u32 ) * 2 + sizeof( i32 ) + sizeof( f32 ) ) + index_count * sizeof( u32 ) * 2 + triangle_count * sizeof( u8 );
+	}
+
+	f32 compute_acmr( const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size, u8* scratch )
+	{
+		const u32 triangle_count = index_count / 3;
+		if ( triangle_count == 0 )
+		{
+			return 0.f;
+		}
+
+		// A vertex is in the FIFO when fewer than cache_size misses happened since it was loaded.
+		u32* timestamps = ( u32* )scratch;
+		memset( timestamps, 0, vertex_count * sizeof( u32 ) );
+
+		u32 time = cache_size + 1;
+		u32 misses = 0;
+		for ( u32 i = 0; i < index_count; ++i )
+		{
+			const u32 vertex = indices[ i ];
+			if ( time - timestamps[ vertex ] > cache_size )
+			{
+				timestamps[ vertex ] = time++;
+				++misses;
+			}
+		}
+
+		return ( f32 )misses / triangle_count;
+	}
+
+	void optimize_vertex_cache( u32* indices, u32 index_count, u32 vertex_count, u8* scratch )
+	{
+		const u32 triangle_count = index_count / 3;
+		if ( triangle_count == 0 )
+		{
+			return;
+		}
+
+		u32* valence = ( u32* )scratch;
+		u32* adjacency_offset = valence + vertex_count;
+		i32* cache_position = ( i32* )( adjacency_offset + vertex_count );
+		f32* vertex_scores = ( f32* )( cache_position + vertex_count );
+		u32* adjacency = ( u32* )( vertex_scores + vertex_count );
+		u32* input = adjacency + index_count;
+		u8* emitted = ( u8* )( input + index_count );
+
+		memcpy( input, indices, index_count * sizeof( u32 ) );
+		memset( valence, 0, vertex_count * sizeof( u32 ) );
+		memset( emitted, 0, triangle_count );
+
+		for ( u32 i = 0; i < index_count; ++i )
+		{
+			++valence[ input[ i ] ];
+		}
+
+		// Triangles using each vertex, valence is rebuilt while filling. Only the first valence entries are live.
+		u32 offset = 0;
+		for ( u32 v = 0; v < vertex_count; ++v )
+		{
+			adjacency_offset[ v ] = offset;
+			offset += valence[ v ];
+			valence[ v ] = 0;
+		}
+
+		for ( u32 i = 0; i < index_count; ++i )
+		{
+			const u32 vertex = input[ i ];
+			adjacency[ adjacency_offset[ vertex ] + valence[ vertex ]++ ] = i / 3;
+		}
+
+		for ( u32 v = 0; v < vertex_count; ++v )
+		{
+			cache_position[ v ] = -1;
+			vertex_scores[ v ] = vertex_score( -1, valence[ v ] );
+		}
+
+		u32 best_triangle = 0;
+		f32 best_score = -1.f;
+		for ( u32 t = 0; t < triangle_count; ++t )
+		{
+			const f32 score = vertex_scores[ input[ t * 3 ] ] + vertex_scores[ input[ t * 3 + 1 ] ] + vertex_scores[ input[ t * 3 + 2 ] ];
+			if ( score > best_score )
+			{
+				best_score = score;
+				best_triangle = t;
+			}
+		}
+
+		u32 cache[ k_vertex_cache_size + 3 ];
+		u32 cache_count = 0;
+		u32 next_unemitted = 0;
+
+		for ( u32 output = 0; output < triangle_count; ++output )
+		{
+			// No candidate around the cache, restart from the first triangle not emitted yet.
+			if ( best_triangle == u32_max )
+			{
+				while ( emitted[ next_unemitted ] )
+				{
+					++next_unemitted;
+				}
+				best_triangle = next_unemitted;
+			}
+
+			const u32 triangle = best_triangle;
+			emitted[ triangle ] = 1;
+
+			// Triangle vertices move to the front of the LRU cache.
+			u32 new_cache[ k_vertex_cache_size + 3 ];
+			u32 new_cache_count = 0;
+			for ( u32 c = 0; c < 3; ++c )
+			{
+				const u32 vertex = input[ triangle * 3 + c ];
+				indices[ output * 3 + c ] = vertex;
+
+				u32* vertex_adjacency = adjacency + adjacency_offset[ vertex ];
+				for ( u32 a = 0; a < valence[ vertex ]; ++a )
+				{
+					if ( vertex_adjacency[ a ] == triangle )
+					{
+						vertex_adjacency[ a ] = vertex_adjacency[ --valence[ vertex ] ];
+						break;
+					}
+				}
+
+				bool duplicate = false;
+				for ( u32 n = 0; n < new_cache_count; ++n )
+				{
+					duplicate |= new_cache[ n ] == vertex;
+				}
+				if ( !duplicate )
+				{
+					new_cache[ new_cache_count++ ] = vertex;
+				}
+			}
+
+			const u32 triangle_vertex_count = new_cache_count;
+			for ( u32 i = 0; i < cache_count; ++i )
+			{
+				const u32 vertex = cache[ i ];
+
+				bool in_triangle = false;
+				for ( u32 n = 0; n < triangle_vertex_count; ++n )
+				{
+					in_triangle |= new_cache[ n ] == vertex;
+				}
+				if ( !in_triangle )
+				{
+					new_cache[ new_cache_count++ ] = vertex;
+				}
+			}
+
+			// Rescore the cache, including the vertices that just fell out of it.
+			for ( u32 i = 0; i < new_cache_count; ++i )
+			{
+				const u32 vertex = new_cache[ i ];
+				cache_position[ vertex ] = i < k_vertex_cache_size ? ( i32 )i : -1;
+				vertex_scores[ vertex ] = vertex_score( cache_position[ vertex ], valence[ vertex ] );
+			}
+
+			cache_count = new_cache_count < k_vertex_cache_size ? new_cache_count : k_vertex_cache_size;
+			memcpy( cache, new_cache, cache_count * sizeof( u32 ) );
+
+			// Next triangle is the best one touching the updated vertices.
+			best_triangle = u32_max;
+			best_score = -1.f;
+			for ( u32 i = 0; i < new_cache_count; ++i )
+			{
+				const u32 vertex = new_cache[ i ];
+				const u32* vertex_adjacency = adjacency + adjacency_offset[ vertex ];
+				for ( u32 a = 0; a < valence[ vertex ]; ++a )
+				{
+					const u32 t = vertex_adjacency[ a ];
+					const f32 score = vertex_scores[ input[ t * 3 ] ] + vertex_scores[ input[ t * 3 + 1 ] ] + vertex_scores[ input[ t * 3 + 2 ] ];
+					if ( score > best_score )
+					{
+						best_score = score;
+						best_triangle = t;
+					}
+				}
+			}
+		}
+	}
+
+	void optimize_vertex_fetch( u32* indices, u32 index_count, u32 vertex_count, u32* remap )
+	{
+		for ( u32 v = 0; v < vertex_count; ++v )
+		{
+			remap[ v ] = u32_max;
+		}
+
+		u32 next_vertex = 0;
+		for ( u32 i = 0; i < index_count; ++i )
+		{
+			const u32 vertex = indices[ i ];
+			if ( remap[ vertex ] == u32_max )
+			{
+				remap[ vertex ] = next_vertex++;
+			}
+			indices[ i ] = remap[ vertex ];
+		}
+
+		for ( u32 v = 0; v < vertex_count; ++v )
+		{
+			if ( remap[ v ] == u32_max )
+			{
+				remap[ v ] = next_vertex++;
+			}
+		}
+	}
+
+} // namespace Engine
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "foundation/platform.h"
+
+namespace Engine
+{
+	// Mesh optimizer ///////////////////////////////////////////////////////
+
+	//
+	// Import time reordering of triangle lists. Functions take a caller owned scratch buffer
+	// of mesh_optimizer_scratch_size bytes so they can run on any thread without allocating.
+	//
+
+	static const u32						k_vertex_cache_size		= 32;
+
+	sizet									mesh_optimizer_scratch_size( u32 index_count, u32 vertex_count );
+
+	// Average cache miss ratio: vertices transformed per triangle with a FIFO post transform cache.
+	// 3 when no vertex is reused, close to 0.5 for a well ordered regular grid.
+	f32										compute_acmr( const u32* indices, u32 index_count, u32 vertex_count, u32 cache_size, u8* scratch );
+
+	// Reorders triangles in place for the post transform cache, using Forsyth's linear speed algorithm.
+	void									optimize_vertex_cache( u32* indices, u32 index_count, u32 vertex_count, u8* scratch );
+
+	// Renumbers vertices in order of first use so vertex fetch walks memory linearly, indices are rewritten in place.
+	// remap[ old vertex ] = new vertex, unreferenced vertices are moved after the referenced ones.
+	void									optimize_vertex_fetch( u32* indices, u32 index_count, u32 vertex_count, u32* remap );
+
+} // namespace Engine
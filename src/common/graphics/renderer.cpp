@@ -1,9 +1,15 @@
 #include "graphics/renderer.h"
 
 #include "graphics/command_buffer.h"
+#include "graphics/ktx2.h"
+#include "graphics/texture_compression.h"
 
 #include "foundation/memory.h"
 #include "foundation/file.h"
+#include "foundation/numerics.h"
+#include "foundation/task_scheduler.h"
+
+#include <string.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
@@ -21,6 +27,11 @@ namespace Engine
 
 		Resource*					create_from_file( cstring name, cstring filename, ResourceManager* resource_manager ) override;
 
+		bool						async_read_supported() const override	{ return true; }
+		void*						read_file( cstring filename ) override;
+		Resource*					create_from_data( cstring name, cstring filename, void* data, ResourceManager* resource_manager ) override;
+		void						release_data( void* data ) override;
+
 		Renderer*					renderer;
 
 	}; // struct TextureLoader
@@ -48,32 +59,232 @@ namespace Engine
 	}; // struct SamplerLoader
 
 	//
-	//
-	static TextureHandle create_texture_from_file( GpuDevice& gpu, cstring filename, cstring name )
+	// Texture data read from a file: RGBA8 pixels decoded by stb_image, or the levels of a KTX2 file packed largest first.
+	struct TextureFileData
+	{
+		u8*							data				= nullptr;		// Released with free.
+		i32							width				= 0;			// Of level 0, even when it was not read.
+		i32							height				= 0;
+		VkFormat					format				= VK_FORMAT_R8G8B8A8_UNORM;
+		u32							mipmaps				= 1;			// Levels in the file.
+		u32							first_level			= 0;			// Level at the start of data.
+
+	}; // struct TextureFileData
+
+	// Bytes of levels [first_level, num_levels) of a chain starting at width x height.
+	static u32 texture_levels_size( VkFormat format, u32 width, u32 height, u32 first_level, u32 num_levels )
+	{
+		u32 size = 0;
+		for ( u32 level = first_level; level < num_levels; ++level )
+		{
+			size += TextureFormat::level_size( format, max( width >> level, 1u ), max( height >> level, 1u ), 1 );
+		}
+		return size;
+	}
+
+	// Formats level_size describes: 32 bit texels or BCn blocks.
+	static bool is_texture_file_format_supported( VkFormat format )
+	{
+		switch ( format )
+		{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+				return true;
+			default:
+				return TextureFormat::is_block_compressed( format );
+		}
+	}
+
+	// Rejects KTX2 files the upload would read past or misinterpret: every level must hold exactly its texels.
+	static bool validate_texture_file( cstring filename, const Ktx2Image& image )
+	{
+		bool valid = is_texture_file_format_supported( image.format ) && image.width > 0 && image.width <= u16_max && image.height <= u16_max &&
+					 image.num_levels <= mip_level_count( image.width, image.height );
+		for ( u32 level = 0; level < image.num_levels && valid; ++level )
+		{
+			valid = image.levels[ level ].size == TextureFormat::level_size( image.format, max( image.width >> level, 1u ), max( image.height >> level, 1u ), 1 );
+		}
+
+		if ( !valid )
+		{
+			rprint( "Texture %s has an unsupported format or malformed levels\n", filename );
+		}
+
+		return valid;
+	}
+
+	// Safe to call from any thread: stb_image only reads its global settings and KTX2 files are mapped.
+	// KTX2 levels larger than max_dimension are skipped when it is not zero, the smallest level is always read.
+	static bool read_texture_file( cstring filename, u32 max_dimension, TextureFileData& file_data )
 	{
-		if ( filename )
+		cstring extension = strrchr( filename, '.' );
+		if ( extension == nullptr || strcmp( extension, ".ktx2" ) != 0 )
 		{
-			int comp, width, height;
-			uint8_t* image_data = stbi_load(filename, &width, &height, &comp, 4);
-			if (!image_data)
+			int comp;
+			file_data.data = stbi_load( filename, &file_data.width, &file_data.height, &comp, 4 );
+			return file_data.data != nullptr;
+		}
+
+		MappedFile file;
+		if ( !file_map( filename, &file ) )
+		{
+			return false;
+		}
+
+		Ktx2Image image;
+		const bool valid = ktx2_parse( file.data, file.size, &image ) && validate_texture_file( filename, image );
+		if ( valid )
+		{
+			u32 first_level = 0;
+			while ( max_dimension && first_level + 1 < image.num_levels && max( image.width, image.height ) >> first_level > max_dimension )
+			{
+				++first_level;
+			}
+
+			sizet size = 0;
+			for ( u32 level = first_level; level < image.num_levels; ++level )
 			{
-				rprint("Error loading texture %s", filename);
-				return k_invalid_texture;
+				size += image.levels[ level ].size;
 			}
 
-			TextureCreation creation;
-			creation.set_data( image_data ).set_format_type( VK_FORMAT_R8G8B8A8_UNORM, TextureType::Texture2D ).set_flags( 1, 0 ).set_size(( u16 )width, ( u16 )height, 1).set_name(name);
+			file_data.data = ( u8* )malloc( size );
+			file_data.width = image.width;
+			file_data.height = image.height;
+			file_data.format = image.format;
+			file_data.mipmaps = image.num_levels;
+			file_data.first_level = first_level;
 
-			Engine::TextureHandle new_texture = gpu.create_texture(creation);
+			u8* level_data = file_data.data;
+			for ( u32 level = first_level; level < image.num_levels; ++level )
+			{
+				memcpy( level_data, image.levels[ level ].data, image.levels[ level ].size );
+				level_data += image.levels[ level ].size;
+			}
+		}
+
+		file_unmap( &file );
+
+		return valid;
+	}
+
+	static TextureHandle create_texture_from_data( GpuDevice& gpu, const TextureFileData& file_data, cstring name )
+	{
+		if ( TextureFormat::is_block_compressed( file_data.format ) && !gpu.texture_compression_bc_supported )
+		{
+			rprint( "Texture %s is block compressed, the device cannot sample it\n", name );
+			return k_invalid_texture;
+		}
+
+		// Files without mips get them generated on the GPU.
+		const u8 flags = file_data.mipmaps == 1 ? TextureFlags::GenerateMips_mask : 0;
+		const u16 width = ( u16 )max( file_data.width >> file_data.first_level, 1 );
+		const u16 height = ( u16 )max( file_data.height >> file_data.first_level, 1 );
+
+		TextureCreation creation;
+		creation.set_data( file_data.data ).set_format_type( file_data.format, TextureType::Texture2D ).set_flags( ( u8 )( file_data.mipmaps - file_data.first_level ), flags ).set_size( width, height, 1 ).set_name( name );
+
+		return gpu.create_texture(creation);
+	}
+
+	static void clear_texture_streaming( TextureResource* texture )
+	{
+		texture->filename = nullptr;
+		texture->base_levels = nullptr;
+		texture->last_used_frame = 0;
+		texture->screen_size = 0.f;
+		texture->resident_size = 0;
+		texture->stream_levels = 0;
+		texture->stream_pending = false;
+	}
 
-			// IMPORTANT:
-			// Free memory loaded from file, it should not matter!
-			free( image_data );
+	// Creates the texture from the file data. When only the base levels were read the texture is streamed and keeps them,
+	// otherwise the data is freed: pixels were copied to staging memory by the upload.
+	static void init_texture_resource( Renderer& renderer, TextureResource* texture, TextureFileData& file_data, cstring name, cstring filename )
+	{
+		texture->handle = file_data.data ? create_texture_from_data( *renderer.gpu, file_data, name ) : k_invalid_texture;
+		renderer.gpu->query_texture( texture->handle, texture->desc );
+		texture->references = 1;
+		texture->name = name;
+
+		clear_texture_streaming( texture );
+		texture->filename = filename;
 
-			return new_texture;
+		if ( file_data.first_level > 0 && texture->handle.index != k_invalid_index )
+		{
+			texture->base_levels = file_data.data;
+			texture->full_width = ( u16 )file_data.width;
+			texture->full_height = ( u16 )file_data.height;
+			texture->stream_levels = ( u8 )file_data.mipmaps;
+			texture->base_level = ( u8 )file_data.first_level;
+			texture->resident_level = texture->base_level;
+			texture->wanted_level = texture->base_level;
+			texture->resident_size = texture_levels_size( file_data.format, file_data.width, file_data.height, file_data.first_level, file_data.mipmaps );
+
+			renderer.streamed_textures.push( texture );
+			renderer.texture_memory_streamed += texture->resident_size;
+
+			file_data.data = nullptr;
 		}
 
-		return k_invalid_texture;
+		free( file_data.data );
+		file_data.data = nullptr;
+	}
+
+	//
+	// Texture file read by a task scheduler worker.
+	struct TextureDecode
+	{
+		cstring						filename;
+		u32							max_dimension;
+		TextureFileData				file_data;
+		bool						valid;
+
+		TaskCounter					counter;
+		bool						created;
+
+	}; // struct TextureDecode
+
+	static void decode_texture_task( u32 thread_index, void* user_data )
+	{
+		TextureDecode* decode = ( TextureDecode* )user_data;
+		decode->valid = read_texture_file( decode->filename, decode->max_dimension, decode->file_data );
+	}
+
+	// Reads the levels of a streamed texture from read->level on. The file must still match the resident levels.
+	static void read_texture_levels_task( u32 thread_index, void* user_data )
+	{
+		Renderer::TextureRead* read = ( Renderer::TextureRead* )user_data;
+		const TextureResource* texture = read->texture;
+
+		TextureFileData file_data;
+		const u32 max_dimension = max( texture->full_width, texture->full_height ) >> read->level;
+		read->valid = read_texture_file( texture->filename, max_dimension, file_data ) && file_data.first_level == read->level &&
+					  file_data.mipmaps == texture->stream_levels && file_data.format == texture->desc.format &&
+					  file_data.width == texture->full_width && file_data.height == texture->full_height;
+		read->data = file_data.data;
+	}
+
+	// Recreates the texture with the levels from level on, data holds all of them. The handle changes, the previous one is
+	// destroyed once the frames in flight completed. Returns false and keeps the resident levels if creation failed.
+	static bool set_texture_resident_level( Renderer& renderer, TextureResource* texture, u32 level, u8* data )
+	{
+		const u16 width = ( u16 )max( texture->full_width >> level, 1 );
+		const u16 height = ( u16 )max( texture->full_height >> level, 1 );
+
+		TextureHandle handle = renderer.gpu->recreate_texture( texture->handle, width, height, ( u8 )( texture->stream_levels - level ), data );
+		if ( handle.index == k_invalid_index )
+		{
+			return false;
+		}
+
+		texture->handle = handle;
+		renderer.gpu->query_texture( texture->handle, texture->desc );
+		texture->resident_level = ( u8 )level;
+		renderer.texture_handles_changed = true;
+
+		return true;
 	}
 
 	// Renderer ///////////////////////////////////////////////////////
@@ -98,6 +309,15 @@ namespace Engine
 		rprint( "Renderer init\n" );
 
 		gpu = creation.gpu;
+		task_scheduler = creation.task_scheduler;
+
+		// Streaming replaces the images of the textures, only the bindless array picks the new ones up.
+		texture_memory_budget = gpu->bindless_supported && task_scheduler ? creation.texture_memory_budget : 0;
+		texture_memory_streamed = 0;
+		if ( creation.texture_memory_budget && !texture_memory_budget )
+		{
+			rprint( "Texture streaming disabled, it needs bindless textures and a task scheduler\n" );
+		}
 
 		width = gpu->swapchain_width;
 		height = gpu->swapchain_height;
@@ -107,6 +327,8 @@ namespace Engine
 		samplers.init( creation.allocator, 128 );
 
 		resource_cache.init( creation.allocator );
+		render_queue.init( creation.allocator, 1024 );
+		streamed_textures.init( creation.allocator, 16 );
 
 		// init resources hashes.
 		TextureResource::k_type_hash = hash_calculate( TextureResource::k_type_hash );
@@ -121,6 +343,8 @@ namespace Engine
 	void Renderer::shutdown()
 	{
 		resource_cache.shutdown( this );
+		render_queue.shutdown();
+		streamed_textures.shutdown();
 
 		textures.shutdown();
 		buffers.shutdown();
@@ -141,6 +365,10 @@ namespace Engine
 	void Renderer::begin_frame()
 	{
 		gpu->new_frame();
+
+		update_texture_streaming();
+
+		render_queue.clear();
 	}
 
 	void Renderer::end_frame()
@@ -192,6 +420,42 @@ namespace Engine
 		return renderer->create_texture( name, filename );
 	}
 
+	// Runs on a worker: returns a TextureFileData allocated with malloc, the heap allocator is not thread safe.
+	void* TextureLoader::read_file( cstring filename )
+	{
+		TextureFileData* file_data = new ( malloc( sizeof( TextureFileData ) ) ) TextureFileData();
+		if ( !read_texture_file( filename, renderer->texture_memory_budget ? Renderer::k_streaming_base_size : 0, *file_data ) )
+		{
+			release_data( file_data );
+			return nullptr;
+		}
+
+		return file_data;
+	}
+
+	Resource* TextureLoader::create_from_data( cstring name, cstring filename, void* data, ResourceManager* resource_manager )
+	{
+		TextureFileData* file_data = ( TextureFileData* )data;
+		TextureResource* texture = renderer->textures.obtain();
+		if ( texture )
+		{
+			init_texture_resource( *renderer, texture, *file_data, name, filename );
+
+			renderer->resource_cache.textures.insert( hash_calculate( name ), texture );
+		}
+
+		release_data( file_data );
+
+		return texture;
+	}
+
+	void TextureLoader::release_data( void* data )
+	{
+		TextureFileData* file_data = ( TextureFileData* )data;
+		free( file_data->data );
+		free( file_data );
+	}
+
 	// Buffer Loader.
 	Resource* BufferLoader::get( cstring name )
 	{
@@ -278,6 +542,7 @@ namespace Engine
 			texture->handle = handle;
 			texture->name = creation.name;
 			gpu->query_texture( handle, texture->desc );
+			clear_texture_streaming( texture );
 
 			if (creation.name != nullptr)
 			{
@@ -298,11 +563,13 @@ namespace Engine
 
 		if (texture)
 		{
-			TextureHandle handle = create_texture_from_file( *gpu, filename, name );
-			texture->handle = handle;
-			gpu->query_texture(handle, texture->desc);
-			texture->references = 1;
-			texture->name = name;
+			TextureFileData file_data;
+			if ( filename && !read_texture_file( filename, texture_memory_budget ? k_streaming_base_size : 0, file_data ) )
+			{
+				rprint( "Error loading texture %s\n", filename );
+			}
+
+			init_texture_resource( *this, texture, file_data, name, filename );
 
 			resource_cache.textures.insert(hash_calculate( name ), texture);
 			
@@ -312,6 +579,82 @@ namespace Engine
 		return nullptr;
 	}
 
+	void Renderer::create_textures( const cstring* names, const cstring* filenames, u32 count, TaskScheduler* task_scheduler, Allocator* temp_allocator,
+									TextureResource** out_textures )
+	{
+		static const u32 k_textures_per_upload_batch = 8;
+
+		TextureDecode* decodes = ( TextureDecode* )ralloca( sizeof( TextureDecode ) * count, temp_allocator );
+		for ( u32 i = 0; i < count; ++i )
+		{
+			TextureDecode* decode = new ( &decodes[ i ] ) TextureDecode();
+			decode->filename = filenames[ i ];
+			decode->max_dimension = texture_memory_budget ? k_streaming_base_size : 0;
+			decode->valid = false;
+			decode->created = false;
+
+			task_scheduler->add_background_task( decode_texture_task, decode, &decode->counter );
+		}
+
+		// Textures are created as soon as their decode completes, in any order. Decodes only run on the workers.
+		u32 first_pending = 0;
+		u32 batch_count = 0;
+		while ( first_pending < count )
+		{
+			bool created = false;
+			for ( u32 i = first_pending; i < count; ++i )
+			{
+				TextureDecode& decode = decodes[ i ];
+				if ( decode.created || !decode.counter.is_done() )
+				{
+					continue;
+				}
+
+				if ( !decode.valid )
+				{
+					rprint( "Error loading texture %s\n", decode.filename );
+				}
+
+				TextureResource* texture = textures.obtain();
+				if ( texture )
+				{
+					init_texture_resource( *this, texture, decode.file_data, names[ i ], filenames[ i ] );
+
+					resource_cache.textures.insert( hash_calculate( names[ i ] ), texture );
+				}
+				out_textures[ i ] = texture;
+
+				free( decode.file_data.data );
+				decode.file_data.data = nullptr;
+				decode.created = true;
+				created = true;
+
+				if ( ++batch_count == k_textures_per_upload_batch )
+				{
+					gpu->upload_manager.flush();
+					batch_count = 0;
+				}
+			}
+
+			while ( first_pending < count && decodes[ first_pending ].created )
+			{
+				++first_pending;
+			}
+
+			if ( !created && first_pending < count )
+			{
+				task_scheduler->wait( &decodes[ first_pending ].counter );
+			}
+		}
+
+		if ( batch_count )
+		{
+			gpu->upload_manager.flush();
+		}
+
+		temp_allocator->deallocate( decodes );
+	}
+
 	SamplerResource* Renderer::create_sampler( const SamplerCreation& creation )
 	{
 		SamplerResource* sampler = samplers.obtain();
@@ -336,6 +679,204 @@ namespace Engine
 		return nullptr;
 	}
 
+	void Renderer::use_streamed_texture( TextureResource* texture, f32 screen_size )
+	{
+		if ( texture->stream_levels == 0 )
+		{
+			return;
+		}
+
+		// Least detailed level still covering the screen size.
+		const u32 full_size = max( texture->full_width, texture->full_height );
+		u32 level = 0;
+		while ( level + 1 < texture->stream_levels && ( f32 )( full_size >> ( level + 1 ) ) >= screen_size )
+		{
+			++level;
+		}
+		level = min( level, ( u32 )texture->base_level );
+
+		if ( texture->last_used_frame != gpu->absolute_frame )
+		{
+			texture->last_used_frame = gpu->absolute_frame;
+			texture->wanted_level = ( u8 )level;
+			texture->screen_size = screen_size;
+			return;
+		}
+
+		texture->wanted_level = min( texture->wanted_level, ( u8 )level );
+		texture->screen_size = max( texture->screen_size, screen_size );
+	}
+
+	void Renderer::update_texture_streaming()
+	{
+		texture_handles_changed = false;
+		if ( texture_memory_budget == 0 )
+		{
+			return;
+		}
+
+		// Completed reads replace the images.
+		for ( u32 r = 0; r < k_max_texture_reads; ++r )
+		{
+			TextureRead& read = texture_reads[ r ];
+			if ( read.texture == nullptr || !read.counter.is_done() )
+			{
+				continue;
+			}
+
+			TextureResource* texture = read.texture;
+			texture->stream_pending = false;
+			if ( !read.valid || !set_texture_resident_level( *this, texture, read.level, read.data ) )
+			{
+				// The file changed, cannot be read anymore or the texture cannot be created, keep the resident levels.
+				rprint( "Error streaming texture %s, streaming stopped for it\n", texture->filename );
+				stop_texture_streaming( texture );
+			}
+
+			free( read.data );
+			read.data = nullptr;
+			read.texture = nullptr;
+		}
+
+		// Textures used by the frames in flight are never evicted.
+		const u64 frame = gpu->absolute_frame;
+
+		u32 free_read = 0;
+		for ( ;; )
+		{
+			while ( free_read < k_max_texture_reads && texture_reads[ free_read ].texture )
+			{
+				++free_read;
+			}
+
+			if ( free_read == k_max_texture_reads )
+			{
+				break;
+			}
+
+			// The largest one on screen among the recently used textures missing levels.
+			TextureResource* texture = nullptr;
+			for ( u32 t = 0; t < streamed_textures.size; ++t )
+			{
+				TextureResource* candidate = streamed_textures[ t ];
+				if ( candidate->stream_pending || candidate->wanted_level >= candidate->resident_level || candidate->last_used_frame + 1 < frame )
+				{
+					continue;
+				}
+
+				if ( texture == nullptr || candidate->screen_size > texture->screen_size )
+				{
+					texture = candidate;
+				}
+			}
+
+			if ( texture == nullptr )
+			{
+				break;
+			}
+
+			// Evict until the wanted levels fit, then settle for fewer levels if they still do not.
+			u32 level = texture->wanted_level;
+			u32 size = texture_levels_size( texture->desc.format, texture->full_width, texture->full_height, level, texture->stream_levels );
+			while ( texture_memory_streamed - texture->resident_size + size > texture_memory_budget )
+			{
+				if ( !evict_least_recently_used( frame ) )
+				{
+					break;
+				}
+			}
+
+			while ( level < texture->resident_level && texture_memory_streamed - texture->resident_size + size > texture_memory_budget )
+			{
+				++level;
+				size = texture_levels_size( texture->desc.format, texture->full_width, texture->full_height, level, texture->stream_levels );
+			}
+
+			if ( level == texture->resident_level )
+			{
+				// Asked again by the next frame using it.
+				texture->wanted_level = texture->resident_level;
+				continue;
+			}
+
+			texture_memory_streamed += size - texture->resident_size;
+			texture->resident_size = size;
+			texture->stream_pending = true;
+
+			TextureRead& read = texture_reads[ free_read ];
+			read.texture = texture;
+			read.level = level;
+			read.data = nullptr;
+			read.valid = false;
+			// On the workers only, so a frame time wait never runs the file read.
+			task_scheduler->add_background_task( read_texture_levels_task, &read, &read.counter );
+		}
+	}
+
+	bool Renderer::evict_least_recently_used( u64 frame )
+	{
+		TextureResource* victim = nullptr;
+		for ( u32 t = 0; t < streamed_textures.size; ++t )
+		{
+			TextureResource* texture = streamed_textures[ t ];
+			if ( texture->stream_pending || texture->resident_level == texture->base_level || texture->last_used_frame + GpuDevice::k_max_frames > frame )
+			{
+				continue;
+			}
+
+			if ( victim == nullptr || texture->last_used_frame < victim->last_used_frame )
+			{
+				victim = texture;
+			}
+		}
+
+		if ( victim == nullptr )
+		{
+			return false;
+		}
+
+		// Base levels are kept in memory, no read needed.
+		if ( !set_texture_resident_level( *this, victim, victim->base_level, victim->base_levels ) )
+		{
+			return false;
+		}
+
+		const u32 size = texture_levels_size( victim->desc.format, victim->full_width, victim->full_height, victim->base_level, victim->stream_levels );
+		texture_memory_streamed -= victim->resident_size - size;
+		victim->resident_size = size;
+
+		return true;
+	}
+
+	void Renderer::stop_texture_streaming( TextureResource* texture )
+	{
+		// A read in flight writes into its slot, it has to complete first.
+		for ( u32 r = 0; r < k_max_texture_reads; ++r )
+		{
+			TextureRead& read = texture_reads[ r ];
+			if ( read.texture == texture )
+			{
+				task_scheduler->wait( &read.counter );
+				free( read.data );
+				read.data = nullptr;
+				read.texture = nullptr;
+			}
+		}
+
+		for ( u32 t = 0; t < streamed_textures.size; ++t )
+		{
+			if ( streamed_textures[ t ] == texture )
+			{
+				streamed_textures.delete_swap( t );
+				texture_memory_streamed -= texture->resident_size;
+				break;
+			}
+		}
+
+		texture->stream_pending = false;
+		texture->stream_levels = 0;
+	}
+
 	void Renderer::destroy_buffer( BufferResource* buffer )
 	{
 		if( !buffer )
@@ -367,6 +908,13 @@ namespace Engine
 			return;
 		}
 
+		if ( texture->base_levels )
+		{
+			stop_texture_streaming( texture );
+			free( texture->base_levels );
+			texture->base_levels = nullptr;
+		}
+
 		resource_cache.textures.remove( hash_calculate( texture->desc.name) );
 		gpu->destroy_texture( texture->handle );
 		textures.release( texture );
@@ -449,4 +997,146 @@ namespace Engine
 		samplers.shutdown();
 	}
 
+	// RenderQueue ////////////////////////////////////////////////
+
+	static const u32		k_sort_key_depth_bits		= 20;
+	static const u32		k_sort_key_material_bits	= 24;
+	static const u32		k_sort_key_pipeline_bits	= 12;
+	static const u32		k_sort_key_pass_bits		= 8;
+
+	void RenderQueue::init( Allocator* allocator, u32 initial_capacity )
+	{
+		items.init( allocator, initial_capacity );
+		keys.init( allocator, initial_capacity );
+		sorted_indices.init( allocator, initial_capacity );
+		scratch_keys.init( allocator, initial_capacity );
+		scratch_indices.init( allocator, initial_capacity );
+	}
+
+	void RenderQueue::shutdown()
+	{
+		items.shutdown();
+		keys.shutdown();
+		sorted_indices.shutdown();
+		scratch_keys.shutdown();
+		scratch_indices.shutdown();
+	}
+
+	void RenderQueue::clear()
+	{
+		items.clear();
+		keys.clear();
+		sorted_indices.clear();
+	}
+
+	void RenderQueue::add( u64 sort_key, const DrawItem& item )
+	{
+		RASSERT( item.num_vertex_buffers <= k_max_draw_vertex_buffers );
+
+		sorted_indices.push( items.size );
+		items.push( item );
+		keys.push( sort_key );
+	}
+
+	u64 RenderQueue::make_sort_key( u32 pass, u32 pipeline, u32 material, f32 depth )
+	{
+		const u64 depth_max = ( 1ull << k_sort_key_depth_bits ) - 1;
+		const f32 depth_clamped = depth < 0.f ? 0.f : ( depth > 1.f ? 1.f : depth );
+
+		u64 key = ( u64 )( pass & ( ( 1u << k_sort_key_pass_bits ) - 1 ) );
+		key = ( key << k_sort_key_pipeline_bits ) | ( pipeline & ( ( 1u << k_sort_key_pipeline_bits ) - 1 ) );
+		key = ( key << k_sort_key_material_bits ) | ( material & ( ( 1u << k_sort_key_material_bits ) - 1 ) );
+		key = ( key << k_sort_key_depth_bits ) | ( u64 )( depth_clamped * depth_max );
+
+		return key;
+	}
+
+	void RenderQueue::sort()
+	{
+		const u32 count = keys.size;
+		if ( count < 2 )
+		{
+			return;
+		}
+
+		// Keys are sorted together with the item indices, ping-ponging with the scratch arrays.
+		scratch_keys.set_size( count );
+		scratch_indices.set_size( count );
+
+		u64* keys_in = keys.data;
+		u32* indices_in = sorted_indices.data;
+		u64* keys_out = scratch_keys.data;
+		u32* indices_out = scratch_indices.data;
+
+		for ( u32 shift = 0; shift < 64; shift += 8 )
+		{
+			u32 histogram[ 256 ] = {};
+			for ( u32 i = 0; i < count; ++i )
+			{
+				++histogram[ ( keys_in[ i ] >> shift ) & 0xff ];
+			}
+
+			// All keys share this digit, the order would not change.
+			if ( histogram[ ( keys_in[ 0 ] >> shift ) & 0xff ] == count )
+			{
+				continue;
+			}
+
+			u32 offset = 0;
+			for ( u32 d = 0; d < 256; ++d )
+			{
+				const u32 digit_count = histogram[ d ];
+				histogram[ d ] = offset;
+				offset += digit_count;
+			}
+
+			for ( u32 i = 0; i < count; ++i )
+			{
+				const u32 destination = histogram[ ( keys_in[ i ] >> shift ) & 0xff ]++;
+				keys_out[ destination ] = keys_in[ i ];
+				indices_out[ destination ] = indices_in[ i ];
+			}
+
+			u64* keys_swap = keys_in;
+			keys_in = keys_out;
+			keys_out = keys_swap;
+
+			u32* indices_swap = indices_in;
+			indices_in = indices_out;
+			indices_out = indices_swap;
+		}
+
+		// Sorted data ended in the scratch arrays, copy it back.
+		if ( keys_in != keys.data )
+		{
+			memcpy( keys.data, keys_in, sizeof( u64 ) * count );
+			memcpy( sorted_indices.data, indices_in, sizeof( u32 ) * count );
+		}
+	}
+
+	void RenderQueue::record( CommandBuffer* commands, u32 first, u32 count ) const
+	{
+		RASSERT( first + count <= sorted_indices.size );
+
+		// Binds repeated by consecutive items are skipped by the command buffer.
+		for ( u32 i = first; i < first + count; ++i )
+		{
+			const DrawItem& item = items[ sorted_indices[ i ] ];
+
+			commands->bind_pipeline( item.pipeline );
+
+			for ( u32 v = 0; v < item.num_vertex_buffers; ++v )
+			{
+				commands->bind_vertex_buffer( item.vertex_buffers[ v ], v, item.vertex_offsets[ v ] );
+			}
+
+			commands->bind_index_buffer( item.index_buffer, item.index_offset, item.index_type );
+
+			DescriptorSetHandle descriptor_set = item.descriptor_set;
+			commands->bind_descriptor_set( &descriptor_set, 1, nullptr, 0 );
+
+			commands->draw_indexed( TopologyType::Triangle, item.index_count, item.instance_count, item.first_index, item.vertex_offset, item.first_instance );
+		}
+	}
+
 }	// Namesapce Engine
\ No newline at end of file
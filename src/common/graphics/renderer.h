@@ -4,6 +4,8 @@
 #include "graphics/gpu_resource.h"
 
 #include "foundation/resource_manager.h"
+#include "foundation/array.h"
+#include "foundation/task_scheduler.h"
 
 namespace Engine
 {
@@ -31,6 +33,21 @@ namespace Engine
 		u32										pool_index;
 		TextureDescription						desc;
 
+		// Mip streaming, see Renderer::update_texture_streaming. Levels are counted in the full chain of the file,
+		// stream_levels is 0 for textures that are always fully resident.
+		cstring									filename;
+		u8*										base_levels;			// Levels from base_level on, packed largest first, to evict without reading the file.
+		u64										last_used_frame;
+		f32										screen_size;			// Largest estimate in pixels during last_used_frame.
+		u32										resident_size;			// Bytes of the resident levels.
+		u16										full_width;
+		u16										full_height;
+		u8										stream_levels;
+		u8										base_level;				// Always resident.
+		u8										resident_level;			// Most detailed level on the GPU.
+		u8										wanted_level;
+		bool									stream_pending;			// A read of more levels is in flight.
+
 		static constexpr cstring				k_type = "engine_texture_type";
 		static u64								k_type_hash;
 
@@ -62,6 +79,66 @@ namespace Engine
 
 	}; // struct ResourceCache
 
+	// RenderQueue //////////////////////////////////////////////////
+	//
+	static const u32							k_max_draw_vertex_buffers	= 8;
+
+	//
+	// Everything needed to record an indexed draw. Handles are resolved when recording.
+	//
+	struct DrawItem
+	{
+		PipelineHandle							pipeline;
+		DescriptorSetHandle						descriptor_set;
+
+		BufferHandle							vertex_buffers[ k_max_draw_vertex_buffers ];
+		u32										vertex_offsets[ k_max_draw_vertex_buffers ];
+		u32										num_vertex_buffers			= 0;
+
+		BufferHandle							index_buffer;
+		u32										index_offset				= 0;
+		VkIndexType								index_type					= VK_INDEX_TYPE_UINT16;
+
+		u32										index_count					= 0;
+		u32										instance_count				= 1;
+		u32										first_instance				= 0;
+		u32										first_index					= 0;
+		i32										vertex_offset				= 0;		// Added to the indices, meshes sub-allocated in shared buffers.
+
+	}; // struct DrawItem
+
+	//
+	// Draws collected during the frame, recorded in the order of their 64 bit sort key.
+	// Key layout, from the most significant bit: pass (8), pipeline (12), material (24), depth (20).
+	//
+	struct RenderQueue
+	{
+		void									init( Allocator* allocator, u32 initial_capacity );
+		void									shutdown();
+
+		void									clear();
+		void									add( u64 sort_key, const DrawItem& item );
+
+		// Stable LSD radix sort of the keys, 8 bits per pass. Passes where all keys share the digit are skipped.
+		void									sort();
+
+		// Records sorted draws [first, first + count), can be called from several threads on different ranges.
+		void									record( CommandBuffer* commands, u32 first, u32 count ) const;
+
+		u32										size() const				{ return keys.size; }
+
+		// depth is normalized in [0, 1], smaller values are sorted first.
+		static u64								make_sort_key( u32 pass, u32 pipeline, u32 material, f32 depth );
+
+		Array<DrawItem>							items;
+		Array<u64>								keys;
+		Array<u32>								sorted_indices;
+
+		Array<u64>								scratch_keys;
+		Array<u32>								scratch_indices;
+
+	}; // struct RenderQueue
+
 	//
 	// Renderer /////////////////////////////////////////////////////
 
@@ -69,6 +146,9 @@ namespace Engine
 	{
 		Engine::GpuDevice*						gpu;
 		Allocator*								allocator;
+
+		TaskScheduler*							task_scheduler			= nullptr;		// Reads streamed levels.
+		sizet									texture_memory_budget	= 0;			// Streams texture mips when not zero, needs bindless textures.
 	};
 
 	//
@@ -83,7 +163,7 @@ namespace Engine
 
 		void									set_loaders( Engine::ResourceManager* manager );
 
-		void									begin_frame();
+		void									begin_frame();							// Also clears the render queue.
 		void									end_frame();
 
 		void									resize_swapchain( u32 width, u32 height );
@@ -96,9 +176,24 @@ namespace Engine
 
 		TextureResource*						create_texture( const TextureCreation& creation );
 		TextureResource*						create_texture( cstring name, cstring filename );
+		// Decodes the files on the task scheduler and creates the textures as their decode completes, flushing uploads in batches.
+		void									create_textures( const cstring* names, const cstring* filenames, u32 count, TaskScheduler* task_scheduler,
+																 Allocator* temp_allocator, TextureResource** out_textures );
 
 		SamplerResource*						create_sampler( const SamplerCreation& creation );
 
+		// Texture streaming //////////////////////////////////////
+		// With a budget, textures read from KTX2 files are created with their levels up to k_streaming_base_size only.
+		// Called for every streamed texture drawn in the frame, screen_size is the size in pixels of what it covers.
+		void									use_streamed_texture( TextureResource* texture, f32 screen_size );
+		// Called by begin_frame. Applies the completed reads, then reads the levels wanted by the largest textures on screen,
+		// evicting the least recently used levels while the budget is exceeded.
+		void									update_texture_streaming();
+		// Drops a texture not used since the previous frame back to its base levels, the least recently used first.
+		bool									evict_least_recently_used( u64 frame );
+		// Waits for its read in flight, the texture keeps its resident levels.
+		void									stop_texture_streaming( TextureResource* texture );
+
 		void									destroy_buffer( BufferResource* buffer );
 		void									destroy_texture( TextureResource* texture );
 		void									destroy_sampler( SamplerResource* sampler );
@@ -110,13 +205,37 @@ namespace Engine
 		CommandBuffer*							get_command_buffer( QueueType::Enum type, bool begin ) { return gpu->get_command_buffer( type, begin); }
 		void									queue_command_buffer( Engine::CommandBuffer* commands ) { gpu->queue_command_buffer( commands ); }
 
+		static const u32						k_max_texture_reads		= 4;
+		static const u32						k_streaming_base_size	= 64;
+
+		//
+		// Levels [level, stream_levels) of a streamed texture, read by a task scheduler worker.
+		struct TextureRead
+		{
+			TextureResource*					texture					= nullptr;		// nullptr when the slot is free.
+			u8*									data					= nullptr;
+			u32									level					= 0;
+			bool								valid					= false;
+
+			TaskCounter							counter;
+
+		}; // struct TextureRead
+
 		ResourcePoolTyped<TextureResource>		textures;
 		ResourcePoolTyped<BufferResource>		buffers;
 		ResourcePoolTyped<SamplerResource>		samplers;
 
 		ResourceCache							resource_cache;
+		RenderQueue								render_queue;
 		Engine::GpuDevice*						gpu;
 
+		TaskScheduler*							task_scheduler;
+		Array<TextureResource*>					streamed_textures;
+		TextureRead								texture_reads[ k_max_texture_reads ];
+		sizet									texture_memory_budget;
+		sizet									texture_memory_streamed;		// Resident bytes of streamed textures once the reads in flight are applied.
+		bool									texture_handles_changed	= false;	// Streaming gave textures new handles this frame, indices held elsewhere are stale.
+
 		u16										width;
 		u16										height;
 	
@@ -0,0 +1,299 @@
+#include "graphics/scene_cache.h"
+
+#include "foundation/memory.h"
+#include "foundation/log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace Engine
+{
+	static const u64						k_blob_alignment		= 16;
+
+	static bool blob_in_file( const SceneCacheBlob& blob, sizet file_size )
+	{
+		return blob.offset <= file_size && blob.size <= file_size - blob.offset;
+	}
+
+	// Texture indices and geometry ranges of a draw, so nothing built from it reads out of the tables or the arena.
+	static bool draw_is_valid( const SceneCacheDraw& draw, const SceneCacheHeader& header )
+	{
+		for ( u32 slot = 0; slot < SceneCacheTextureSlot_Count; ++slot )
+		{
+			const SceneCacheTexture& texture = draw.textures[ slot ];
+			if ( ( texture.image != u32_max && texture.image >= header.num_images ) || ( texture.sampler != u32_max && texture.sampler >= header.num_samplers ) )
+			{
+				return false;
+			}
+		}
+
+		u32 num_indices;
+		if ( draw.index_type == VK_INDEX_TYPE_UINT16 )
+		{
+			num_indices = header.num_indices_16;
+		}
+		else if ( draw.index_type == VK_INDEX_TYPE_UINT32 )
+		{
+			num_indices = header.num_indices_32;
+		}
+		else
+		{
+			return false;
+		}
+
+		return ( u64 )draw.first_index + draw.index_count <= num_indices && draw.vertex_offset < header.num_vertices;
+	}
+
+	// Appends data aligned to k_blob_alignment, cursor tracks the file size.
+	static bool write_blob( FILE* file, const void* data, sizet size, u64& cursor, SceneCacheBlob& blob )
+	{
+		static const u8 padding[ k_blob_alignment ] = { };
+
+		const u64 padding_size = ( k_blob_alignment - ( cursor % k_blob_alignment ) ) % k_blob_alignment;
+		if ( padding_size && fwrite( padding, padding_size, 1, file ) != 1 )
+		{
+			return false;
+		}
+		cursor += padding_size;
+
+		blob.offset = cursor;
+		blob.size = size;
+
+		if ( size && fwrite( data, size, 1, file ) != 1 )
+		{
+			return false;
+		}
+		cursor += size;
+
+		return true;
+	}
+
+	// SceneCache ///////////////////////////////////////////////////////////
+
+	bool SceneCache::map( cstring path, const u32* stream_strides, u32 num_streams )
+	{
+		if ( !file_map( path, &file ) )
+		{
+			return false;
+		}
+
+		header = ( const SceneCacheHeader* )file.data;
+
+		bool valid = file.size >= sizeof( SceneCacheHeader ) && header->magic == k_scene_cache_magic && header->version == k_scene_cache_version &&
+					 header->num_streams == num_streams;
+
+		if ( valid )
+		{
+			const SceneCacheBlob* blobs[] = { &header->sources, &header->images, &header->samplers, &header->draws, &header->strings,
+											  &header->indices_16, &header->indices_32 };
+			for ( u32 b = 0; b < ArraySize( blobs ); ++b )
+			{
+				valid &= blob_in_file( *blobs[ b ], file.size );
+			}
+			for ( u32 s = 0; s < num_streams; ++s )
+			{
+				valid &= blob_in_file( header->vertex_streams[ s ], file.size ) && header->vertex_streams[ s ].size == ( u64 )header->num_vertices * stream_strides[ s ];
+			}
+
+			valid &= header->sources.size == header->num_sources * sizeof( SceneCacheSource ) && header->images.size == header->num_images * sizeof( u32 ) &&
+					 header->samplers.size == header->num_samplers * sizeof( SceneCacheSampler ) && header->draws.size == header->num_draws * sizeof( SceneCacheDraw ) &&
+					 header->indices_16.size == header->num_indices_16 * sizeof( u16 ) && header->indices_32.size == header->num_indices_32 * sizeof( u32 );
+			// String table is null terminated, so offsets in it are safe to read.
+			valid &= header->strings.size > 0 && file.data[ header->strings.offset + header->strings.size - 1 ] == 0;
+		}
+
+		if ( valid )
+		{
+			const u32* images = ( const u32* )( file.data + header->images.offset );
+			for ( u32 i = 0; i < header->num_images && valid; ++i )
+			{
+				valid = images[ i ] < header->strings.size;
+			}
+
+			const SceneCacheDraw* draws = ( const SceneCacheDraw* )( file.data + header->draws.offset );
+			for ( u32 d = 0; d < header->num_draws && valid; ++d )
+			{
+				valid = draw_is_valid( draws[ d ], *header );
+			}
+		}
+
+		if ( valid )
+		{
+			tables.images = ( const u32* )( file.data + header->images.offset );
+			tables.samplers = ( const SceneCacheSampler* )( file.data + header->samplers.offset );
+			tables.draws = ( const SceneCacheDraw* )( file.data + header->draws.offset );
+			tables.strings = ( const char* )( file.data + header->strings.offset );
+			tables.num_images = header->num_images;
+			tables.num_samplers = header->num_samplers;
+			tables.num_draws = header->num_draws;
+
+			// Stale when any source changed since the cache was written.
+			const SceneCacheSource* sources = ( const SceneCacheSource* )( file.data + header->sources.offset );
+			for ( u32 s = 0; s < header->num_sources && valid; ++s )
+			{
+				const SceneCacheSource& source = sources[ s ];
+				sizet size;
+				u64 last_write_time;
+				valid = source.path < header->strings.size && file_stat( tables.strings + source.path, &size, &last_write_time ) &&
+						size == source.size && last_write_time == source.last_write_time;
+			}
+		}
+
+		if ( !valid )
+		{
+			rprint( "Scene cache %s is out of date, rebuilding it\n", path );
+			unmap();
+		}
+
+		return valid;
+	}
+
+	void SceneCache::unmap()
+	{
+		file_unmap( &file );
+		header = nullptr;
+		tables = { };
+	}
+
+	void SceneCache::upload_geometry( GeometryArena& arena, cstring name ) const
+	{
+		const u8* stream_data[ GeometryArena::k_max_streams ];
+		for ( u32 s = 0; s < header->num_streams; ++s )
+		{
+			stream_data[ s ] = file.data + header->vertex_streams[ s ].offset;
+		}
+
+		arena.upload( name, stream_data, header->num_vertices, ( const u16* )( file.data + header->indices_16.offset ), header->num_indices_16,
+					  ( const u32* )( file.data + header->indices_32.offset ), header->num_indices_32 );
+	}
+
+	// SceneCacheWriter /////////////////////////////////////////////////////
+
+	void SceneCacheWriter::init( Allocator* allocator )
+	{
+		sources.init( allocator, 4 );
+		images.init( allocator, 16 );
+		samplers.init( allocator, 4 );
+		draws.init( allocator, 64 );
+		strings.init( allocator, 1024 );
+	}
+
+	void SceneCacheWriter::shutdown()
+	{
+		sources.shutdown();
+		images.shutdown();
+		samplers.shutdown();
+		draws.shutdown();
+		strings.shutdown();
+	}
+
+	bool SceneCacheWriter::add_source( cstring path )
+	{
+		SceneCacheSource source{ };
+		sizet size;
+		if ( !file_stat( path, &size, &source.last_write_time ) )
+		{
+			return false;
+		}
+		source.size = size;
+
+		source.path = add_string( path );
+		sources.push( source );
+
+		return true;
+	}
+
+	void SceneCacheWriter::add_image( cstring uri )
+	{
+		images.push( add_string( uri ) );
+	}
+
+	void SceneCacheWriter::add_sampler( u32 min_filter, u32 mag_filter, u32 mip_filter )
+	{
+		samplers.push( { min_filter, mag_filter, mip_filter } );
+	}
+
+	void SceneCacheWriter::add_draw( const SceneCacheDraw& draw )
+	{
+		draws.push( draw );
+	}
+
+	u32 SceneCacheWriter::add_string( cstring string )
+	{
+		const u32 offset = strings.size;
+		const u32 length = ( u32 )strlen( string ) + 1;
+
+		strings.set_size( offset + length );
+		memcpy( strings.data + offset, string, length );
+
+		return offset;
+	}
+
+	SceneCacheTables SceneCacheWriter::get_tables() const
+	{
+		SceneCacheTables tables;
+		tables.images = images.data;
+		tables.samplers = samplers.data;
+		tables.draws = draws.data;
+		tables.strings = strings.data;
+		tables.num_images = images.size;
+		tables.num_samplers = samplers.size;
+		tables.num_draws = draws.size;
+
+		return tables;
+	}
+
+	bool SceneCacheWriter::write( cstring path, const GeometryArena& arena )
+	{
+		RASSERTM( arena.index_buffer_16.index == k_invalid_index, "Scene cache needs the arena CPU data, write it before the upload" );
+
+		FILE* file = fopen( path, "wb" );
+		if ( !file )
+		{
+			rprint( "Cannot write scene cache %s\n", path );
+			return false;
+		}
+
+		SceneCacheHeader header{ };
+		header.num_sources = sources.size;
+		header.num_images = images.size;
+		header.num_samplers = samplers.size;
+		header.num_draws = draws.size;
+		header.num_streams = arena.num_streams;
+		header.num_vertices = arena.num_vertices;
+		header.num_indices_16 = arena.num_indices_16;
+		header.num_indices_32 = arena.num_indices_32;
+
+		// The header goes last with the magic, so a partially written file is never accepted.
+		u64 cursor = sizeof( SceneCacheHeader );
+		bool written = fwrite( &header, sizeof( SceneCacheHeader ), 1, file ) == 1;
+
+		written = written && write_blob( file, sources.data, sources.size * sizeof( SceneCacheSource ), cursor, header.sources );
+		written = written && write_blob( file, images.data, images.size * sizeof( u32 ), cursor, header.images );
+		written = written && write_blob( file, samplers.data, samplers.size * sizeof( SceneCacheSampler ), cursor, header.samplers );
+		written = written && write_blob( file, draws.data, draws.size * sizeof( SceneCacheDraw ), cursor, header.draws );
+		written = written && write_blob( file, strings.data, strings.size, cursor, header.strings );
+
+		for ( u32 s = 0; s < arena.num_streams; ++s )
+		{
+			written = written && write_blob( file, arena.vertex_data[ s ].data, arena.num_vertices * arena.stream_strides[ s ], cursor, header.vertex_streams[ s ] );
+		}
+		written = written && write_blob( file, arena.index_data_16.data, arena.num_indices_16 * sizeof( u16 ), cursor, header.indices_16 );
+		written = written && write_blob( file, arena.index_data_32.data, arena.num_indices_32 * sizeof( u32 ), cursor, header.indices_32 );
+
+		header.magic = k_scene_cache_magic;
+		header.version = k_scene_cache_version;
+		written = written && fseek( file, 0, SEEK_SET ) == 0 && fwrite( &header, sizeof( SceneCacheHeader ), 1, file ) == 1;
+
+		fclose( file );
+
+		if ( !written )
+		{
+			rprint( "Failed writing scene cache %s\n", path );
+			file_delete( path );
+		}
+
+		return written;
+	}
+
+} // namespace Engine
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "graphics/geometry_arena.h"
+
+#include "foundation/array.h"
+#include "foundation/file.h"
+
+namespace Engine
+{
+	// Scene cache //////////////////////////////////////////////////////////
+
+	//
+	// Processed scene written next to its glTF source: flattened draws, material parameters, texture references
+	// and the packed geometry arena. The file only holds offsets so it can be memory mapped and used in place.
+	// Bump k_scene_cache_version whenever a record layout or the packed vertex format changes.
+	//
+
+	static const u32						k_scene_cache_magic		= 0x43535245;		// 'ERSC'
+	static const u32						k_scene_cache_version	= 3;
+
+	// Material texture slots, in the order of the material descriptor bindings.
+	enum SceneCacheTextureSlot
+	{
+		SceneCacheTextureSlot_Diffuse,
+		SceneCacheTextureSlot_Roughness,
+		SceneCacheTextureSlot_Occlusion,
+		SceneCacheTextureSlot_Emissive,
+		SceneCacheTextureSlot_Normal,
+		SceneCacheTextureSlot_Count
+	};
+
+	struct SceneCacheTexture
+	{
+		u32									image				= u32_max;		// u32_max when the slot is unused.
+		u32									sampler				= u32_max;		// u32_max for the default sampler.
+	}; // struct SceneCacheTexture
+
+	struct SceneCacheSampler
+	{
+		u32									min_filter;			// VkFilter
+		u32									mag_filter;
+		u32									mip_filter;			// VkSamplerMipmapMode
+	}; // struct SceneCacheSampler
+
+	// One drawn primitive, with its world matrix and material parameters resolved.
+	struct SceneCacheDraw
+	{
+		f32									model[ 16 ];
+		f32									base_color_factor[ 4 ];
+		f32									emissive_factor[ 3 ];
+		f32									metallic_factor;
+		f32									roughness_factor;
+		f32									occlusion_factor;
+		u32									flags;				// Vertex attribute and texture features of the material.
+		u32									material_index;
+
+		SceneCacheTexture					textures[ SceneCacheTextureSlot_Count ];
+
+		// Geometry arena range.
+		u32									first_index;
+		u32									vertex_offset;
+		u32									index_count;
+		u32									index_type;			// VkIndexType
+
+		f32									bounds_min[ 3 ];
+		f32									bounds_max[ 3 ];
+	}; // struct SceneCacheDraw
+
+	// File the cache was built from, the cache is stale when any of them changed.
+	struct SceneCacheSource
+	{
+		u32									path;				// Offset in the string table.
+		u32									pad;
+		u64									size;
+		u64									last_write_time;
+	}; // struct SceneCacheSource
+
+	struct SceneCacheBlob
+	{
+		u64									offset;
+		u64									size;
+	}; // struct SceneCacheBlob
+
+	struct SceneCacheHeader
+	{
+		u32									magic;
+		u32									version;
+
+		u32									num_sources;
+		u32									num_images;
+		u32									num_samplers;
+		u32									num_draws;
+
+		u32									num_streams;
+		u32									num_vertices;
+		u32									num_indices_16;
+		u32									num_indices_32;
+
+		SceneCacheBlob						sources;
+		SceneCacheBlob						images;				// String table offsets of the image uris.
+		SceneCacheBlob						samplers;
+		SceneCacheBlob						draws;
+		SceneCacheBlob						strings;
+
+		SceneCacheBlob						vertex_streams[ GeometryArena::k_max_streams ];
+		SceneCacheBlob						indices_16;
+		SceneCacheBlob						indices_32;
+	}; // struct SceneCacheHeader
+
+	//
+	// Scene tables consumed by the renderer, pointing either in a mapped cache or in the writer that built it.
+	//
+	struct SceneCacheTables
+	{
+		cstring								get_image_uri( u32 image ) const	{ return strings + images[ image ]; }
+
+		const u32*							images				= nullptr;
+		const SceneCacheSampler*			samplers			= nullptr;
+		const SceneCacheDraw*				draws				= nullptr;
+		const char*							strings				= nullptr;
+
+		u32									num_images			= 0;
+		u32									num_samplers		= 0;
+		u32									num_draws			= 0;
+
+	}; // struct SceneCacheTables
+
+	//
+	// Memory mapped cache file. Tables and geometry point in the mapping, that must outlive their users.
+	//
+	struct SceneCache
+	{
+		// Returns false when the file is missing, from another version, malformed or older than its sources.
+		// Every table index and geometry range is checked, stream_strides are the arena vertex stream strides.
+		bool								map( cstring path, const u32* stream_strides, u32 num_streams );
+		void								unmap();
+
+		// Creates the arena buffers straight from the mapped geometry.
+		void								upload_geometry( GeometryArena& arena, cstring name ) const;
+
+		MappedFile							file;
+		const SceneCacheHeader*				header				= nullptr;
+		SceneCacheTables					tables;
+
+	}; // struct SceneCache
+
+	//
+	// Collects the processed scene on a cache miss, then writes it with the arena geometry before it is uploaded.
+	//
+	struct SceneCacheWriter
+	{
+		void								init( Allocator* allocator );
+		void								shutdown();
+
+		bool								add_source( cstring path );		// Returns false if the file cannot be found.
+		void								add_image( cstring uri );
+		void								add_sampler( u32 min_filter, u32 mag_filter, u32 mip_filter );
+		void								add_draw( const SceneCacheDraw& draw );
+
+		bool								write( cstring path, const GeometryArena& arena );
+
+		// Valid until the next add.
+		SceneCacheTables					get_tables() const;
+
+		u32									add_string( cstring string );
+
+		Array<SceneCacheSource>				sources;
+		Array<u32>							images;
+		Array<SceneCacheSampler>			samplers;
+		Array<SceneCacheDraw>				draws;
+		Array<char>							strings;
+
+	}; // struct SceneCacheWriter
+
+} // namespace Engine
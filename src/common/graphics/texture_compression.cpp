@@ -0,0 +1,424 @@
+#include "graphics/texture_compression.h"
+
+#include "foundation/assert.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Engine
+{
+	// BC7 mode 6 interpolation weights of the 4 bit indices.
+	static const u32						k_bc7_weights_4[ 16 ]	= { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Reads a 4x4 block, clamping coordinates at the image edges.
+	static void load_block( const u8* pixels, u32 width, u32 height, u32 block_x, u32 block_y, u8 block[ 16 ][ 4 ] )
+	{
+		for ( u32 y = 0; y < 4; ++y )
+		{
+			const u32 pixel_y = block_y * 4 + y < height ? block_y * 4 + y : height - 1;
+			for ( u32 x = 0; x < 4; ++x )
+			{
+				const u32 pixel_x = block_x * 4 + x < width ? block_x * 4 + x : width - 1;
+				memcpy( block[ y * 4 + x ], pixels + ( pixel_y * width + pixel_x ) * 4, 4 );
+			}
+		}
+	}
+
+	static u32 squared_distance( const u8* a, const u8* b, u32 channels )
+	{
+		u32 distance = 0;
+		for ( u32 c = 0; c < channels; ++c )
+		{
+			const i32 delta = ( i32 )a[ c ] - ( i32 )b[ c ];
+			distance += delta * delta;
+		}
+		return distance;
+	}
+
+	// Endpoints of the principal axis through the block colors, found by power iteration on the covariance.
+	static void fit_endpoints( const u8 block[ 16 ][ 4 ], u32 channels, f32 endpoint_0[ 4 ], f32 endpoint_1[ 4 ] )
+	{
+		f32 mean[ 4 ] = { };
+		for ( u32 i = 0; i < 16; ++i )
+		{
+			for ( u32 c = 0; c < channels; ++c )
+			{
+				mean[ c ] += block[ i ][ c ] / 16.f;
+			}
+		}
+
+		f32 covariance[ 4 ][ 4 ] = { };
+		for ( u32 i = 0; i < 16; ++i )
+		{
+			for ( u32 a = 0; a < channels; ++a )
+			{
+				for ( u32 b = 0; b < channels; ++b )
+				{
+					covariance[ a ][ b ] += ( block[ i ][ a ] - mean[ a ] ) * ( block[ i ][ b ] - mean[ b ] );
+				}
+			}
+		}
+
+		f32 axis[ 4 ] = { 1.f, 1.f, 1.f, 1.f };
+		for ( u32 iteration = 0; iteration < 8; ++iteration )
+		{
+			f32 next[ 4 ] = { };
+			f32 length = 0.f;
+			for ( u32 a = 0; a < channels; ++a )
+			{
+				for ( u32 b = 0; b < channels; ++b )
+				{
+					next[ a ] += covariance[ a ][ b ] * axis[ b ];
+				}
+				length += next[ a ] * next[ a ];
+			}
+
+			// Flat block: any axis works.
+			if ( length < 1e-6f )
+			{
+				break;
+			}
+
+			length = 1.f / sqrtf( length );
+			for ( u32 c = 0; c < channels; ++c )
+			{
+				axis[ c ] = next[ c ] * length;
+			}
+		}
+
+		f32 min_projection = 0.f, max_projection = 0.f;
+		for ( u32 i = 0; i < 16; ++i )
+		{
+			f32 projection = 0.f;
+			for ( u32 c = 0; c < channels; ++c )
+			{
+				projection += ( block[ i ][ c ] - mean[ c ] ) * axis[ c ];
+			}
+			min_projection = projection < min_projection ? projection : min_projection;
+			max_projection = projection > max_projection ? projection : max_projection;
+		}
+
+		for ( u32 c = 0; c < channels; ++c )
+		{
+			endpoint_0[ c ] = mean[ c ] + axis[ c ] * max_projection;
+			endpoint_1[ c ] = mean[ c ] + axis[ c ] * min_projection;
+		}
+	}
+
+	static u8 clamp_to_u8( f32 value )
+	{
+		return value <= 0.f ? 0 : value >= 255.f ? 255 : ( u8 )( value + 0.5f );
+	}
+
+	// BC1 //////////////////////////////////////////////////////////////////
+
+	static u16 pack_565( const f32 color[ 4 ] )
+	{
+		const u32 r = clamp_to_u8( color[ 0 ] ) * 31 + 127;
+		const u32 g = clamp_to_u8( color[ 1 ] ) * 63 + 127;
+		const u32 b = clamp_to_u8( color[ 2 ] ) * 31 + 127;
+		return ( u16 )( ( ( r / 255 ) << 11 ) | ( ( g / 255 ) << 5 ) | ( b / 255 ) );
+	}
+
+	static void unpack_565( u16 packed, u8 color[ 4 ] )
+	{
+		const u32 r = ( packed >> 11 ) & 31, g = ( packed >> 5 ) & 63, b = packed & 31;
+		color[ 0 ] = ( u8 )( ( r << 3 ) | ( r >> 2 ) );
+		color[ 1 ] = ( u8 )( ( g << 2 ) | ( g >> 4 ) );
+		color[ 2 ] = ( u8 )( ( b << 3 ) | ( b >> 2 ) );
+		color[ 3 ] = 255;
+	}
+
+	static void encode_bc1_block( const u8 block[ 16 ][ 4 ], u8* output )
+	{
+		f32 endpoint_0[ 4 ], endpoint_1[ 4 ];
+		fit_endpoints( block, 3, endpoint_0, endpoint_1 );
+
+		u16 color_0 = pack_565( endpoint_0 );
+		u16 color_1 = pack_565( endpoint_1 );
+		// Four color mode needs color_0 > color_1.
+		if ( color_0 < color_1 )
+		{
+			const u16 swap = color_0;
+			color_0 = color_1;
+			color_1 = swap;
+		}
+
+		u8 palette[ 4 ][ 4 ];
+		unpack_565( color_0, palette[ 0 ] );
+		unpack_565( color_1, palette[ 1 ] );
+		for ( u32 c = 0; c < 3; ++c )
+		{
+			palette[ 2 ][ c ] = ( u8 )( ( 2 * palette[ 0 ][ c ] + palette[ 1 ][ c ] ) / 3 );
+			palette[ 3 ][ c ] = ( u8 )( ( palette[ 0 ][ c ] + 2 * palette[ 1 ][ c ] ) / 3 );
+		}
+
+		u32 indices = 0;
+		if ( color_0 != color_1 )
+		{
+			for ( u32 i = 0; i < 16; ++i )
+			{
+				u32 best_index = 0, best_distance = u32_max;
+				for ( u32 p = 0; p < 4; ++p )
+				{
+					const u32 distance = squared_distance( block[ i ], palette[ p ], 3 );
+					if ( distance < best_distance )
+					{
+						best_distance = distance;
+						best_index = p;
+					}
+				}
+				indices |= best_index << ( i * 2 );
+			}
+		}
+
+		memcpy( output, &color_0, 2 );
+		memcpy( output + 2, &color_1, 2 );
+		memcpy( output + 4, &indices, 4 );
+	}
+
+	// BC4 / BC5 ////////////////////////////////////////////////////////////
+
+	static void encode_bc4_block( const u8 block[ 16 ][ 4 ], u32 channel, u8* output )
+	{
+		u8 min_value = 255, max_value = 0;
+		for ( u32 i = 0; i < 16; ++i )
+		{
+			const u8 value = block[ i ][ channel ];
+			min_value = value < min_value ? value : min_value;
+			max_value = value > max_value ? value : max_value;
+		}
+
+		// Eight value mode: both endpoints, then 6 values interpolated from max to min.
+		u8 palette[ 8 ] = { max_value, min_value };
+		for ( u32 p = 1; p < 7; ++p )
+		{
+			palette[ p + 1 ] = ( u8 )( ( ( 7 - p ) * max_value + p * min_value + 3 ) / 7 );
+		}
+
+		u64 indices = 0;
+		if ( max_value != min_value )
+		{
+			for ( u32 i = 0; i < 16; ++i )
+			{
+				const i32 value = block[ i ][ channel ];
+				u32 best_index = 0, best_distance = u32_max;
+				for ( u32 p = 0; p < 8; ++p )
+				{
+					const u32 distance = ( u32 )abs( value - ( i32 )palette[ p ] );
+					if ( distance < best_distance )
+					{
+						best_distance = distance;
+						best_index = p;
+					}
+				}
+				indices |= ( u64 )best_index << ( i * 3 );
+			}
+		}
+
+		output[ 0 ] = max_value;
+		output[ 1 ] = min_value;
+		for ( u32 b = 0; b < 6; ++b )
+		{
+			output[ 2 + b ] = ( u8 )( indices >> ( b * 8 ) );
+		}
+	}
+
+	// BC7 //////////////////////////////////////////////////////////////////
+
+	// Writes bits from the lowest block bit up, as the format lays them out.
+	struct BlockWriter
+	{
+		void								write( u32 value, u32 bit_count )
+		{
+			for ( u32 b = 0; b < bit_count; ++b, ++position )
+			{
+				output[ position >> 3 ] |= ( u8 )( ( ( value >> b ) & 1 ) << ( position & 7 ) );
+			}
+		}
+
+		u8*									output;
+		u32									position			= 0;
+
+	}; // struct BlockWriter
+
+	// Mode 6 only: one subset, 7 bit RGBA endpoints with a shared low bit each and 4 bit indices.
+	static void encode_bc7_block( const u8 block[ 16 ][ 4 ], u8* output )
+	{
+		f32 endpoints[ 2 ][ 4 ];
+		fit_endpoints( block, 4, endpoints[ 0 ], endpoints[ 1 ] );
+
+		// Quantize each endpoint with the low bit that fits it best.
+		u8 quantized[ 2 ][ 4 ];
+		u32 quantized_7[ 2 ][ 4 ];
+		u32 p_bits[ 2 ];
+		for ( u32 e = 0; e < 2; ++e )
+		{
+			u32 best_error = u32_max;
+			for ( u32 p = 0; p < 2; ++p )
+			{
+				u8 candidate[ 4 ];
+				u32 candidate_7[ 4 ];
+				u32 error = 0;
+				for ( u32 c = 0; c < 4; ++c )
+				{
+					const u8 value = clamp_to_u8( endpoints[ e ][ c ] );
+					i32 value_7 = ( ( i32 )value - ( i32 )p + 1 ) / 2;
+					value_7 = value_7 < 0 ? 0 : value_7 > 127 ? 127 : value_7;
+
+					candidate_7[ c ] = ( u32 )value_7;
+					candidate[ c ] = ( u8 )( ( value_7 << 1 ) | p );
+					error += ( candidate[ c ] - value ) * ( candidate[ c ] - value );
+				}
+
+				if ( error < best_error )
+				{
+					best_error = error;
+					p_bits[ e ] = p;
+					memcpy( quantized[ e ], candidate, 4 );
+					memcpy( quantized_7[ e ], candidate_7, sizeof( candidate_7 ) );
+				}
+			}
+		}
+
+		u8 palette[ 16 ][ 4 ];
+		for ( u32 i = 0; i < 16; ++i )
+		{
+			for ( u32 c = 0; c < 4; ++c )
+			{
+				palette[ i ][ c ] = ( u8 )( ( ( 64 - k_bc7_weights_4[ i ] ) * quantized[ 0 ][ c ] + k_bc7_weights_4[ i ] * quantized[ 1 ][ c ] + 32 ) >> 6 );
+			}
+		}
+
+		u32 indices[ 16 ];
+		for ( u32 i = 0; i < 16; ++i )
+		{
+			u32 best_index = 0, best_distance = u32_max;
+			for ( u32 p = 0; p < 16; ++p )
+			{
+				const u32 distance = squared_distance( block[ i ], palette[ p ], 4 );
+				if ( distance < best_distance )
+				{
+					best_distance = distance;
+					best_index = p;
+				}
+			}
+			indices[ i ] = best_index;
+		}
+
+		// The first index is stored without its top bit, swap the endpoints to keep it clear.
+		u32 first = 0;
+		if ( indices[ 0 ] & 8 )
+		{
+			first = 1;
+			for ( u32 i = 0; i < 16; ++i )
+			{
+				indices[ i ] = 15 - indices[ i ];
+			}
+		}
+		const u32 second = 1 - first;
+
+		memset( output, 0, 16 );
+		BlockWriter writer{ output };
+		writer.write( 1 << 6, 7 );
+		for ( u32 c = 0; c < 4; ++c )
+		{
+			writer.write( quantized_7[ first ][ c ], 7 );
+			writer.write( quantized_7[ second ][ c ], 7 );
+		}
+		writer.write( p_bits[ first ], 1 );
+		writer.write( p_bits[ second ], 1 );
+
+		writer.write( indices[ 0 ], 3 );
+		for ( u32 i = 1; i < 16; ++i )
+		{
+			writer.write( indices[ i ], 4 );
+		}
+	}
+
+	// Texture compression //////////////////////////////////////////////////
+
+	u32 mip_level_count( u32 width, u32 height )
+	{
+		u32 max_dimension = width > height ? width : height;
+		u32 levels = 1;
+		while ( max_dimension > 1 )
+		{
+			max_dimension >>= 1;
+			++levels;
+		}
+		return levels;
+	}
+
+	sizet compressed_level_size( VkFormat format, u32 width, u32 height )
+	{
+		const sizet block_size = format == VK_FORMAT_BC1_RGB_UNORM_BLOCK ? 8 : 16;
+		return ( ( width + 3 ) / 4 ) * ( ( height + 3 ) / 4 ) * block_size;
+	}
+
+	void compress_rgba8( VkFormat format, const u8* pixels, u32 width, u32 height, u8* output )
+	{
+		RASSERT( format == VK_FORMAT_BC1_RGB_UNORM_BLOCK || format == VK_FORMAT_BC5_UNORM_BLOCK || format == VK_FORMAT_BC7_UNORM_BLOCK );
+
+		const u32 blocks_x = ( width + 3 ) / 4;
+		const u32 blocks_y = ( height + 3 ) / 4;
+
+		u8 block[ 16 ][ 4 ];
+		for ( u32 block_y = 0; block_y < blocks_y; ++block_y )
+		{
+			for ( u32 block_x = 0; block_x < blocks_x; ++block_x )
+			{
+				load_block( pixels, width, height, block_x, block_y, block );
+
+				switch ( format )
+				{
+					case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+					{
+						encode_bc1_block( block, output );
+						output += 8;
+						break;
+					}
+					case VK_FORMAT_BC5_UNORM_BLOCK:
+					{
+						encode_bc4_block( block, 0, output );
+						encode_bc4_block( block, 1, output + 8 );
+						output += 16;
+						break;
+					}
+					default:
+					{
+						encode_bc7_block( block, output );
+						output += 16;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	void downsample_rgba8( const u8* pixels, u32 width, u32 height, u8* output )
+	{
+		const u32 output_width = width > 1 ? width / 2 : 1;
+		const u32 output_height = height > 1 ? height / 2 : 1;
+
+		for ( u32 y = 0; y < output_height; ++y )
+		{
+			// Odd sizes drop the last row or column, one pixel dimensions reuse it.
+			const u32 y0 = height > 1 ? y * 2 : 0;
+			const u32 y1 = height > 1 ? y * 2 + 1 : 0;
+			for ( u32 x = 0; x < output_width; ++x )
+			{
+				const u32 x0 = width > 1 ? x * 2 : 0;
+				const u32 x1 = width > 1 ? x * 2 + 1 : 0;
+				for ( u32 c = 0; c < 4; ++c )
+				{
+					const u32 sum = pixels[ ( y0 * width + x0 ) * 4 + c ] + pixels[ ( y0 * width + x1 ) * 4 + c ] +
+									pixels[ ( y1 * width + x0 ) * 4 + c ] + pixels[ ( y1 * width + x1 ) * 4 + c ];
+					output[ ( y * output_width + x ) * 4 + c ] = ( u8 )( ( sum + 2 ) / 4 );
+				}
+			}
+		}
+	}
+
+} // namespace Engine
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "foundation/platform.h"
+
+#include <vulkan/vulkan.h>
+
+namespace Engine
+{
+	// Texture compression //////////////////////////////////////////////////
+
+	//
+	// Offline CPU encoders for 4x4 block compressed formats, used when scene images are converted at import.
+	// Supported formats: VK_FORMAT_BC1_RGB_UNORM_BLOCK for opaque color, VK_FORMAT_BC5_UNORM_BLOCK for normal
+	// maps (X and Y only) and VK_FORMAT_BC7_UNORM_BLOCK for color with alpha. Functions do not allocate.
+	//
+
+	u32										mip_level_count( u32 width, u32 height );
+
+	// Bytes of a width x height level in format, edge blocks included.
+	sizet									compressed_level_size( VkFormat format, u32 width, u32 height );
+
+	// Encodes RGBA8 pixels. Blocks crossing the right or bottom edge repeat the last row and column.
+	void									compress_rgba8( VkFormat format, const u8* pixels, u32 width, u32 height, u8* output );
+
+	// Box filters RGBA8 pixels to the next mip level, max( width / 2, 1 ) x max( height / 2, 1 ).
+	void									downsample_rgba8( const u8* pixels, u32 width, u32 height, u8* output );
+
+} // namespace Engine
@@ -0,0 +1,617 @@
+#include "graphics/upload_manager.h"
+#include "graphics/gpu_device.h"
+
+#include "foundation/assert.h"
+#include "foundation/log.h"
+
+#include <string.h>
+
+namespace Engine
+{
+	#define					check( result ) RASSERTM( result == VK_SUCCESS, "Vulkan assert code %u", result )
+
+	// Stages and accesses that can consume uploaded data on the graphics queue.
+	static const VkPipelineStageFlags	k_buffer_consumer_stages = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	static const VkAccessFlags			k_buffer_consumer_access = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	static const VkPipelineStageFlags	k_image_consumer_stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+	static u64 align_up( u64 value, u64 alignment )
+	{
+		return ( value + alignment - 1 ) & ~( alignment - 1 );
+	}
+
+	// UploadManager //////////////////////////////////////////////////////////
+	void UploadManager::init( GpuDevice* gpu_, u32 staging_size_ )
+	{
+		gpu = gpu_;
+		staging_size = staging_size_;
+		dedicated_transfer_queue = gpu->vulkan_transfer_queue_family != gpu->vulkan_queue_family;
+
+		const u64 copy_alignment = gpu->vulkan_physical_properties.limits.optimalBufferCopyOffsetAlignment;
+		staging_alignment = copy_alignment > 16 ? ( u32 )copy_alignment : 16;
+
+		// Persistently mapped staging ring.
+		VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		buffer_info.size = staging_size;
+
+		VmaAllocationCreateInfo memory_info{};
+		memory_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+		memory_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+		VmaAllocationInfo allocation_info{};
+		check( vmaCreateBuffer( gpu->vma_allocator, &buffer_info, &memory_info, &staging_buffer, &staging_allocation, &allocation_info ) );
+		staging_mapped = ( u8* )allocation_info.pMappedData;
+
+		gpu->set_resource_name( VK_OBJECT_TYPE_BUFFER, ( u64 )staging_buffer, "Upload_Staging_Ring" );
+
+		// Copies are recorded on the transfer family, ownership acquires and transitions on the graphics one.
+		VkCommandPoolCreateInfo pool_info{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		pool_info.queueFamilyIndex = gpu->vulkan_transfer_queue_family;
+		check( vkCreateCommandPool( gpu->vulkan_device, &pool_info, gpu->vulkan_allocation_callbacks, &transfer_command_pool ) );
+
+		pool_info.queueFamilyIndex = gpu->vulkan_queue_family;
+		check( vkCreateCommandPool( gpu->vulkan_device, &pool_info, gpu->vulkan_allocation_callbacks, &graphics_command_pool ) );
+
+		for ( u32 i = 0; i < k_max_batches; ++i )
+		{
+			Batch& batch = batches[ i ];
+
+			VkCommandBufferAllocateInfo allocate_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocate_info.commandBufferCount = 1;
+
+			allocate_info.commandPool = transfer_command_pool;
+			check( vkAllocateCommandBuffers( gpu->vulkan_device, &allocate_info, &batch.transfer_command_buffer ) );
+
+			allocate_info.commandPool = graphics_command_pool;
+			check( vkAllocateCommandBuffers( gpu->vulkan_device, &allocate_info, &batch.graphics_command_buffer ) );
+
+			VkFenceCreateInfo fence_info{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+			check( vkCreateFence( gpu->vulkan_device, &fence_info, gpu->vulkan_allocation_callbacks, &batch.fence ) );
+
+			VkSemaphoreCreateInfo semaphore_info{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+			check( vkCreateSemaphore( gpu->vulkan_device, &semaphore_info, gpu->vulkan_allocation_callbacks, &batch.transfer_complete ) );
+		}
+
+		current_batch = 0;
+		num_in_flight = 0;
+		ring_head = ring_tail = 0;
+		next_handle = 1;
+		last_completed = 0;
+
+		rprint( "Upload Manager Init: %u KB staging, %s transfer queue\n", staging_size / 1024, dedicated_transfer_queue ? "dedicated" : "shared" );
+	}
+
+	void UploadManager::shutdown()
+	{
+		// The device is idle: retire everything that was submitted and drop what was never flushed.
+		while ( num_in_flight )
+		{
+			retire_oldest();
+		}
+
+		Batch& pending = batches[ current_batch ];
+		for ( u32 i = 0; i < pending.num_dedicated_buffers; ++i )
+		{
+			vmaDestroyBuffer( gpu->vma_allocator, pending.dedicated_buffers[ i ], pending.dedicated_allocations[ i ] );
+		}
+
+		for ( u32 i = 0; i < k_max_batches; ++i )
+		{
+			vkDestroyFence( gpu->vulkan_device, batches[ i ].fence, gpu->vulkan_allocation_callbacks );
+			vkDestroySemaphore( gpu->vulkan_device, batches[ i ].transfer_complete, gpu->vulkan_allocation_callbacks );
+		}
+
+		vkDestroyCommandPool( gpu->vulkan_device, transfer_command_pool, gpu->vulkan_allocation_callbacks );
+		vkDestroyCommandPool( gpu->vulkan_device, graphics_command_pool, gpu->vulkan_allocation_callbacks );
+
+		vmaDestroyBuffer( gpu->vma_allocator, staging_buffer, staging_allocation );
+		staging_mapped = nullptr;
+	}
+
+	UploadHandle UploadManager::upload_buffer( Buffer* buffer, u32 offset, const void* data, u32 size )
+	{
+		reserve_graphics_barrier( false );
+
+		VkBuffer source_buffer;
+		u32 source_offset;
+		u8* destination = allocate_staging( size, source_buffer, source_offset );
+		memcpy( destination, data, size );
+
+		Batch* batch = begin_batch();
+
+		VkBufferCopy region{ source_offset, offset, size };
+		vkCmdCopyBuffer( batch->transfer_command_buffer, source_buffer, buffer->vk_buffer, 1, &region );
+
+		VkBufferMemoryBarrier barrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		barrier.buffer = buffer->vk_buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		if ( dedicated_transfer_queue )
+		{
+			// Release on the transfer queue, the matching acquire is recorded at flush.
+			barrier.srcQueueFamilyIndex = gpu->vulkan_transfer_queue_family;
+			barrier.dstQueueFamilyIndex = gpu->vulkan_queue_family;
+			barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier( batch->transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = k_buffer_consumer_access;
+			batch->buffer_barriers[ batch->num_buffer_barriers++ ] = barrier;
+		}
+		else
+		{
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstAccessMask = k_buffer_consumer_access;
+			vkCmdPipelineBarrier( batch->transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, k_buffer_consumer_stages, 0, 0, nullptr, 1, &barrier, 0, nullptr );
+		}
+
+		return batch->handle;
+	}
+
+	// Fills levels 1 and up by successive linear blits of the level above. Every level starts in transfer destination
+	// layout, level 0 holding the uploaded data. The whole chain ends in shader read only layout.
+	static void record_mip_generation( VkCommandBuffer command_buffer, Texture* texture )
+	{
+		VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.image = texture->vk_image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		i32 width = texture->width;
+		i32 height = texture->height;
+		i32 depth = texture->depth;
+
+		for ( u32 mip = 1; mip < texture->mipmaps; ++mip )
+		{
+			barrier.subresourceRange.baseMipLevel = mip - 1;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			vkCmdPipelineBarrier( command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+
+			VkImageBlit blit{ };
+			blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - 1, 0, 1 };
+			blit.srcOffsets[ 1 ] = { width, height, depth };
+
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+			depth = depth > 1 ? depth / 2 : 1;
+
+			blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+			blit.dstOffsets[ 1 ] = { width, height, depth };
+
+			vkCmdBlitImage( command_buffer, texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR );
+		}
+
+		// Source levels are in transfer source layout, the last one is still a destination.
+		VkImageMemoryBarrier barriers[ 2 ] = { barrier, barrier };
+		barriers[ 0 ].subresourceRange.baseMipLevel = 0;
+		barriers[ 0 ].subresourceRange.levelCount = texture->mipmaps - 1;
+		barriers[ 0 ].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barriers[ 0 ].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[ 0 ].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barriers[ 0 ].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		barriers[ 1 ].subresourceRange.baseMipLevel = texture->mipmaps - 1;
+		barriers[ 1 ].subresourceRange.levelCount = 1;
+		barriers[ 1 ].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barriers[ 1 ].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barriers[ 1 ].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barriers[ 1 ].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier( command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, k_image_consumer_stages, 0, 0, nullptr, 0, nullptr, 2, barriers );
+	}
+
+	UploadHandle UploadManager::upload_texture( Texture* texture, const void* data, u32 size )
+	{
+		reserve_graphics_barrier( true );
+
+		VkBuffer source_buffer;
+		u32 source_offset;
+		u8* destination = allocate_staging( size, source_buffer, source_offset );
+		memcpy( destination, data, size );
+
+		Batch* batch = begin_batch();
+
+		const bool generate_mips = texture->mipmaps > 1 && ( texture->flags & TextureFlags::GenerateMips_mask ) == TextureFlags::GenerateMips_mask;
+
+		VkImageMemoryBarrier barrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+		barrier.image = texture->vk_image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = texture->mipmaps;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		vkCmdPipelineBarrier( batch->transfer_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+
+		// Without generation every level is in the data, packed largest first.
+		VkBufferImageCopy regions[ 16 ];
+		const u32 num_regions = generate_mips ? 1 : texture->mipmaps;
+		RASSERT( num_regions <= ArraySize( regions ) );
+
+		u32 level_offset = source_offset;
+		for ( u32 level = 0; level < num_regions; ++level )
+		{
+			const u32 width = texture->width >> level ? texture->width >> level : 1;
+			const u32 height = texture->height >> level ? texture->height >> level : 1;
+			const u32 depth = texture->depth >> level ? texture->depth >> level : 1;
+
+			VkBufferImageCopy& region = regions[ level ];
+			region = {};
+			region.bufferOffset = level_offset;
+			region.bufferRowLength = 0;
+			region.bufferImageHeight = 0;
+
+			region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			region.imageSubresource.mipLevel = level;
+			region.imageSubresource.baseArrayLayer = 0;
+			region.imageSubresource.layerCount = 1;
+
+			region.imageOffset = { 0, 0, 0 };
+			region.imageExtent = { width, height, depth };
+
+			level_offset += TextureFormat::level_size( texture->vk_format, width, height, depth );
+		}
+
+		vkCmdCopyBufferToImage( batch->transfer_command_buffer, source_buffer, texture->vk_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, num_regions, regions );
+
+		if ( generate_mips )
+		{
+			// Blits need a graphics queue. On a shared family they follow the copy, otherwise the graphics
+			// command buffer of this batch acquires the image and generates the chain, still in the same batch.
+			if ( dedicated_transfer_queue )
+			{
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.srcQueueFamilyIndex = gpu->vulkan_transfer_queue_family;
+				barrier.dstQueueFamilyIndex = gpu->vulkan_queue_family;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = 0;
+				vkCmdPipelineBarrier( batch->transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+
+				VkCommandBuffer graphics_command_buffer = get_graphics_command_buffer();
+
+				barrier.srcAccessMask = 0;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+				vkCmdPipelineBarrier( graphics_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+
+				record_mip_generation( graphics_command_buffer, texture );
+			}
+			else
+			{
+				record_mip_generation( batch->transfer_command_buffer, texture );
+			}
+
+			texture->vk_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+			return batch->handle;
+		}
+
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		if ( dedicated_transfer_queue )
+		{
+			// Release with the layout change, the graphics queue acquires the same transition.
+			barrier.srcQueueFamilyIndex = gpu->vulkan_transfer_queue_family;
+			barrier.dstQueueFamilyIndex = gpu->vulkan_queue_family;
+			barrier.dstAccessMask = 0;
+			vkCmdPipelineBarrier( batch->transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			batch->image_barriers[ batch->num_image_barriers++ ] = barrier;
+		}
+		else
+		{
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			vkCmdPipelineBarrier( batch->transfer_command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, k_image_consumer_stages, 0, 0, nullptr, 0, nullptr, 1, &barrier );
+		}
+
+		// Layout as seen by any work submitted after this batch.
+		texture->vk_image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		return batch->handle;
+	}
+
+	VkCommandBuffer UploadManager::get_graphics_command_buffer()
+	{
+		Batch& batch = batches[ current_batch ];
+		if ( batch.handle == 0 )
+		{
+			batch.handle = next_handle++;
+		}
+
+		if ( !batch.graphics_recording )
+		{
+			VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer( batch.graphics_command_buffer, &begin_info );
+
+			batch.graphics_recording = true;
+		}
+
+		return batch.graphics_command_buffer;
+	}
+
+	UploadHandle UploadManager::flush()
+	{
+		Batch& batch = batches[ current_batch ];
+		if ( batch.handle == 0 )
+		{
+			// Nothing recorded: the last submitted batch is the one to wait for.
+			return next_handle - 1;
+		}
+
+		if ( batch.num_image_barriers || batch.num_buffer_barriers )
+		{
+			VkCommandBuffer graphics_command_buffer = get_graphics_command_buffer();
+			vkCmdPipelineBarrier( graphics_command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, k_buffer_consumer_stages | k_image_consumer_stages, 0, 0, nullptr,
+								  batch.num_buffer_barriers, batch.buffer_barriers, batch.num_image_barriers, batch.image_barriers );
+		}
+
+		if ( batch.transfer_recording )
+		{
+			vkEndCommandBuffer( batch.transfer_command_buffer );
+		}
+		if ( batch.graphics_recording )
+		{
+			vkEndCommandBuffer( batch.graphics_command_buffer );
+		}
+
+		if ( dedicated_transfer_queue )
+		{
+			const bool signal = batch.transfer_recording && batch.graphics_recording;
+
+			if ( batch.transfer_recording )
+			{
+				VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+				submit_info.commandBufferCount = 1;
+				submit_info.pCommandBuffers = &batch.transfer_command_buffer;
+				submit_info.signalSemaphoreCount = signal ? 1 : 0;
+				submit_info.pSignalSemaphores = &batch.transfer_complete;
+
+				check( vkQueueSubmit( gpu->vulkan_transfer_queue, 1, &submit_info, batch.graphics_recording ? VK_NULL_HANDLE : batch.fence ) );
+			}
+
+			if ( batch.graphics_recording )
+			{
+				const VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+				VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+				submit_info.waitSemaphoreCount = signal ? 1 : 0;
+				submit_info.pWaitSemaphores = &batch.transfer_complete;
+				submit_info.pWaitDstStageMask = &wait_stage;
+				submit_info.commandBufferCount = 1;
+				submit_info.pCommandBuffers = &batch.graphics_command_buffer;
+
+				check( vkQueueSubmit( gpu->vulkan_queue, 1, &submit_info, batch.fence ) );
+			}
+		}
+		else
+		{
+			// Same family: copies and transitions go in one submission, in recording order.
+			VkCommandBuffer command_buffers[ 2 ];
+			u32 num_command_buffers = 0;
+			if ( batch.transfer_recording )
+			{
+				command_buffers[ num_command_buffers++ ] = batch.transfer_command_buffer;
+			}
+			if ( batch.graphics_recording )
+			{
+				command_buffers[ num_command_buffers++ ] = batch.graphics_command_buffer;
+			}
+
+			VkSubmitInfo submit_info{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit_info.commandBufferCount = num_command_buffers;
+			submit_info.pCommandBuffers = command_buffers;
+
+			check( vkQueueSubmit( gpu->vulkan_queue, 1, &submit_info, batch.fence ) );
+		}
+
+		const UploadHandle submitted = batch.handle;
+
+		batch.ring_end = ring_head;
+		batch.transfer_recording = false;
+		batch.graphics_recording = false;
+
+		++num_in_flight;
+		current_batch = ( current_batch + 1 ) % k_max_batches;
+
+		// Keep the next batch free for recording.
+		if ( num_in_flight == k_max_batches )
+		{
+			retire_oldest();
+		}
+
+		return submitted;
+	}
+
+	void UploadManager::update()
+	{
+		while ( num_in_flight )
+		{
+			const Batch& oldest = batches[ ( current_batch + k_max_batches - num_in_flight ) % k_max_batches ];
+			if ( vkGetFenceStatus( gpu->vulkan_device, oldest.fence ) != VK_SUCCESS )
+			{
+				break;
+			}
+
+			retire_oldest();
+		}
+	}
+
+	bool UploadManager::is_complete( UploadHandle upload )
+	{
+		if ( upload <= last_completed )
+		{
+			return true;
+		}
+
+		update();
+
+		return upload <= last_completed;
+	}
+
+	void UploadManager::wait( UploadHandle upload )
+	{
+		if ( upload == batches[ current_batch ].handle )
+		{
+			flush();
+		}
+
+		while ( upload > last_completed && num_in_flight )
+		{
+			retire_oldest();
+		}
+	}
+
+	UploadManager::Batch* UploadManager::begin_batch()
+	{
+		Batch* batch = &batches[ current_batch ];
+		if ( batch->handle == 0 )
+		{
+			batch->handle = next_handle++;
+		}
+
+		if ( !batch->transfer_recording )
+		{
+			VkCommandBufferBeginInfo begin_info{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer( batch->transfer_command_buffer, &begin_info );
+
+			batch->transfer_recording = true;
+		}
+
+		return batch;
+	}
+
+	void UploadManager::reserve_graphics_barrier( bool image )
+	{
+		if ( !dedicated_transfer_queue )
+		{
+			return;
+		}
+
+		// Must happen before staging is allocated: a flush hands the ring memory to the submitted batch.
+		const Batch& batch = batches[ current_batch ];
+		const u32 used = image ? batch.num_image_barriers : batch.num_buffer_barriers;
+		if ( used == k_max_graphics_barriers )
+		{
+			flush();
+		}
+	}
+
+	u8* UploadManager::allocate_staging( u32 size, VkBuffer& out_buffer, u32& out_offset )
+	{
+		if ( size > staging_size )
+		{
+			// Does not fit the ring at all: use a temporary buffer owned by the batch.
+			Batch* batch = begin_batch();
+			if ( batch->num_dedicated_buffers == k_max_dedicated_buffers )
+			{
+				flush();
+				batch = begin_batch();
+			}
+
+			VkBufferCreateInfo buffer_info{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+			buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			buffer_info.size = size;
+
+			VmaAllocationCreateInfo memory_info{};
+			memory_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+			memory_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+			const u32 index = batch->num_dedicated_buffers++;
+			VmaAllocationInfo allocation_info{};
+			check( vmaCreateBuffer( gpu->vma_allocator, &buffer_info, &memory_info, &batch->dedicated_buffers[ index ], &batch->dedicated_allocations[ index ], &allocation_info ) );
+
+			out_buffer = batch->dedicated_buffers[ index ];
+			out_offset = 0;
+			return ( u8* )allocation_info.pMappedData;
+		}
+
+		u64 offset;
+		for ( ;; )
+		{
+			offset = align_up( ring_head, staging_alignment );
+
+			// Allocations never straddle the end of the ring.
+			const u64 physical_offset = offset % staging_size;
+			if ( physical_offset + size > staging_size )
+			{
+				offset += staging_size - physical_offset;
+			}
+
+			if ( offset + size - ring_tail <= staging_size )
+			{
+				break;
+			}
+
+			// Ring is full: reclaim from the oldest submission, submitting the current batch if it holds the memory.
+			if ( num_in_flight == 0 )
+			{
+				if ( ring_tail == ring_head )
+				{
+					ring_head = ring_tail = 0;
+					continue;
+				}
+
+				flush();
+			}
+
+			retire_oldest();
+		}
+
+		ring_head = offset + size;
+
+		out_buffer = staging_buffer;
+		out_offset = ( u32 )( offset % staging_size );
+		return staging_mapped + out_offset;
+	}
+
+	void UploadManager::retire_oldest()
+	{
+		RASSERT( num_in_flight > 0 );
+
+		Batch& batch = batches[ ( current_batch + k_max_batches - num_in_flight ) % k_max_batches ];
+
+		vkWaitForFences( gpu->vulkan_device, 1, &batch.fence, VK_TRUE, UINT64_MAX );
+		vkResetFences( gpu->vulkan_device, 1, &batch.fence );
+
+		for ( u32 i = 0; i < batch.num_dedicated_buffers; ++i )
+		{
+			vmaDestroyBuffer( gpu->vma_allocator, batch.dedicated_buffers[ i ], batch.dedicated_allocations[ i ] );
+		}
+
+		ring_tail = batch.ring_end;
+		last_completed = batch.handle;
+
+		batch.num_dedicated_buffers = 0;
+		batch.num_image_barriers = 0;
+		batch.num_buffer_barriers = 0;
+		batch.handle = 0;
+
+		--num_in_flight;
+	}
+
+} // namespace Engine
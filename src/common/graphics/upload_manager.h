@@ -0,0 +1,103 @@
+#pragma once
+
+#include "graphics/gpu_resource.h"
+
+namespace Engine
+{
+	struct GpuDevice;
+
+	// UploadManager //////////////////////////////////////////////////////////
+
+	//
+	// Copies data to GPU resources through a persistently mapped staging ring.
+	// Copies are recorded into the current batch and submitted together on flush,
+	// on the dedicated transfer queue when the device exposes one. Completion is
+	// tracked per batch with a fence that can be polled, nothing waits for the queue to idle.
+	//
+	struct UploadManager
+	{
+		void								init( GpuDevice* gpu, u32 staging_size );
+		void								shutdown();
+
+		// Copy size bytes into the buffer at offset. The buffer needs VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+		UploadHandle						upload_buffer( Buffer* buffer, u32 offset, const void* data, u32 size );
+		// Copy the texture levels and leave them in shader read only layout. Data holds every level, largest first,
+		// unless the texture has TextureFlags::GenerateMips: then it holds level 0 and the others are blitted from it in the same batch.
+		UploadHandle						upload_texture( Texture* texture, const void* data, u32 size );
+
+		// Returns a command buffer executed on the graphics queue after this batch's copies.
+		// Used for layout transitions that would otherwise need their own submission.
+		VkCommandBuffer						get_graphics_command_buffer();
+
+		// Submit the current batch, if any work was recorded. Returns the handle of the submitted batch.
+		UploadHandle						flush();
+		// Retire completed batches and release their staging memory. Never blocks.
+		void								update();
+
+		bool								is_complete( UploadHandle upload );
+		void								wait( UploadHandle upload );
+
+		static const u32					k_max_batches				= 4;
+		static const u32					k_max_dedicated_buffers		= 8;
+		static const u32					k_max_graphics_barriers		= 64;
+
+		//
+		//
+		struct Batch
+		{
+			VkCommandBuffer					transfer_command_buffer		= VK_NULL_HANDLE;
+			VkCommandBuffer					graphics_command_buffer		= VK_NULL_HANDLE;
+			VkFence							fence						= VK_NULL_HANDLE;
+			VkSemaphore						transfer_complete			= VK_NULL_HANDLE;
+
+			// Uploads bigger than the whole ring get their own staging buffer, freed with the batch.
+			VkBuffer						dedicated_buffers[ k_max_dedicated_buffers ];
+			VmaAllocation					dedicated_allocations[ k_max_dedicated_buffers ];
+			u32								num_dedicated_buffers		= 0;
+
+			// Queue family ownership acquires, replayed on the graphics queue.
+			VkImageMemoryBarrier			image_barriers[ k_max_graphics_barriers ];
+			VkBufferMemoryBarrier			buffer_barriers[ k_max_graphics_barriers ];
+			u32								num_image_barriers			= 0;
+			u32								num_buffer_barriers			= 0;
+
+			u64								ring_end					= 0;
+			UploadHandle					handle						= 0;
+
+			bool							transfer_recording			= false;
+			bool							graphics_recording			= false;
+
+		}; // struct Batch
+
+		Batch*								begin_batch();
+		void								reserve_graphics_barrier( bool image );
+		u8*									allocate_staging( u32 size, VkBuffer& out_buffer, u32& out_offset );
+		void								retire_oldest();
+
+		GpuDevice*							gpu							= nullptr;
+
+		VkCommandPool						transfer_command_pool		= VK_NULL_HANDLE;
+		VkCommandPool						graphics_command_pool		= VK_NULL_HANDLE;
+
+		Batch								batches[ k_max_batches ];
+		u32									current_batch				= 0;		// Batch being recorded.
+		u32									num_in_flight				= 0;		// Submitted batches preceding current_batch.
+
+		VkBuffer							staging_buffer				= VK_NULL_HANDLE;
+		VmaAllocation						staging_allocation			= nullptr;
+		u8*									staging_mapped				= nullptr;
+		u32									staging_size				= 0;
+		u32									staging_alignment			= 16;
+
+		// Virtual ring offsets, the physical offset is modulo staging_size.
+		u64									ring_head					= 0;
+		u64									ring_tail					= 0;
+
+		UploadHandle						next_handle					= 1;
+		UploadHandle						last_completed				= 0;
+
+		bool								dedicated_transfer_queue	= false;
+
+	}; // struct UploadManager
+
+} // namespace Engine
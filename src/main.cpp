@@ -6,8 +6,14 @@
 #include "graphics/gpu_device.h"
 #include "graphics/command_buffer.h"
 #include "graphics/renderer.h"
+#include "graphics/culling.h"
+#include "graphics/geometry_arena.h"
+#include "graphics/mesh_optimizer.h"
+#include "graphics/scene_cache.h"
 #include "graphics/engine_imgui.h"
 #include "graphics/gpu_profiler.h"
+#include "graphics/ktx2.h"
+#include "graphics/texture_compression.h"
 
 #include "cglm/struct/mat3.h"
 #include "cglm/struct/mat4.h"
@@ -21,12 +27,16 @@
 
 #include "foundation/file.h"
 #include "foundation/gltf.h"
+#include "foundation/hash_map.h"
 #include "foundation/numerics.h"
 #include "foundation/resource_manager.h"
+#include "foundation/task_scheduler.h"
 #include "foundation/time.h"
 
 #include <stdlib.h> // for exit()
 
+#include <stb_image.h>
+
 ///////////////////////////////////////
 
 // Rotating cube test
@@ -61,33 +71,39 @@ struct alignas(16) MaterialData {
     f32   roughness_factor;
     f32   occlusion_factor;
     u32   flags;
+
+    // Indices in the bindless texture array.
+    u32   diffuse_texture;
+    u32   roughness_texture;
+    u32   occlusion_texture;
+    u32   emissive_texture;
+    u32   normal_texture;
 };
 
 struct MeshDraw {
-    Engine::BufferHandle index_buffer;
-    Engine::BufferHandle position_buffer;
-    Engine::BufferHandle tangent_buffer;
-    Engine::BufferHandle normal_buffer;
-    Engine::BufferHandle texcoord_buffer;
-
-    Engine::BufferHandle material_buffer;
-    MaterialData         material_data;
-
-    u32 index_offset;
-    u32 position_offset;
-    u32 tangent_offset;
-    u32 normal_offset;
-    u32 texcoord_offset;
+    MaterialData         material_data;     // Copied to the object buffer at the mesh draw index.
+    bool                 transform_dirty;   // model_inv is recomputed on the next object upload.
 
+    // Geometry arena range, first_index is in the arena index buffer of index_type.
+    u32 first_index;
+    u32 vertex_offset;
     u32 count;
-
     VkIndexType index_type;
 
+    u32 material_index;     // glTF material, draws sharing it and the arena range are instanced together.
+
+    // Object space bounding sphere and box half extents around the same center.
+    vec3s bounding_center;
+    f32   bounding_radius;
+    vec3s bounding_extent;
+
     Engine::DescriptorSetHandle descriptor_set;
+    Engine::TextureResource*    textures[Engine::SceneCacheTextureSlot_Count];  // nullptr for the dummy texture.
 };
 
 struct UniformData {
     mat4s m;
+    mat4s m_inv;
     mat4s vp;
     vec4s eye;
     vec4s light;
@@ -99,47 +115,843 @@ struct Transform {
     versors                 rotation;
     vec3s                   translation;
 
-    void                    reset();
-    mat4s                   calculate_matrix() const {
-        const mat4s translation_matrix = glms_translate_make(translation);
-        const mat4s scale_matrix = glms_scale_make(scale);
-        const mat4s local_matrix = glms_mat4_mul(glms_mat4_mul(translation_matrix, glms_quat_mat4(rotation)), scale_matrix);
-        return local_matrix;
-    }
-}; // struct Transform
+    void                    reset();
+    mat4s                   calculate_matrix() const {
+        const mat4s translation_matrix = glms_translate_make(translation);
+        const mat4s scale_matrix = glms_scale_make(scale);
+        const mat4s local_matrix = glms_mat4_mul(glms_mat4_mul(translation_matrix, glms_quat_mat4(rotation)), scale_matrix);
+        return local_matrix;
+    }
+}; // struct Transform
+
+static void input_os_messages_callback(void* os_event, void* user_data) {
+    Engine::InputService* input = (Engine::InputService*)user_data;
+    input->on_event(os_event);
+}
+
+// Scene wide storage buffer of MaterialData, shaders index it with the instance index.
+// Only the range of objects changed since the last upload is copied.
+struct ObjectBuffer {
+    Engine::BufferHandle    buffer;
+    u32                     capacity;
+
+    u32                     dirty_begin = u32_max;
+    u32                     dirty_end = 0;
+
+    void                    mark_dirty(u32 index) {
+        dirty_begin = Engine::min(dirty_begin, index);
+        dirty_end = Engine::max(dirty_end, index + 1);
+    }
+}; // struct ObjectBuffer
+
+// Stages the dirty range in the per frame dynamic buffer and copies it, must be recorded outside of render passes.
+// Ranges larger than what is left of the frame slice, like the first upload of big scenes, go through the upload manager.
+static void upload_dirty_objects(Engine::GpuDevice& gpu, Engine::CommandBuffer* gpu_commands, Engine::Allocator* allocator, ObjectBuffer& objects,
+                                 Engine::Array<MeshDraw>& mesh_draws) {
+    if (objects.dirty_begin >= objects.dirty_end) {
+        return;
+    }
+
+    const u32 count = objects.dirty_end - objects.dirty_begin;
+    const u32 size = count * sizeof(MaterialData);
+
+    // Counts what the frame already allocated from its slice of the dynamic buffer.
+    const u32 frame_used_size = gpu.dynamic_allocated_size - gpu.dynamic_per_frame_size * gpu.current_frame;
+    const bool use_dynamic_buffer = frame_used_size + size <= gpu.dynamic_per_frame_size;
+
+    u32 staging_offset = 0;
+    MaterialData* staging;
+    if (use_dynamic_buffer) {
+        staging_offset = gpu.dynamic_allocated_size;
+        staging = (MaterialData*)gpu.dynamic_allocate(size);
+    }
+    else {
+        staging = (MaterialData*)ralloca(size, allocator);
+    }
+
+    for (u32 i = 0; i < count; ++i) {
+        MeshDraw& mesh_draw = mesh_draws[objects.dirty_begin + i];
+        // Normal matrix, the global model part is applied in the shader.
+        if (mesh_draw.transform_dirty) {
+            mesh_draw.material_data.model_inv = glms_mat4_inv(glms_mat4_transpose(mesh_draw.material_data.model));
+            mesh_draw.transform_dirty = false;
+        }
+
+        staging[i] = mesh_draw.material_data;
+    }
+
+    if (use_dynamic_buffer) {
+        gpu.flush_buffer(gpu.dynamic_buffer, staging_offset, size);
+        gpu_commands->copy_buffer(gpu.dynamic_buffer, staging_offset, objects.buffer, objects.dirty_begin * sizeof(MaterialData), size);
+    }
+    else {
+        // Submitted at present ahead of the frame commands.
+        gpu.upload_manager.upload_buffer(gpu.access_buffer(objects.buffer), objects.dirty_begin * sizeof(MaterialData), staging, size);
+        rfree(staging, allocator);
+    }
+
+    objects.dirty_begin = u32_max;
+    objects.dirty_end = 0;
+}
+
+// Streaming recreates textures with new handles, the material texture indices follow them.
+static void update_streamed_texture_indices(ObjectBuffer& objects, Engine::Array<MeshDraw>& mesh_draws) {
+    for (u32 i = 0; i < mesh_draws.size; ++i) {
+        MeshDraw& mesh_draw = mesh_draws[i];
+        u32* texture_indices = &mesh_draw.material_data.diffuse_texture;
+        for (u32 slot = 0; slot < Engine::SceneCacheTextureSlot_Count; ++slot) {
+            const Engine::TextureResource* texture = mesh_draw.textures[slot];
+            if (texture && texture_indices[slot] != texture->handle.index) {
+                texture_indices[slot] = texture->handle.index;
+                objects.mark_dirty(i);
+            }
+        }
+    }
+}
+
+// Bindless devices sample the texture from the global array by index, with the sampler linked to the texture.
+// Otherwise the texture is bound to the material descriptor set.
+static void set_material_texture(Engine::GpuDevice& gpu, Engine::DescriptorSetCreation& ds_creation, Engine::TextureHandle texture,
+                                 Engine::SamplerHandle sampler, u16 binding, u32& out_texture_index) {
+    if (gpu.bindless_supported) {
+        gpu.link_texture_sampler(texture, sampler);
+    }
+    else {
+        ds_creation.texture_sampler(texture, sampler, binding);
+    }
+
+    out_texture_index = texture.index;
+}
+
+// Identity of a draw for instancing, hashed as raw bytes: keep it zero initialized.
+struct InstanceKey {
+    u32 first_index;
+    u32 index_count;
+    u32 vertex_offset;
+    u32 material_index;
+    u32 index_type;
+};
+
+// Mesh draws with the same InstanceKey, their indices are stored contiguously in the members array.
+struct InstanceGroup {
+    u32 first_member;
+    u32 count;
+};
+
+static const u32 k_max_record_tasks = 32;
+static const f32 k_far_plane = 1000.0f;
+static const f32 k_vertical_fov = 60.0f;
+// Default for the optional second argument, in megabytes. Zero keeps every texture fully resident.
+static const u32 k_texture_memory_budget = 512;
+
+struct MeshDrawRecordContext {
+    Engine::GpuDevice*          gpu;
+    const Engine::RenderQueue*  render_queue;
+    Engine::RenderPass*         render_pass;
+    u32                         draws_per_task;
+
+    Engine::CommandBuffer*  command_buffers[k_max_record_tasks];
+};
+
+static void record_mesh_draws(u32 start, u32 end, u32 thread_index, void* user_data) {
+    using namespace Engine;
+
+    MeshDrawRecordContext* context = (MeshDrawRecordContext*)user_data;
+
+    // Each task records a secondary buffer from its own thread pool, state is not inherited from the primary.
+    CommandBuffer* gpu_commands = context->gpu->get_secondary_command_buffer(thread_index);
+    gpu_commands->begin_secondary(context->render_pass);
+    gpu_commands->set_scissor(nullptr);
+    gpu_commands->set_viewport(nullptr);
+
+    // Tasks get consecutive ranges of the sorted queue.
+    context->render_queue->record(gpu_commands, start, end - start);
+
+    gpu_commands->end();
+
+    // Store by task index so the primary executes them in draw order.
+    context->command_buffers[start / context->draws_per_task] = gpu_commands;
+}
+
+static u8* get_buffer_data(Engine::glTF::BufferView* buffer_views, u32 buffer_index, Engine::Array<void*>& buffers_data, u32* buffer_size = nullptr, char** buffer_name = nullptr) {
+    using namespace Engine;
+
+    glTF::BufferView& buffer = buffer_views[buffer_index];
+
+    i32 offset = buffer.byte_offset;
+    if (offset == glTF::INVALID_INT_VALUE) {
+        offset = 0;
+    }
+
+    if (buffer_name != nullptr) {
+        *buffer_name = buffer.name.data;
+    }
+
+    if (buffer_size != nullptr) {
+        *buffer_size = buffer.byte_length;
+    }
+
+    u8* data = (u8*)buffers_data[buffer.buffer] + offset;
+
+    return data;
+}
+
+// Vertex streams of the geometry arena, in pipeline binding order.
+enum GeometryStream {
+    GeometryStream_Position,
+    GeometryStream_Tangent,
+    GeometryStream_Normal,
+    GeometryStream_Texcoord,
+    GeometryStream_Count
+};
+
+// Packed at import: octahedral normal as Short2N, octahedral tangent and bitangent sign as Short4N, texcoord as Half2.
+// Positions stay Float3, quantizing them would need a per mesh dequantization scale in the object data.
+static const u32 k_geometry_stream_strides[GeometryStream_Count] = { sizeof(vec3s), sizeof(i16) * 4, sizeof(i16) * 2, sizeof(u16) * 2 };
+
+// Arena range and vertex data properties of a glTF mesh primitive, shared by all nodes using the mesh.
+struct PrimitiveGeometry {
+    u32         first_index;
+    u32         vertex_offset;
+    u32         index_count;    // 0 when the primitive could not be imported.
+    VkIndexType index_type;     // UINT16 when the primitive has at most 65536 vertices.
+    u32         flags;          // Vertex attribute MaterialFeatures.
+
+    vec3s bounds_min;
+    vec3s bounds_max;
+};
+
+// Copies accessor elements to destination, honouring the buffer view stride. Element i is written at remap[i] when remap is set.
+static void copy_accessor_data(Engine::glTF::glTF& scene, Engine::Array<void*>& buffers_data, const Engine::glTF::Accessor& accessor,
+                               u32 element_size, u8* destination, u32 destination_stride, const u32* remap = nullptr) {
+    using namespace Engine;
+
+    const glTF::BufferView& buffer_view = scene.buffer_views[accessor.buffer_view];
+    const u8* source = get_buffer_data(scene.buffer_views, accessor.buffer_view, buffers_data);
+    source += accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : accessor.byte_offset;
+
+    const u32 source_stride = (buffer_view.byte_stride == glTF::INVALID_INT_VALUE || buffer_view.byte_stride == 0) ? element_size : buffer_view.byte_stride;
+    for (i32 element = 0; element < accessor.count; ++element) {
+        const u32 destination_element = remap ? remap[element] : element;
+        memcpy(destination + destination_element * destination_stride, source + element * source_stride, element_size);
+    }
+}
+
+// Indices of a primitive read ahead of its import, so every primitive can be optimized in parallel.
+struct PrimitiveIndices {
+    Engine::Array<u32> indices;     // Widened to 32 bits, rewritten by the optimization.
+    Engine::Array<u32> remap;       // remap[glTF vertex] = arena vertex.
+    Engine::Array<u8>  scratch;     // Preallocated, the allocator is not shared across threads.
+
+    u32 vertex_count;
+    f32 acmr_before;
+    f32 acmr_after;
+};
+
+static void read_primitive_indices(Engine::glTF::glTF& scene, Engine::Array<void*>& buffers_data, Engine::glTF::MeshPrimitive& mesh_primitive,
+                                   Engine::Allocator* allocator, PrimitiveIndices& primitive_indices) {
+    using namespace Engine;
+
+    i32 position_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "POSITION");
+    const u32 vertex_count = position_accessor_index != -1 ? scene.accessors[position_accessor_index].count : 0;
+
+    glTF::Accessor& indices_accessor = scene.accessors[mesh_primitive.indices];
+    RASSERT(indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT || indices_accessor.component_type == glTF::Accessor::UNSIGNED_SHORT);
+    RASSERT((indices_accessor.count % 3) == 0);
+
+    const u32 index_count = indices_accessor.count;
+
+    primitive_indices.vertex_count = vertex_count;
+    primitive_indices.indices.init(allocator, index_count, index_count);
+    primitive_indices.remap.init(allocator, vertex_count, vertex_count);
+    primitive_indices.scratch.init(allocator, (u32)mesh_optimizer_scratch_size(index_count, vertex_count), (u32)mesh_optimizer_scratch_size(index_count, vertex_count));
+
+    if (indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT) {
+        copy_accessor_data(scene, buffers_data, indices_accessor, sizeof(u32), (u8*)primitive_indices.indices.data, sizeof(u32));
+    }
+    else {
+        const u16* index_data_16 = (const u16*)(get_buffer_data(scene.buffer_views, indices_accessor.buffer_view, buffers_data) +
+            (indices_accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : indices_accessor.byte_offset));
+        for (u32 index = 0; index < index_count; ++index) {
+            primitive_indices.indices[index] = index_data_16[index];
+        }
+    }
+}
+
+// Reorders triangles for the post transform cache, then vertices in order of first use.
+static void optimize_primitive_indices(u32 start, u32 end, u32 thread_index, void* user_data) {
+    using namespace Engine;
+
+    PrimitiveIndices* primitives = (PrimitiveIndices*)user_data;
+    for (u32 p = start; p < end; ++p) {
+        PrimitiveIndices& primitive = primitives[p];
+        // Primitives without positions are skipped at import.
+        if (primitive.vertex_count == 0) {
+            continue;
+        }
+
+        u32* indices = primitive.indices.data;
+        const u32 index_count = primitive.indices.size;
+
+        primitive.acmr_before = compute_acmr(indices, index_count, primitive.vertex_count, k_vertex_cache_size, primitive.scratch.data);
+        optimize_vertex_cache(indices, index_count, primitive.vertex_count, primitive.scratch.data);
+        optimize_vertex_fetch(indices, index_count, primitive.vertex_count, primitive.remap.data);
+        primitive.acmr_after = compute_acmr(indices, index_count, primitive.vertex_count, k_vertex_cache_size, primitive.scratch.data);
+    }
+}
+
+// Reads the primitive in float, then packs optimized indices and remapped vertex streams in the arena. Missing normals are computed.
+static void import_primitive(Engine::glTF::glTF& scene, Engine::Array<void*>& buffers_data, Engine::glTF::MeshPrimitive& mesh_primitive,
+                             const PrimitiveIndices& primitive_indices, Engine::Allocator* allocator, Engine::GeometryArena& arena, PrimitiveGeometry& geometry) {
+    using namespace Engine;
+
+    geometry = { };
+
+    i32 position_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "POSITION");
+    i32 tangent_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "TANGENT");
+    i32 normal_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "NORMAL");
+    i32 texcoord_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "TEXCOORD_0");
+
+    if (position_accessor_index == -1) {
+        RASSERTM(false, "No position data found!");
+        return;
+    }
+
+    glTF::Accessor& position_accessor = scene.accessors[position_accessor_index];
+    const u32 vertex_count = position_accessor.count;
+    geometry.vertex_offset = arena.allocate_vertices(vertex_count);
+
+    // Vertex attributes are written in the order chosen by the optimizer.
+    const u32* remap = primitive_indices.remap.data;
+    const Array<u32>& indices = primitive_indices.indices;
+
+    vec3s* position_data = (vec3s*)arena.get_vertex_data(GeometryStream_Position, geometry.vertex_offset);
+    copy_accessor_data(scene, buffers_data, position_accessor, sizeof(vec3s), (u8*)position_data, sizeof(vec3s), remap);
+
+    geometry.index_count = indices.size;
+
+    // Indices are relative to the vertex offset, so they fit 16 bits whenever the primitive itself does.
+    geometry.index_type = vertex_count <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    geometry.first_index = arena.allocate_indices(geometry.index_count, geometry.index_type);
+    if (geometry.index_type == VK_INDEX_TYPE_UINT16) {
+        u16* index_data = arena.get_index_data_16(geometry.first_index);
+        for (u32 index = 0; index < geometry.index_count; ++index) {
+            index_data[index] = (u16)indices[index];
+        }
+    }
+    else {
+        memcpy(arena.get_index_data_32(geometry.first_index), indices.data, geometry.index_count * sizeof(u32));
+    }
+
+    // Bounds are mandatory for positions in glTF, compute them if the exporter left them out.
+    if (position_accessor.min_count == 3 && position_accessor.max_count == 3) {
+        geometry.bounds_min = vec3s{ position_accessor.min[0], position_accessor.min[1], position_accessor.min[2] };
+        geometry.bounds_max = vec3s{ position_accessor.max[0], position_accessor.max[1], position_accessor.max[2] };
+    }
+    else {
+        geometry.bounds_min = geometry.bounds_max = position_data[0];
+        for (u32 vertex = 1; vertex < vertex_count; ++vertex) {
+            geometry.bounds_min = glms_vec3_minv(geometry.bounds_min, position_data[vertex]);
+            geometry.bounds_max = glms_vec3_maxv(geometry.bounds_max, position_data[vertex]);
+        }
+    }
+
+    // Float attributes are read here one at a time before being packed in their arena stream.
+    Array<vec4s> attribute_data;
+    attribute_data.init(allocator, vertex_count, vertex_count);
+
+    if (normal_accessor_index != -1) {
+        copy_accessor_data(scene, buffers_data, scene.accessors[normal_accessor_index], sizeof(vec3s), (u8*)attribute_data.data, sizeof(vec4s), remap);
+    }
+    else {
+        // NOTE(marco): we could compute this at runtime
+        memset(attribute_data.data, 0, vertex_count * sizeof(vec4s));
+
+        for (u32 index = 0; index < geometry.index_count; index += 3) {
+            u32 i0 = indices[index];
+            u32 i1 = indices[index + 1];
+            u32 i2 = indices[index + 2];
+
+            vec3s p0 = position_data[i0];
+            vec3s p1 = position_data[i1];
+            vec3s p2 = position_data[i2];
+
+            vec3s a = glms_vec3_sub(p1, p0);
+            vec3s b = glms_vec3_sub(p2, p0);
+
+            vec4s normal = glms_vec4(glms_cross(a, b), 0.0f);
+
+            attribute_data[i0] = glms_vec4_add(attribute_data[i0], normal);
+            attribute_data[i1] = glms_vec4_add(attribute_data[i1], normal);
+            attribute_data[i2] = glms_vec4_add(attribute_data[i2], normal);
+        }
+    }
+
+    i16* normal_data = (i16*)arena.get_vertex_data(GeometryStream_Normal, geometry.vertex_offset);
+    for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
+        const vec4s& normal = attribute_data[vertex];
+
+        f32 octahedral[2];
+        octahedral_encode(normal.x, normal.y, normal.z, octahedral);
+        normal_data[vertex * 2] = float_to_snorm16(octahedral[0]);
+        normal_data[vertex * 2 + 1] = float_to_snorm16(octahedral[1]);
+    }
+
+    if (tangent_accessor_index != -1) {
+        copy_accessor_data(scene, buffers_data, scene.accessors[tangent_accessor_index], sizeof(vec4s), (u8*)attribute_data.data, sizeof(vec4s), remap);
+
+        i16* tangent_data = (i16*)arena.get_vertex_data(GeometryStream_Tangent, geometry.vertex_offset);
+        for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
+            const vec4s& tangent = attribute_data[vertex];
+
+            f32 octahedral[2];
+            octahedral_encode(tangent.x, tangent.y, tangent.z, octahedral);
+            tangent_data[vertex * 4] = float_to_snorm16(octahedral[0]);
+            tangent_data[vertex * 4 + 1] = float_to_snorm16(octahedral[1]);
+            tangent_data[vertex * 4 + 2] = tangent.w < 0.0f ? -32767 : 32767;
+        }
+
+        geometry.flags |= MaterialFeatures_TangentVertexAttribute;
+    }
+
+    if (texcoord_accessor_index != -1) {
+        copy_accessor_data(scene, buffers_data, scene.accessors[texcoord_accessor_index], sizeof(vec2s), (u8*)attribute_data.data, sizeof(vec4s), remap);
+
+        u16* texcoord_data = (u16*)arena.get_vertex_data(GeometryStream_Texcoord, geometry.vertex_offset);
+        for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
+            texcoord_data[vertex * 2] = float_to_half(attribute_data[vertex].x);
+            texcoord_data[vertex * 2 + 1] = float_to_half(attribute_data[vertex].y);
+        }
+
+        geometry.flags |= MaterialFeatures_TexcoordVertexAttribute;
+    }
+
+    attribute_data.shutdown();
+}
+
+// Image and sampler of a glTF texture, in the cache tables that mirror the glTF ones.
+static void resolve_texture(Engine::glTF::glTF& scene, i32 texture_index, Engine::SceneCacheTexture& out_texture) {
+    using namespace Engine;
+
+    glTF::Texture& texture = scene.textures[texture_index];
+    out_texture.image = texture.source;
+    out_texture.sampler = texture.sampler != glTF::INVALID_INT_VALUE ? (u32)texture.sampler : u32_max;
+}
+
+// Scene image converted to a block compressed .ktx2 next to it, so textures load with all their mips and no decoding.
+struct ImageConversion {
+    char    source_path[512];
+    char    ktx2_path[512];
+    bool    normal_map;
+    bool    pending;        // No up to date .ktx2 exists yet.
+    bool    converted;
+};
+
+// Normal maps keep X and Y in BC5, color goes to BC7 when it has any transparency and to BC1 otherwise.
+static VkFormat select_compressed_format(const u8* pixels, u32 pixel_count, bool normal_map) {
+    if (normal_map) {
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+
+    for (u32 p = 0; p < pixel_count; ++p) {
+        if (pixels[p * 4 + 3] != 255) {
+            return VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+    }
+    return VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+}
+
+// Runs on the task scheduler workers, so memory comes from malloc instead of the engine allocators.
+static void convert_images_to_ktx2(u32 start, u32 end, u32 thread_index, void* user_data) {
+    using namespace Engine;
+
+    ImageConversion* conversions = (ImageConversion*)user_data;
+    for (u32 c = start; c < end; ++c) {
+        ImageConversion& conversion = conversions[c];
+        if (!conversion.pending) {
+            continue;
+        }
+
+        int width, height, comp;
+        u8* pixels = stbi_load(conversion.source_path, &width, &height, &comp, 4);
+        if (pixels == nullptr) {
+            continue;
+        }
+
+        Ktx2Image image{ };
+        image.format = select_compressed_format(pixels, width * height, conversion.normal_map);
+        image.width = width;
+        image.height = height;
+        image.num_levels = min(mip_level_count(image.width, image.height), k_ktx2_max_levels);
+
+        sizet compressed_size = 0;
+        for (u32 level = 0; level < image.num_levels; ++level) {
+            compressed_size += compressed_level_size(image.format, max(image.width >> level, 1u), max(image.height >> level, 1u));
+        }
+
+        // Mips are box filtered from the previous level, all of them after the first fit in width * height pixels.
+        u8* compressed_data = (u8*)malloc(compressed_size);
+        u8* mip_pixels = (u8*)malloc(width * height * 4);
+
+        u8* level_pixels = pixels;
+        u8* next_pixels = mip_pixels;
+        u8* level_data = compressed_data;
+        for (u32 level = 0; level < image.num_levels; ++level) {
+            const u32 level_width = max(image.width >> level, 1u);
+            const u32 level_height = max(image.height >> level, 1u);
+
+            compress_rgba8(image.format, level_pixels, level_width, level_height, level_data);
+            image.levels[level].data = level_data;
+            image.levels[level].size = compressed_level_size(image.format, level_width, level_height);
+            level_data += image.levels[level].size;
+
+            if (level + 1 < image.num_levels) {
+                downsample_rgba8(level_pixels, level_width, level_height, next_pixels);
+                level_pixels = next_pixels;
+                next_pixels += max(level_width / 2, 1u) * max(level_height / 2, 1u) * 4;
+            }
+        }
+
+        conversion.converted = ktx2_write(conversion.ktx2_path, image);
+
+        free(mip_pixels);
+        free(compressed_data);
+        stbi_image_free(pixels);
+    }
+}
+
+// Converts the images that have no up to date .ktx2 yet, then adds the paths the renderer will load to the writer.
+// Without device support for BC formats every image is loaded from its source.
+static void convert_scene_images(Engine::glTF::glTF& scene, Engine::Array<ImageConversion>& conversions, Engine::TaskScheduler* task_scheduler,
+                                 bool compress, Engine::SceneCacheWriter& writer) {
+    using namespace Engine;
+
+    for (u32 material_index = 0; material_index < scene.materials_count; ++material_index) {
+        glTF::Material& material = scene.materials[material_index];
+        if (material.normal_texture != nullptr) {
+            conversions[scene.textures[material.normal_texture->index].source].normal_map = true;
+        }
+    }
+
+    u32 pending_count = 0;
+    for (u32 image_index = 0; image_index < conversions.size; ++image_index) {
+        ImageConversion& conversion = conversions[image_index];
+
+        cstring extension = strrchr(conversion.source_path, '.');
+        if (!compress || (extension && strcmp(extension, ".ktx2") == 0)) {
+            continue;
+        }
+
+        snprintf(conversion.ktx2_path, ArraySize(conversion.ktx2_path), "%s.ktx2", conversion.source_path);
+
+        sizet source_size, ktx2_size;
+        u64 source_time, ktx2_time;
+        if (file_stat(conversion.ktx2_path, &ktx2_size, &ktx2_time) && file_stat(conversion.source_path, &source_size, &source_time) && ktx2_time >= source_time) {
+            conversion.converted = true;
+            continue;
+        }
+
+        conversion.pending = true;
+        ++pending_count;
+    }
+
+    if (pending_count > 0) {
+        const i64 conversion_begin_time = time_now();
+        task_scheduler->parallel_for(conversions.size, 1, convert_images_to_ktx2, conversions.data);
+        rprint("Compressed %u images in %.2f ms\n", pending_count, time_from_milliseconds(conversion_begin_time));
+    }
+
+    // Images that failed to convert are still loaded from their source.
+    for (u32 image_index = 0; image_index < conversions.size; ++image_index) {
+        ImageConversion& conversion = conversions[image_index];
+        writer.add_image(conversion.converted ? conversion.ktx2_path : conversion.source_path);
+    }
+}
+
+// Parses the glTF file, packs its geometry in the arena and flattens the node hierarchy in the writer draws.
+static void import_gltf_scene(cstring gltf_file, Engine::Allocator* allocator, Engine::TaskScheduler* task_scheduler, bool compress_images,
+                              Engine::GeometryArena& geometry_arena, Engine::SceneCacheWriter& writer) {
+    using namespace Engine;
+
+    glTF::glTF scene = gltf_load_file(gltf_file);
+    writer.add_source(gltf_file);
+
+    for (u32 sampler_index = 0; sampler_index < scene.samplers_count; ++sampler_index) {
+        glTF::Sampler& sampler = scene.samplers[sampler_index];
+        // Minification filters name the filter within a level first, then between levels.
+        const bool min_linear = sampler.min_filter == glTF::Sampler::Filter::LINEAR || sampler.min_filter == glTF::Sampler::Filter::LINEAR_MIPMAP_NEAREST ||
+                                sampler.min_filter == glTF::Sampler::Filter::LINEAR_MIPMAP_LINEAR;
+        const bool mip_linear = sampler.min_filter == glTF::Sampler::Filter::NEAREST_MIPMAP_LINEAR || sampler.min_filter == glTF::Sampler::Filter::LINEAR_MIPMAP_LINEAR ||
+                                sampler.min_filter == glTF::INVALID_INT_VALUE;
+        writer.add_sampler(min_linear ? VK_FILTER_LINEAR : VK_FILTER_NEAREST,
+                           sampler.mag_filter == glTF::Sampler::Filter::LINEAR ? VK_FILTER_LINEAR : VK_FILTER_NEAREST,
+                           mip_linear ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST);
+    }
+
+    Array<void*> buffers_data;
+    buffers_data.init(allocator, scene.buffers_count);
+
+    for (u32 buffer_index = 0; buffer_index < scene.buffers_count; ++buffer_index) {
+        glTF::Buffer& buffer = scene.buffers[buffer_index];
+
+        // The .glb binary chunk is used in place, only external buffers are read.
+        if (buffer.data) {
+            buffers_data.push(buffer.data);
+            continue;
+        }
+
+        FileReadResult buffer_data = file_read_binary(buffer.uri.data, allocator);
+        buffers_data.push(buffer_data.data);
+        writer.add_source(buffer.uri.data);
+    }
+
+    // Images embedded in a buffer view are extracted next to the scene, so the cache and the texture loader only deal with files.
+    Array<ImageConversion> image_conversions;
+    image_conversions.init(allocator, scene.images_count);
+
+    for (u32 image_index = 0; image_index < scene.images_count; ++image_index) {
+        glTF::Image& image = scene.images[image_index];
+        ImageConversion& conversion = image_conversions.push_use();
+        conversion = { };
+
+        if (image.uri.data) {
+            snprintf(conversion.source_path, ArraySize(conversion.source_path), "%s", image.uri.data);
+            continue;
+        }
+
+        snprintf(conversion.source_path, ArraySize(conversion.source_path), "%s.image_%u%s", gltf_file, image_index,
+                 image.mime_type.data && strcmp(image.mime_type.data, "image/jpeg") == 0 ? ".jpg" : ".png");
+
+        u32 image_size = 0;
+        u8* image_data = get_buffer_data(scene.buffer_views, image.buffer_view, buffers_data, &image_size);
+        file_write_binary(conversion.source_path, image_data, image_size);
+    }
+
+    convert_scene_images(scene, image_conversions, task_scheduler, compress_images, writer);
+    image_conversions.shutdown();
+
+    // Every primitive is imported once, nodes referencing the same mesh share its arena range.
+    Array<u32> mesh_first_primitive;
+    mesh_first_primitive.init(allocator, scene.meshes_count, scene.meshes_count);
+    Array<PrimitiveGeometry> primitive_geometry;
+    primitive_geometry.init(allocator, scene.meshes_count);
+
+    Array<PrimitiveIndices> primitive_indices;
+    primitive_indices.init(allocator, scene.meshes_count);
+
+    for (u32 mesh_index = 0; mesh_index < scene.meshes_count; ++mesh_index) {
+        glTF::Mesh& mesh = scene.meshes[mesh_index];
+        for (u32 primitive_index = 0; primitive_index < mesh.primitives_count; ++primitive_index) {
+            read_primitive_indices(scene, buffers_data, mesh.primitives[primitive_index], allocator, primitive_indices.push_use());
+        }
+    }
+
+    task_scheduler->parallel_for(primitive_indices.size, 1, optimize_primitive_indices, primitive_indices.data);
+
+    // Average over all triangles of the scene.
+    f64 acmr_before = 0.0, acmr_after = 0.0;
+    u32 triangle_count = 0;
+    for (u32 p = 0; p < primitive_indices.size; ++p) {
+        const u32 primitive_triangles = primitive_indices[p].indices.size / 3;
+        acmr_before += primitive_indices[p].acmr_before * primitive_triangles;
+        acmr_after += primitive_indices[p].acmr_after * primitive_triangles;
+        triangle_count += primitive_triangles;
+    }
+    if (triangle_count > 0) {
+        rprint("Vertex cache ACMR: %.3f before, %.3f after optimization\n", acmr_before / triangle_count, acmr_after / triangle_count);
+    }
+
+    u32 primitive_cursor = 0;
+    for (u32 mesh_index = 0; mesh_index < scene.meshes_count; ++mesh_index) {
+        glTF::Mesh& mesh = scene.meshes[mesh_index];
+        mesh_first_primitive[mesh_index] = primitive_geometry.size;
+
+        for (u32 primitive_index = 0; primitive_index < mesh.primitives_count; ++primitive_index) {
+            PrimitiveIndices& indices = primitive_indices[primitive_cursor++];
+            import_primitive(scene, buffers_data, mesh.primitives[primitive_index], indices, allocator, geometry_arena, primitive_geometry.push_use());
+
+            indices.indices.shutdown();
+            indices.remap.shutdown();
+            indices.scratch.shutdown();
+        }
+    }
+    primitive_indices.shutdown();
+
+    for (u32 buffer_index = 0; buffer_index < scene.buffers_count; ++buffer_index) {
+        if (scene.buffers[buffer_index].data == nullptr) {
+            allocator->deallocate(buffers_data[buffer_index]);
+        }
+    }
+    buffers_data.shutdown();
+
+    glTF::Scene& root_gltf_scene = scene.scenes[scene.scene];
+
+    Array<i32> node_parents;
+    node_parents.init(allocator, scene.nodes_count, scene.nodes_count);
+
+    Array<u32> node_stack;
+    node_stack.init(allocator, 8);
+
+    Array<mat4s> node_matrix;
+    node_matrix.init(allocator, scene.nodes_count, scene.nodes_count);
+
+    for (u32 node_index = 0; node_index < root_gltf_scene.nodes_count; ++node_index) {
+        u32 root_node = root_gltf_scene.nodes[node_index];
+        node_parents[root_node] = -1;
+        node_stack.push(root_node);
+    }
+
+    while (node_stack.size) {
+        u32 node_index = node_stack.back();
+        node_stack.pop();
+        glTF::Node& node = scene.nodes[node_index];
+
+        mat4s local_matrix{ };
+
+        if (node.matrix_count) {
+            // CGLM and glTF have the same matrix layout, just memcopy it
+            memcpy(&local_matrix, node.matrix, sizeof(mat4s));
+        }
+        else {
+            vec3s node_scale{ 1.0f, 1.0f, 1.0f };
+            if (node.scale_count != 0) {
+                RASSERT(node.scale_count == 3);
+                node_scale = vec3s{ node.scale[0], node.scale[1], node.scale[2] };
+            }
+
+            vec3s node_translation{ 0.f, 0.f, 0.f };
+            if (node.translation_count) {
+                RASSERT(node.translation_count == 3);
+                node_translation = vec3s{ node.translation[0], node.translation[1], node.translation[2] };
+            }
+
+            // Rotation is written as a plain quaternion
+            versors node_rotation = glms_quat_identity();
+            if (node.rotation_count) {
+                RASSERT(node.rotation_count == 4);
+                node_rotation = glms_quat_init(node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]);
+            }
+
+            Transform transform;
+            transform.translation = node_translation;
+            transform.scale = node_scale;
+            transform.rotation = node_rotation;
+
+            local_matrix = transform.calculate_matrix();
+        }
+
+        node_matrix[node_index] = local_matrix;
+
+        for (u32 child_index = 0; child_index < node.children_count; ++child_index) {
+            u32 child_node_index = node.children[child_index];
+            node_parents[child_node_index] = node_index;
+            node_stack.push(child_node_index);
+        }
+
+        if (node.mesh == glTF::INVALID_INT_VALUE) {
+            continue;
+        }
+
+        glTF::Mesh& mesh = scene.meshes[node.mesh];
+
+        mat4s final_matrix = local_matrix;
+        i32 node_parent = node_parents[node_index];
+        while (node_parent != -1) {
+            final_matrix = glms_mat4_mul(node_matrix[node_parent], final_matrix);
+            node_parent = node_parents[node_parent];
+        }
+
+        // Final SRT composition
+        for (u32 primitive_index = 0; primitive_index < mesh.primitives_count; ++primitive_index) {
+            glTF::MeshPrimitive& mesh_primitive = mesh.primitives[primitive_index];
+
+            const PrimitiveGeometry& geometry = primitive_geometry[mesh_first_primitive[node.mesh] + primitive_index];
+            if (geometry.index_count == 0) {
+                continue;
+            }
+
+            SceneCacheDraw draw{ };
+            memcpy(draw.model, &final_matrix, sizeof(mat4s));
+
+            draw.first_index = geometry.first_index;
+            draw.vertex_offset = geometry.vertex_offset;
+            draw.index_count = geometry.index_count;
+            draw.index_type = geometry.index_type;
+            draw.flags = geometry.flags;
+            memcpy(draw.bounds_min, &geometry.bounds_min, sizeof(vec3s));
+            memcpy(draw.bounds_max, &geometry.bounds_max, sizeof(vec3s));
+
+            RASSERTM(mesh_primitive.material != glTF::INVALID_INT_VALUE, "Mesh with no material is not supported!");
+            glTF::Material& material = scene.materials[mesh_primitive.material];
+            draw.material_index = mesh_primitive.material;
+
+            if (material.pbr_metallic_roughness != nullptr) {
+                if (material.pbr_metallic_roughness->base_color_factor_count != 0) {
+                    RASSERT(material.pbr_metallic_roughness->base_color_factor_count == 4);
+
+                    memcpy(draw.base_color_factor, material.pbr_metallic_roughness->base_color_factor, sizeof(f32) * 4);
+                }
+                else {
+                    draw.base_color_factor[0] = draw.base_color_factor[1] = draw.base_color_factor[2] = draw.base_color_factor[3] = 1.0f;
+                }
+
+                if (material.pbr_metallic_roughness->base_color_texture != nullptr) {
+                    resolve_texture(scene, material.pbr_metallic_roughness->base_color_texture->index, draw.textures[SceneCacheTextureSlot_Diffuse]);
+                    draw.flags |= MaterialFeatures_ColorTexture;
+                }
+
+                if (material.pbr_metallic_roughness->metallic_roughness_texture != nullptr) {
+                    resolve_texture(scene, material.pbr_metallic_roughness->metallic_roughness_texture->index, draw.textures[SceneCacheTextureSlot_Roughness]);
+                    draw.flags |= MaterialFeatures_RoughnessTexture;
+                }
+
+                draw.metallic_factor = material.pbr_metallic_roughness->metallic_factor != glTF::INVALID_FLOAT_VALUE ? material.pbr_metallic_roughness->metallic_factor : 1.0f;
+                draw.roughness_factor = material.pbr_metallic_roughness->roughness_factor != glTF::INVALID_FLOAT_VALUE ? material.pbr_metallic_roughness->roughness_factor : 1.0f;
+            }
+
+            // NOTE(marco): occlusion could be the same as the roughness texture, but for now we treat it as a separate texture
+            if (material.occlusion_texture != nullptr) {
+                resolve_texture(scene, material.occlusion_texture->index, draw.textures[SceneCacheTextureSlot_Occlusion]);
 
-static void input_os_messages_callback(void* os_event, void* user_data) {
-    Engine::InputService* input = (Engine::InputService*)user_data;
-    input->on_event(os_event);
-}
+                draw.occlusion_factor = material.occlusion_texture->strength != glTF::INVALID_FLOAT_VALUE ? material.occlusion_texture->strength : 1.0f;
+                draw.flags |= MaterialFeatures_OcclusionTexture;
+            }
+            else {
+                draw.occlusion_factor = 1.0f;
+            }
 
-static u8* get_buffer_data(Engine::glTF::BufferView* buffer_views, u32 buffer_index, Engine::Array<void*>& buffers_data, u32* buffer_size = nullptr, char** buffer_name = nullptr) {
-    using namespace Engine;
+            if (material.emissive_factor_count != 0) {
+                memcpy(draw.emissive_factor, material.emissive_factor, sizeof(f32) * 3);
+            }
 
-    glTF::BufferView& buffer = buffer_views[buffer_index];
+            if (material.emissive_texture != nullptr) {
+                resolve_texture(scene, material.emissive_texture->index, draw.textures[SceneCacheTextureSlot_Emissive]);
+                draw.flags |= MaterialFeatures_EmissiveTexture;
+            }
 
-    i32 offset = buffer.byte_offset;
-    if (offset == glTF::INVALID_INT_VALUE) {
-        offset = 0;
-    }
+            if (material.normal_texture != nullptr) {
+                resolve_texture(scene, material.normal_texture->index, draw.textures[SceneCacheTextureSlot_Normal]);
+                draw.flags |= MaterialFeatures_NormalTexture;
+            }
 
-    if (buffer_name != nullptr) {
-        *buffer_name = buffer.name.data;
+            writer.add_draw(draw);
+        }
     }
 
-    if (buffer_size != nullptr) {
-        *buffer_size = buffer.byte_length;
-    }
+    node_parents.shutdown();
+    node_stack.shutdown();
+    node_matrix.shutdown();
 
-    u8* data = (u8*)buffers_data[buffer.buffer] + offset;
+    primitive_geometry.shutdown();
+    mesh_first_primitive.shutdown();
 
-    return data;
+    gltf_free(scene);
 }
 
 int main(int argc, char** argv) {
 
     if (argc < 2) {
-        printf("Usage: chapter1 [path to glTF model]\n");
+        printf("Usage: chapter1 [path to glTF model] [texture memory budget in MB]\n");
         InjectDefault3DModel();
     }
 
@@ -148,6 +960,13 @@ int main(int argc, char** argv) {
     MemoryService::instance()->init(nullptr);
     time_service_init();
 
+    // Zero threads means one per hardware thread, the main thread included. Every thread records with its own
+    // command pools, so the scheduler thread indices are used directly as device thread indices.
+    TaskSchedulerConfiguration task_configuration{ };
+    task_configuration.max_threads = GpuDevice::k_max_threads;
+    TaskScheduler* task_scheduler = TaskScheduler::instance();
+    task_scheduler->init(&task_configuration);
+
     Allocator* allocator = &MemoryService::instance()->system_allocator;
 
     StackAllocator scratch_allocator;
@@ -166,18 +985,20 @@ int main(int argc, char** argv) {
 
     // graphics
     DeviceCreation dc;
-    dc.set_window(window.width, window.height, window.platform_handle).set_allocator(allocator).set_linear_allocator(&scratch_allocator);
+    dc.set_window(window.width, window.height, window.platform_handle).set_allocator(allocator).set_linear_allocator(&scratch_allocator).set_num_threads(task_scheduler->num_threads);
     GpuDevice gpu;
     gpu.init(dc);
+    RASSERTM(gpu.num_threads == task_scheduler->num_threads, "Task threads %u do not all have command pools", task_scheduler->num_threads);
 
     ResourceManager rm;
-    rm.init(allocator, nullptr);
+    rm.init(allocator, nullptr, task_scheduler);
 
     GPUProfiler gpu_profiler;
     gpu_profiler.init(allocator, 100);
 
     Renderer renderer;
-    renderer.init({ &gpu, allocator });
+    const u32 texture_memory_budget = argc > 2 ? (u32)atoi(argv[2]) : k_texture_memory_budget;
+    renderer.init({ &gpu, allocator, task_scheduler, (sizet)rmega(texture_memory_budget) });
     renderer.set_loaders(&rm);
 
     ImGuiService* imgui = ImGuiService::instance();
@@ -197,17 +1018,63 @@ int main(int argc, char** argv) {
     memcpy(gltf_file, argv[1], strlen(argv[1]));
     file_name_from_path(gltf_file);
 
-    glTF::glTF scene = gltf_load_file(gltf_file);
+    // The processed scene is cached next to the glTF file, which is only parsed again when the cache is missing or stale.
+    char scene_cache_path[512]{ };
+    snprintf(scene_cache_path, ArraySize(scene_cache_path), "%s.cache", gltf_file);
 
-    Array<TextureResource> images;
-    images.init(allocator, scene.images_count);
+    GeometryArena geometry_arena;
+    geometry_arena.init(&gpu, allocator, k_geometry_stream_strides, GeometryStream_Count);
 
-    for (u32 image_index = 0; image_index < scene.images_count; ++image_index) {
-        glTF::Image& image = scene.images[image_index];
-        TextureResource* tr = renderer.create_texture(image.uri.data, image.uri.data);
-        RASSERT(tr != nullptr);
+    // Texture and sampler names point in the tables, both stay alive until shutdown.
+    SceneCache scene_cache;
+    SceneCacheWriter scene_cache_writer;
+    scene_cache_writer.init(allocator);
+
+    SceneCacheTables scene_tables;
+    const i64 scene_load_begin_time = time_now();
+    if (scene_cache.map(scene_cache_path, k_geometry_stream_strides, GeometryStream_Count)) {
+        scene_cache.upload_geometry(geometry_arena, "geometry_arena");
+        scene_tables = scene_cache.tables;
+    }
+    else {
+        import_gltf_scene(gltf_file, allocator, task_scheduler, gpu.texture_compression_bc_supported, geometry_arena, scene_cache_writer);
+        scene_cache_writer.write(scene_cache_path, geometry_arena);
+        geometry_arena.upload("geometry_arena");
+        scene_tables = scene_cache_writer.get_tables();
+    }
+    rprint("Scene loaded in %.2f ms, %u draws\n", time_from_milliseconds(scene_load_begin_time), scene_tables.num_draws);
+    rprint("Geometry arena: %u vertices, %u 16 bit indices, %u 32 bit indices\n", geometry_arena.num_vertices, geometry_arena.num_indices_16, geometry_arena.num_indices_32);
+
+    // Pointers in the renderer pool, streaming updates the resources.
+    Array<TextureResource*> images;
+    images.init(allocator, scene_tables.num_images);
+
+    {
+        // Images are decoded on all threads, textures are named after their uri.
+        const i64 texture_load_begin_time = time_now();
+
+        Array<cstring> image_uris;
+        image_uris.init(allocator, scene_tables.num_images);
+        Array<TextureResource*> image_textures;
+        image_textures.init(allocator, scene_tables.num_images, scene_tables.num_images);
+
+        for (u32 image_index = 0; image_index < scene_tables.num_images; ++image_index) {
+            image_uris.push(scene_tables.get_image_uri(image_index));
+        }
 
-        images.push(*tr);
+        renderer.create_textures(image_uris.data, image_uris.data, image_uris.size, task_scheduler, allocator, image_textures.data);
+
+        for (u32 image_index = 0; image_index < scene_tables.num_images; ++image_index) {
+            TextureResource* tr = image_textures[image_index];
+            RASSERT(tr != nullptr);
+
+            images.push(tr);
+        }
+
+        image_uris.shutdown();
+        image_textures.shutdown();
+
+        rprint("Loaded %u textures in %.2f ms\n", scene_tables.num_images, time_from_milliseconds(texture_load_begin_time));
     }
 
     TextureCreation texture_creation{ };
@@ -218,6 +1085,7 @@ int main(int argc, char** argv) {
     SamplerCreation sampler_creation{ };
     sampler_creation.min_filter = VK_FILTER_LINEAR;
     sampler_creation.mag_filter = VK_FILTER_LINEAR;
+    sampler_creation.mip_filter = VK_SAMPLER_MIPMAP_MODE_LINEAR;
     sampler_creation.address_mode_u = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     sampler_creation.address_mode_v = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     SamplerHandle dummy_sampler = gpu.create_sampler(sampler_creation);
@@ -226,16 +1094,17 @@ int main(int argc, char** argv) {
     resource_name_buffer.init(rkilo(64), allocator);
 
     Array<SamplerResource> samplers;
-    samplers.init(allocator, scene.samplers_count);
+    samplers.init(allocator, scene_tables.num_samplers);
 
-    for (u32 sampler_index = 0; sampler_index < scene.samplers_count; ++sampler_index) {
-        glTF::Sampler& sampler = scene.samplers[sampler_index];
+    for (u32 sampler_index = 0; sampler_index < scene_tables.num_samplers; ++sampler_index) {
+        const SceneCacheSampler& sampler = scene_tables.samplers[sampler_index];
 
         char* sampler_name = resource_name_buffer.append_use_f("sampler_%u", sampler_index);
 
         SamplerCreation creation;
-        creation.min_filter = sampler.min_filter == glTF::Sampler::Filter::LINEAR ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
-        creation.mag_filter = sampler.mag_filter == glTF::Sampler::Filter::LINEAR ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+        creation.min_filter = (VkFilter)sampler.min_filter;
+        creation.mag_filter = (VkFilter)sampler.mag_filter;
+        creation.mip_filter = (VkSamplerMipmapMode)sampler.mip_filter;
         creation.name = sampler_name;
 
         SamplerResource* sr = renderer.create_sampler(creation);
@@ -244,55 +1113,26 @@ int main(int argc, char** argv) {
         samplers.push(*sr);
     }
 
-    Array<void*> buffers_data;
-    buffers_data.init(allocator, scene.buffers_count);
-
-    for (u32 buffer_index = 0; buffer_index < scene.buffers_count; ++buffer_index) {
-        glTF::Buffer& buffer = scene.buffers[buffer_index];
-
-        FileReadResult buffer_data = file_read_binary(buffer.uri.data, allocator);
-        buffers_data.push(buffer_data.data);
-    }
-
-    Array<BufferResource> buffers;
-    buffers.init(allocator, scene.buffer_views_count);
-
-    for (u32 buffer_index = 0; buffer_index < scene.buffer_views_count; ++buffer_index) {
-        char* buffer_name = nullptr;
-        u32 buffer_size = 0;
-        u8* data = get_buffer_data(scene.buffer_views, buffer_index, buffers_data, &buffer_size, &buffer_name);
-
-        // NOTE(marco): the target attribute of a BufferView is not mandatory, so we prepare for both uses
-        VkBufferUsageFlags flags = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-
-        if (buffer_name == nullptr) {
-            buffer_name = resource_name_buffer.append_use_f("buffer_%u", buffer_index);
-        }
-        else {
-            // NOTE(marco); some buffers might have the same name, which causes issues in the renderer cache
-            buffer_name = resource_name_buffer.append_use_f("%s_%u", buffer_name, buffer_index);
-        }
-
-        BufferResource* br = renderer.create_buffer(flags, ResourceUsageType::Immutable, buffer_size, data, buffer_name);
-        RASSERT(br != nullptr);
-
-        buffers.push(*br);
-    }
-
     // NOTE(marco): restore working directory
     directory_change(cwd.path);
 
     Array<MeshDraw> mesh_draws;
-    mesh_draws.init(allocator, scene.meshes_count);
+    mesh_draws.init(allocator, max(scene_tables.num_draws, 1u));
 
-    Array<BufferHandle> custom_mesh_buffers{ };
-    custom_mesh_buffers.init(allocator, 8);
+    // Bounds follow mesh_draws order.
+    BoundsSoA mesh_bounds;
+    mesh_bounds.init(allocator, max(scene_tables.num_draws, 1u));
 
-    vec4s dummy_data[3]{ };
     BufferCreation buffer_creation{ };
-    buffer_creation.set(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, ResourceUsageType::Immutable, sizeof(vec4s) * 3).set_data(dummy_data).set_name("dummy_attribute_buffer");
 
-    BufferHandle dummy_attribute_buffer = gpu.create_buffer(buffer_creation);
+    // One object per drawn primitive.
+    ObjectBuffer object_buffer{ };
+    object_buffer.capacity = scene_tables.num_draws;
+    buffer_creation.reset().set(VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, ResourceUsageType::Immutable, max(object_buffer.capacity, 1u) * sizeof(MaterialData)).set_name("object_buffer");
+    object_buffer.buffer = gpu.create_buffer(buffer_creation);
+
+    // With bindless textures every draw uses the same buffers, so they share one set.
+    DescriptorSetHandle shared_descriptor_set{ k_invalid_index };
 
     {
         // Create pipeline state
@@ -303,14 +1143,17 @@ int main(int argc, char** argv) {
         pipeline_creation.vertex_input.add_vertex_attribute({ 0, 0, 0, VertexComponentFormat::Float3 }); // position
         pipeline_creation.vertex_input.add_vertex_stream({ 0, 12, VertexInputRate::PerVertex });
 
-        pipeline_creation.vertex_input.add_vertex_attribute({ 1, 1, 0, VertexComponentFormat::Float4 }); // tangent
-        pipeline_creation.vertex_input.add_vertex_stream({ 1, 16, VertexInputRate::PerVertex });
+        pipeline_creation.vertex_input.add_vertex_attribute({ 1, 1, 0, VertexComponentFormat::Short4N }); // octahedral tangent, bitangent sign
+        pipeline_creation.vertex_input.add_vertex_stream({ 1, 8, VertexInputRate::PerVertex });
 
-        pipeline_creation.vertex_input.add_vertex_attribute({ 2, 2, 0, VertexComponentFormat::Float3 }); // normal
-        pipeline_creation.vertex_input.add_vertex_stream({ 2, 12, VertexInputRate::PerVertex });
+        pipeline_creation.vertex_input.add_vertex_attribute({ 2, 2, 0, VertexComponentFormat::Short2N }); // octahedral normal
+        pipeline_creation.vertex_input.add_vertex_stream({ 2, 4, VertexInputRate::PerVertex });
 
-        pipeline_creation.vertex_input.add_vertex_attribute({ 3, 3, 0, VertexComponentFormat::Float2 }); // texcoord
-        pipeline_creation.vertex_input.add_vertex_stream({ 3, 8, VertexInputRate::PerVertex });
+        pipeline_creation.vertex_input.add_vertex_attribute({ 3, 3, 0, VertexComponentFormat::Half2 }); // texcoord
+        pipeline_creation.vertex_input.add_vertex_stream({ 3, 4, VertexInputRate::PerVertex });
+
+        pipeline_creation.vertex_input.add_vertex_attribute({ 4, 4, 0, VertexComponentFormat::Uint }); // object index
+        pipeline_creation.vertex_input.add_vertex_stream({ 4, 4, VertexInputRate::PerInstance });
 
         // Render pass
         pipeline_creation.render_pass = gpu.get_swapchain_output();
@@ -329,12 +1172,13 @@ uint MaterialFeatures_TexcoordVertexAttribute = 1 << 6;
 
 layout(std140, binding = 0) uniform LocalConstants {
     mat4 m;
+    mat4 m_inv;
     mat4 vp;
     vec4 eye;
     vec4 light;
 };
 
-layout(std140, binding = 1) uniform MaterialConstant {
+struct MaterialConstant {
     vec4 base_color_factor;
     mat4 model;
     mat4 model_inv;
@@ -345,34 +1189,61 @@ layout(std140, binding = 1) uniform MaterialConstant {
     float roughness_factor;
     float occlusion_factor;
     uint  flags;
+
+    uint  diffuse_texture;
+    uint  roughness_texture;
+    uint  occlusion_texture;
+    uint  emissive_texture;
+    uint  normal_texture;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectConstants {
+    MaterialConstant objects[];
 };
 
 layout(location=0) in vec3 position;
-layout(location=1) in vec4 tangent;
-layout(location=2) in vec3 normal;
+layout(location=1) in vec4 tangent;     // Octahedral direction in xy, bitangent sign in z.
+layout(location=2) in vec2 normal;      // Octahedral direction.
 layout(location=3) in vec2 texCoord0;
+layout(location=4) in uint object_index;
 
 layout (location = 0) out vec2 vTexcoord0;
 layout (location = 1) out vec3 vNormal;
 layout (location = 2) out vec4 vTangent;
 layout (location = 3) out vec4 vPosition;
+layout (location = 4) flat out uint vObjectIndex;
+
+vec3 oct_decode( vec2 e ) {
+    vec3 v = vec3( e.xy, 1.0 - abs( e.x ) - abs( e.y ) );
+    float t = max( -v.z, 0.0 );
+    v.xy += vec2( v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t );
+    return normalize( v );
+}
 
 void main() {
-    gl_Position = vp * m * model * vec4(position, 1);
-    vPosition = m * model * vec4(position, 1.0);
+    // Object index comes from the per instance stream.
+    MaterialConstant material = objects[object_index];
 
-    if ( ( flags & MaterialFeatures_TexcoordVertexAttribute ) != 0 ) {
+    gl_Position = vp * m * material.model * vec4(position, 1);
+    vPosition = m * material.model * vec4(position, 1.0);
+
+    if ( ( material.flags & MaterialFeatures_TexcoordVertexAttribute ) != 0 ) {
         vTexcoord0 = texCoord0;
     }
-    vNormal = mat3( model_inv ) * normal;
+    vNormal = mat3( m_inv ) * mat3( material.model_inv ) * oct_decode( normal );
 
-    if ( ( flags & MaterialFeatures_TangentVertexAttribute ) != 0 ) {
-        vTangent = tangent;
+    if ( ( material.flags & MaterialFeatures_TangentVertexAttribute ) != 0 ) {
+        vTangent = vec4( oct_decode( tangent.xy ), tangent.z );
     }
+
+    vObjectIndex = object_index;
 }
 )FOO";
 
-        const char* fs_code = R"FOO(#version 450
+        // Version and BINDLESS define are prepended below.
+        const char* fs_code = R"FOO(
+#extension GL_EXT_nonuniform_qualifier : enable
+
 uint MaterialFeatures_ColorTexture     = 1 << 0;
 uint MaterialFeatures_NormalTexture    = 1 << 1;
 uint MaterialFeatures_RoughnessTexture = 1 << 2;
@@ -383,12 +1254,13 @@ uint MaterialFeatures_TexcoordVertexAttribute = 1 << 6;
 
 layout(std140, binding = 0) uniform LocalConstants {
     mat4 m;
+    mat4 m_inv;
     mat4 vp;
     vec4 eye;
     vec4 light;
 };
 
-layout(std140, binding = 1) uniform MaterialConstant {
+struct MaterialConstant {
     vec4 base_color_factor;
     mat4 model;
     mat4 model_inv;
@@ -399,18 +1271,39 @@ layout(std140, binding = 1) uniform MaterialConstant {
     float roughness_factor;
     float occlusion_factor;
     uint  flags;
+
+    uint  diffuse_texture;
+    uint  roughness_texture;
+    uint  occlusion_texture;
+    uint  emissive_texture;
+    uint  normal_texture;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectConstants {
+    MaterialConstant objects[];
 };
 
+#if defined(BINDLESS)
+layout (set = 1, binding = 10) uniform sampler2D global_textures[];
+
+#define diffuseTexture global_textures[nonuniformEXT(material.diffuse_texture)]
+#define roughnessMetalnessTexture global_textures[nonuniformEXT(material.roughness_texture)]
+#define occlusionTexture global_textures[nonuniformEXT(material.occlusion_texture)]
+#define emissiveTexture global_textures[nonuniformEXT(material.emissive_texture)]
+#define normalTexture global_textures[nonuniformEXT(material.normal_texture)]
+#else
 layout (binding = 2) uniform sampler2D diffuseTexture;
 layout (binding = 3) uniform sampler2D roughnessMetalnessTexture;
 layout (binding = 4) uniform sampler2D occlusionTexture;
 layout (binding = 5) uniform sampler2D emissiveTexture;
 layout (binding = 6) uniform sampler2D normalTexture;
+#endif // BINDLESS
 
 layout (location = 0) in vec2 vTexcoord0;
 layout (location = 1) in vec3 vNormal;
 layout (location = 2) in vec4 vTangent;
 layout (location = 3) in vec4 vPosition;
+layout (location = 4) flat in uint vObjectIndex;
 
 layout (location = 0) out vec4 frag_color;
 
@@ -469,9 +1362,11 @@ float heaviside( float v ) {
 
 void main() {
 
+    MaterialConstant material = objects[vObjectIndex];
+
     mat3 TBN = mat3( 1.0 );
 
-    if ( ( flags & MaterialFeatures_TangentVertexAttribute ) != 0 ) {
+    if ( ( material.flags & MaterialFeatures_TangentVertexAttribute ) != 0 ) {
         vec3 tangent = normalize( vTangent.xyz );
         vec3 bitangent = cross( normalize( vNormal ), tangent ) * vTangent.w;
 
@@ -508,16 +1403,18 @@ void main() {
     vec3 L = normalize( light.xyz - vPosition.xyz );
     // NOTE(marco): normal textures are encoded to [0, 1] but need to be mapped to [-1, 1] value
     vec3 N = normalize( vNormal );
-    if ( ( flags & MaterialFeatures_NormalTexture ) != 0 ) {
-        N = normalize( texture(normalTexture, vTexcoord0).rgb * 2.0 - 1.0 );
+    if ( ( material.flags & MaterialFeatures_NormalTexture ) != 0 ) {
+        // Only X and Y are stored (BC5), Z is rebuilt from the unit length.
+        vec2 normal_xy = texture(normalTexture, vTexcoord0).rg * 2.0 - 1.0;
+        N = vec3( normal_xy, sqrt( max( 1.0 - dot( normal_xy, normal_xy ), 0.0 ) ) );
         N = normalize( TBN * N );
     }
     vec3 H = normalize( L + V );
 
-    float roughness = roughness_factor;
-    float metalness = metallic_factor;
+    float roughness = material.roughness_factor;
+    float metalness = material.metallic_factor;
 
-    if ( ( flags & MaterialFeatures_RoughnessTexture ) != 0 ) {
+    if ( ( material.flags & MaterialFeatures_RoughnessTexture ) != 0 ) {
         // Red channel for occlusion value
         // Green channel contains roughness values
         // Blue channel contains metalness
@@ -528,24 +1425,24 @@ void main() {
     }
 
     float ao = 1.0f;
-    if ( ( flags & MaterialFeatures_OcclusionTexture ) != 0 ) {
+    if ( ( material.flags & MaterialFeatures_OcclusionTexture ) != 0 ) {
         ao = texture(occlusionTexture, vTexcoord0).r;
     }
 
     float alpha = pow(roughness, 2.0);
 
-    vec4 base_colour = base_color_factor;
-    if ( ( flags & MaterialFeatures_ColorTexture ) != 0 ) {
+    vec4 base_colour = material.base_color_factor;
+    if ( ( material.flags & MaterialFeatures_ColorTexture ) != 0 ) {
         vec4 albedo = texture( diffuseTexture, vTexcoord0 );
         base_colour.rgb *= decode_srgb( albedo.rgb );
         base_colour.a *= albedo.a;
     }
 
     vec3 emissive = vec3( 0 );
-    if ( ( flags & MaterialFeatures_EmissiveTexture ) != 0 ) {
+    if ( ( material.flags & MaterialFeatures_EmissiveTexture ) != 0 ) {
         vec4 e = texture(emissiveTexture, vTexcoord0);
 
-        emissive += decode_srgb( e.rgb ) * emissive_factor;
+        emissive += decode_srgb( e.rgb ) * material.emissive_factor;
     }
 
     // https://www.khronos.org/registry/glTF/specs/2.0/glTF-2.0.html#specular-brdf
@@ -577,7 +1474,7 @@ void main() {
 
         vec3 material_colour = mix( fresnel_mix, conductor_fresnel, metalness );
 
-        material_colour = emissive + mix( material_colour, material_colour * ao, occlusion_factor);
+        material_colour = emissive + mix( material_colour, material_colour * ao, material.occlusion_factor);
 
         frag_color = vec4( encode_srgb( material_colour ), base_colour.a );
     } else {
@@ -586,17 +1483,24 @@ void main() {
 }
 )FOO";
 
-        pipeline_creation.shaders.set_name("Cube").add_stage(vs_code, (uint32_t)strlen(vs_code), VK_SHADER_STAGE_VERTEX_BIT).add_stage(fs_code, (uint32_t)strlen(fs_code), VK_SHADER_STAGE_FRAGMENT_BIT);
+        StringBuffer fs_source;
+        fs_source.init(strlen(fs_code) + 64, allocator);
+        fs_source.append(gpu.bindless_supported ? "#version 450\n#define BINDLESS\n" : "#version 450\n");
+        fs_source.append(fs_code);
+
+        pipeline_creation.shaders.set_name("Cube").add_stage(vs_code, (uint32_t)strlen(vs_code), VK_SHADER_STAGE_VERTEX_BIT).add_stage(fs_source.data, fs_source.current_size, VK_SHADER_STAGE_FRAGMENT_BIT);
 
         // Descriptor set layout
         DescriptorSetLayoutCreation cube_rll_creation{};
         cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 0, 1, "LocalConstants" });
-        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, 1, "MaterialConstant" });
-        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, 1, "diffuseTexture" });
-        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, 1, "roughnessMetalnessTexture" });
-        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, 1, "roughnessMetalnessTexture" });
-        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, 1, "emissiveTexture" });
-        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, 1, "occlusionTexture" });
+        cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, 1, "ObjectConstants" });
+        if (!gpu.bindless_supported) {
+            cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2, 1, "diffuseTexture" });
+            cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3, 1, "roughnessMetalnessTexture" });
+            cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4, 1, "roughnessMetalnessTexture" });
+            cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5, 1, "emissiveTexture" });
+            cube_rll_creation.add_binding({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6, 1, "occlusionTexture" });
+        }
         // Setting it into pipeline
         cube_dsl = gpu.create_descriptor_set_layout(cube_rll_creation);
         pipeline_creation.add_descriptor_set_layout(cube_dsl);
@@ -607,362 +1511,148 @@ void main() {
         cube_cb = gpu.create_buffer(buffer_creation);
 
         cube_pipeline = gpu.create_pipeline(pipeline_creation);
+        fs_source.shutdown();
 
-        glTF::Scene& root_gltf_scene = scene.scenes[scene.scene];
-
-        Array<i32> node_parents;
-        node_parents.init(allocator, scene.nodes_count, scene.nodes_count);
-
-        Array<u32> node_stack;
-        node_stack.init(allocator, 8);
-
-        Array<mat4s> node_matrix;
-        node_matrix.init(allocator, scene.nodes_count, scene.nodes_count);
-
-        for (u32 node_index = 0; node_index < root_gltf_scene.nodes_count; ++node_index) {
-            u32 root_node = root_gltf_scene.nodes[node_index];
-            node_parents[root_node] = -1;
-            node_stack.push(root_node);
+        if (gpu.bindless_supported) {
+            DescriptorSetCreation ds_creation{};
+            ds_creation.set_layout(cube_dsl).buffer(cube_cb, 0).buffer(object_buffer.buffer, 1).set_name("shared_descriptor_set");
+            shared_descriptor_set = gpu.create_descriptor_set(ds_creation);
         }
 
-        while (node_stack.size) {
-            u32 node_index = node_stack.back();
-            node_stack.pop();
-            glTF::Node& node = scene.nodes[node_index];
-
-            mat4s local_matrix{ };
-
-            if (node.matrix_count) {
-                // CGLM and glTF have the same matrix layout, just memcopy it
-                memcpy(&local_matrix, node.matrix, sizeof(mat4s));
-            }
-            else {
-                vec3s node_scale{ 1.0f, 1.0f, 1.0f };
-                if (node.scale_count != 0) {
-                    RASSERT(node.scale_count == 3);
-                    node_scale = vec3s{ node.scale[0], node.scale[1], node.scale[2] };
+        for (u32 draw_index = 0; draw_index < scene_tables.num_draws; ++draw_index) {
+            const SceneCacheDraw& draw = scene_tables.draws[draw_index];
+
+            MeshDraw mesh_draw{ };
+
+            MaterialData& material_data = mesh_draw.material_data;
+            memcpy(&material_data.model, draw.model, sizeof(mat4s));
+            material_data.base_color_factor = vec4s{ draw.base_color_factor[0], draw.base_color_factor[1], draw.base_color_factor[2], draw.base_color_factor[3] };
+            material_data.emissive_factor = vec3s{ draw.emissive_factor[0], draw.emissive_factor[1], draw.emissive_factor[2] };
+            material_data.metallic_factor = draw.metallic_factor;
+            material_data.roughness_factor = draw.roughness_factor;
+            material_data.occlusion_factor = draw.occlusion_factor;
+            material_data.flags = draw.flags;
+
+            mesh_draw.first_index = draw.first_index;
+            mesh_draw.vertex_offset = draw.vertex_offset;
+            mesh_draw.count = draw.index_count;
+            mesh_draw.index_type = (VkIndexType)draw.index_type;
+
+            const vec3s bounds_min{ draw.bounds_min[0], draw.bounds_min[1], draw.bounds_min[2] };
+            const vec3s bounds_max{ draw.bounds_max[0], draw.bounds_max[1], draw.bounds_max[2] };
+            mesh_draw.bounding_center = glms_vec3_scale(glms_vec3_add(bounds_min, bounds_max), 0.5f);
+            mesh_draw.bounding_radius = glms_vec3_distance(bounds_min, bounds_max) * 0.5f;
+            mesh_draw.bounding_extent = glms_vec3_scale(glms_vec3_sub(bounds_max, bounds_min), 0.5f);
+
+            // Descriptor Set
+            DescriptorSetCreation ds_creation{};
+            ds_creation.set_layout(cube_dsl).buffer(cube_cb, 0);
+
+            ds_creation.buffer(object_buffer.buffer, 1);
+
+            // Texture slots follow the texture indices in MaterialData, bound from binding 2.
+            u32* texture_indices = &material_data.diffuse_texture;
+            for (u32 slot = 0; slot < SceneCacheTextureSlot_Count; ++slot) {
+                const SceneCacheTexture& texture = draw.textures[slot];
+                const u16 binding = (u16)(2 + slot);
+
+                if (texture.image != u32_max) {
+                    SamplerHandle sampler_handle = texture.sampler != u32_max ? samplers[texture.sampler].handle : dummy_sampler;
+                    set_material_texture(gpu, ds_creation, images[texture.image]->handle, sampler_handle, binding, texture_indices[slot]);
+                    mesh_draw.textures[slot] = images[texture.image];
                 }
-
-                vec3s node_translation{ 0.f, 0.f, 0.f };
-                if (node.translation_count) {
-                    RASSERT(node.translation_count == 3);
-                    node_translation = vec3s{ node.translation[0], node.translation[1], node.translation[2] };
-                }
-
-                // Rotation is written as a plain quaternion
-                versors node_rotation = glms_quat_identity();
-                if (node.rotation_count) {
-                    RASSERT(node.rotation_count == 4);
-                    node_rotation = glms_quat_init(node.rotation[0], node.rotation[1], node.rotation[2], node.rotation[3]);
+                else {
+                    set_material_texture(gpu, ds_creation, dummy_texture, dummy_sampler, binding, texture_indices[slot]);
+                    mesh_draw.textures[slot] = nullptr;
                 }
-
-                Transform transform;
-                transform.translation = node_translation;
-                transform.scale = node_scale;
-                transform.rotation = node_rotation;
-
-                local_matrix = transform.calculate_matrix();
             }
 
-            node_matrix[node_index] = local_matrix;
-
-            for (u32 child_index = 0; child_index < node.children_count; ++child_index) {
-                u32 child_node_index = node.children[child_index];
-                node_parents[child_node_index] = node_index;
-                node_stack.push(child_node_index);
-            }
+            mesh_draw.descriptor_set = gpu.bindless_supported ? shared_descriptor_set : gpu.create_descriptor_set(ds_creation);
 
-            if (node.mesh == glTF::INVALID_INT_VALUE) {
-                continue;
-            }
+            mesh_draw.material_index = draw.material_index;
+            mesh_draw.transform_dirty = true;
+            object_buffer.mark_dirty(mesh_draws.size);
 
-            glTF::Mesh& mesh = scene.meshes[node.mesh];
+            mesh_draws.push(mesh_draw);
 
-            mat4s final_matrix = local_matrix;
-            i32 node_parent = node_parents[node_index];
-            while (node_parent != -1) {
-                final_matrix = glms_mat4_mul(node_matrix[node_parent], final_matrix);
-                node_parent = node_parents[node_parent];
+            // Scene space box enclosing the transformed object box, culling brings the frustum into scene space.
+            const mat4s& model = mesh_draw.material_data.model;
+            const vec3s extent = mesh_draw.bounding_extent;
+            vec3s scene_center = glms_mat4_mulv3(model, mesh_draw.bounding_center, 1.0f);
+            vec3s scene_extent;
+            for (u32 r = 0; r < 3; ++r) {
+                scene_extent.raw[r] = fabsf(model.raw[0][r]) * extent.x + fabsf(model.raw[1][r]) * extent.y + fabsf(model.raw[2][r]) * extent.z;
             }
 
-            // Final SRT composition
-            for (u32 primitive_index = 0; primitive_index < mesh.primitives_count; ++primitive_index) {
-                MeshDraw mesh_draw{ };
-
-                mesh_draw.material_data.model = final_matrix;
-
-                glTF::MeshPrimitive& mesh_primitive = mesh.primitives[primitive_index];
-
-                glTF::Accessor& indices_accessor = scene.accessors[mesh_primitive.indices];
-                RASSERT(indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT || indices_accessor.component_type == glTF::Accessor::UNSIGNED_SHORT);
-                mesh_draw.index_type = indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT ? VK_INDEX_TYPE_UINT32 : VK_INDEX_TYPE_UINT16;
-
-                glTF::BufferView& indices_buffer_view = scene.buffer_views[indices_accessor.buffer_view];
-                BufferResource& indices_buffer_gpu = buffers[indices_accessor.buffer_view];
-                mesh_draw.index_buffer = indices_buffer_gpu.handle;
-                mesh_draw.index_offset = indices_accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : indices_accessor.byte_offset;
-                mesh_draw.count = indices_accessor.count;
-                RASSERT((mesh_draw.count % 3) == 0);
-
-                i32 position_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "POSITION");
-                i32 tangent_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "TANGENT");
-                i32 normal_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "NORMAL");
-                i32 texcoord_accessor_index = gltf_get_attribute_accessor_index(mesh_primitive.attributes, mesh_primitive.attribute_count, "TEXCOORD_0");
-
-                vec3s* position_data = nullptr;
-                u32* index_data_32 = (u32*)get_buffer_data(scene.buffer_views, indices_accessor.buffer_view, buffers_data);
-                u16* index_data_16 = (u16*)index_data_32;
-                u32 vertex_count = 0;
-
-                if (position_accessor_index != -1) {
-                    glTF::Accessor& position_accessor = scene.accessors[position_accessor_index];
-                    glTF::BufferView& position_buffer_view = scene.buffer_views[position_accessor.buffer_view];
-                    BufferResource& position_buffer_gpu = buffers[position_accessor.buffer_view];
-
-                    vertex_count = position_accessor.count;
-
-                    mesh_draw.position_buffer = position_buffer_gpu.handle;
-                    mesh_draw.position_offset = position_accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : position_accessor.byte_offset;
-
-                    position_data = (vec3s*)get_buffer_data(scene.buffer_views, position_accessor.buffer_view, buffers_data);
-                }
-                else {
-                    RASSERTM(false, "No position data found!");
-                    continue;
-                }
-
-                if (normal_accessor_index != -1) {
-                    glTF::Accessor& normal_accessor = scene.accessors[normal_accessor_index];
-                    glTF::BufferView& normal_buffer_view = scene.buffer_views[normal_accessor.buffer_view];
-                    BufferResource& normal_buffer_gpu = buffers[normal_accessor.buffer_view];
-
-                    mesh_draw.normal_buffer = normal_buffer_gpu.handle;
-                    mesh_draw.normal_offset = normal_accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : normal_accessor.byte_offset;
-                }
-                else {
-                    // NOTE(marco): we could compute this at runtime
-                    Array<vec3s> normals_array{ };
-                    normals_array.init(allocator, vertex_count, vertex_count);
-                    memset(normals_array.data, 0, normals_array.size * sizeof(vec3s));
-
-                    u32 index_count = mesh_draw.count;
-                    for (u32 index = 0; index < index_count; index += 3) {
-                        u32 i0 = indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT ? index_data_32[index] : index_data_16[index];
-                        u32 i1 = indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT ? index_data_32[index + 1] : index_data_16[index + 1];
-                        u32 i2 = indices_accessor.component_type == glTF::Accessor::UNSIGNED_INT ? index_data_32[index + 2] : index_data_16[index + 2];
-
-                        vec3s p0 = position_data[i0];
-                        vec3s p1 = position_data[i1];
-                        vec3s p2 = position_data[i2];
-
-                        vec3s a = glms_vec3_sub(p1, p0);
-                        vec3s b = glms_vec3_sub(p2, p0);
-
-                        vec3s normal = glms_cross(a, b);
-
-                        normals_array[i0] = glms_vec3_add(normals_array[i0], normal);
-                        normals_array[i1] = glms_vec3_add(normals_array[i1], normal);
-                        normals_array[i2] = glms_vec3_add(normals_array[i2], normal);
-                    }
-
-                    for (u32 vertex = 0; vertex < vertex_count; ++vertex) {
-                        normals_array[vertex] = glms_normalize(normals_array[vertex]);
-                    }
-
-                    BufferCreation normals_creation{ };
-                    normals_creation.set(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, ResourceUsageType::Immutable, normals_array.size * sizeof(vec3s)).set_name("normals").set_data(normals_array.data);
-
-                    mesh_draw.normal_buffer = gpu.create_buffer(normals_creation);
-                    mesh_draw.normal_offset = 0;
-
-                    custom_mesh_buffers.push(mesh_draw.normal_buffer);
-
-                    normals_array.shutdown();
-                }
-
-                if (tangent_accessor_index != -1) {
-                    glTF::Accessor& tangent_accessor = scene.accessors[tangent_accessor_index];
-                    glTF::BufferView& tangent_buffer_view = scene.buffer_views[tangent_accessor.buffer_view];
-                    BufferResource& tangent_buffer_gpu = buffers[tangent_accessor.buffer_view];
-
-                    mesh_draw.tangent_buffer = tangent_buffer_gpu.handle;
-                    mesh_draw.tangent_offset = tangent_accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : tangent_accessor.byte_offset;
-
-                    mesh_draw.material_data.flags |= MaterialFeatures_TangentVertexAttribute;
-                }
-
-                if (texcoord_accessor_index != -1) {
-                    glTF::Accessor& texcoord_accessor = scene.accessors[texcoord_accessor_index];
-                    glTF::BufferView& texcoord_buffer_view = scene.buffer_views[texcoord_accessor.buffer_view];
-                    BufferResource& texcoord_buffer_gpu = buffers[texcoord_accessor.buffer_view];
-
-                    mesh_draw.texcoord_buffer = texcoord_buffer_gpu.handle;
-                    mesh_draw.texcoord_offset = texcoord_accessor.byte_offset == glTF::INVALID_INT_VALUE ? 0 : texcoord_accessor.byte_offset;
-
-                    mesh_draw.material_data.flags |= MaterialFeatures_TexcoordVertexAttribute;
-                }
-
-                RASSERTM(mesh_primitive.material != glTF::INVALID_INT_VALUE, "Mesh with no material is not supported!");
-                glTF::Material& material = scene.materials[mesh_primitive.material];
-
-                // Descriptor Set
-                DescriptorSetCreation ds_creation{};
-                ds_creation.set_layout(cube_dsl).buffer(cube_cb, 0);
-
-                buffer_creation.reset().set(VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, ResourceUsageType::Dynamic, sizeof(MaterialData)).set_name("material");
-                mesh_draw.material_buffer = gpu.create_buffer(buffer_creation);
-                ds_creation.buffer(mesh_draw.material_buffer, 1);
-
-                if (material.pbr_metallic_roughness != nullptr) {
-                    if (material.pbr_metallic_roughness->base_color_factor_count != 0) {
-                        RASSERT(material.pbr_metallic_roughness->base_color_factor_count == 4);
-
-                        mesh_draw.material_data.base_color_factor = {
-                            material.pbr_metallic_roughness->base_color_factor[0],
-                            material.pbr_metallic_roughness->base_color_factor[1],
-                            material.pbr_metallic_roughness->base_color_factor[2],
-                            material.pbr_metallic_roughness->base_color_factor[3],
-                        };
-                    }
-                    else {
-                        mesh_draw.material_data.base_color_factor = { 1.0f, 1.0f, 1.0f, 1.0f };
-                    }
-
-                    if (material.pbr_metallic_roughness->base_color_texture != nullptr) {
-                        glTF::Texture& diffuse_texture = scene.textures[material.pbr_metallic_roughness->base_color_texture->index];
-                        TextureResource& diffuse_texture_gpu = images[diffuse_texture.source];
-
-                        SamplerHandle sampler_handle = dummy_sampler;
-                        if (diffuse_texture.sampler != glTF::INVALID_INT_VALUE) {
-                            sampler_handle = samplers[diffuse_texture.sampler].handle;
-                        }
-
-                        ds_creation.texture_sampler(diffuse_texture_gpu.handle, sampler_handle, 2);
-
-                        mesh_draw.material_data.flags |= MaterialFeatures_ColorTexture;
-                    }
-                    else {
-                        ds_creation.texture_sampler(dummy_texture, dummy_sampler, 2);
-                    }
-
-                    if (material.pbr_metallic_roughness->metallic_roughness_texture != nullptr) {
-                        glTF::Texture& roughness_texture = scene.textures[material.pbr_metallic_roughness->metallic_roughness_texture->index];
-                        TextureResource& roughness_texture_gpu = images[roughness_texture.source];
-
-                        SamplerHandle sampler_handle = dummy_sampler;
-                        if (roughness_texture.sampler != glTF::INVALID_INT_VALUE) {
-                            sampler_handle = samplers[roughness_texture.sampler].handle;
-                        }
-
-                        ds_creation.texture_sampler(roughness_texture_gpu.handle, sampler_handle, 3);
-
-                        mesh_draw.material_data.flags |= MaterialFeatures_RoughnessTexture;
-                    }
-                    else {
-                        ds_creation.texture_sampler(dummy_texture, dummy_sampler, 3);
-                    }
-
-                    if (material.pbr_metallic_roughness->metallic_factor != glTF::INVALID_FLOAT_VALUE) {
-                        mesh_draw.material_data.metallic_factor = material.pbr_metallic_roughness->metallic_factor;
-                    }
-                    else {
-                        mesh_draw.material_data.metallic_factor = 1.0f;
-                    }
-
-                    if (material.pbr_metallic_roughness->roughness_factor != glTF::INVALID_FLOAT_VALUE) {
-                        mesh_draw.material_data.roughness_factor = material.pbr_metallic_roughness->roughness_factor;
-                    }
-                    else {
-                        mesh_draw.material_data.roughness_factor = 1.0f;
-                    }
-                }
-
-                if (material.occlusion_texture != nullptr) {
-                    glTF::Texture& occlusion_texture = scene.textures[material.occlusion_texture->index];
-
-                    // NOTE(marco): this could be the same as the roughness texture, but for now we treat it as a separate
-                    // texture
-                    TextureResource& occlusion_texture_gpu = images[occlusion_texture.source];
-
-                    SamplerHandle sampler_handle = dummy_sampler;
-                    if (occlusion_texture.sampler != glTF::INVALID_INT_VALUE) {
-                        sampler_handle = samplers[occlusion_texture.sampler].handle;
-                    }
-
-                    ds_creation.texture_sampler(occlusion_texture_gpu.handle, sampler_handle, 4);
-
-                    mesh_draw.material_data.occlusion_factor = material.occlusion_texture->strength != glTF::INVALID_FLOAT_VALUE ? material.occlusion_texture->strength : 1.0f;
-                    mesh_draw.material_data.flags |= MaterialFeatures_OcclusionTexture;
-                }
-                else {
-                    mesh_draw.material_data.occlusion_factor = 1.0f;
-                    ds_creation.texture_sampler(dummy_texture, dummy_sampler, 4);
-                }
-
-                if (material.emissive_factor_count != 0) {
-                    mesh_draw.material_data.emissive_factor = vec3s{
-                        material.emissive_factor[0],
-                        material.emissive_factor[1],
-                        material.emissive_factor[2],
-                    };
-                }
-
-                if (material.emissive_texture != nullptr) {
-                    glTF::Texture& emissive_texture = scene.textures[material.emissive_texture->index];
-
-                    // NOTE(marco): this could be the same as the roughness texture, but for now we treat it as a separate
-                    // texture
-                    TextureResource& emissive_texture_gpu = images[emissive_texture.source];
-
-                    SamplerHandle sampler_handle = dummy_sampler;
-                    if (emissive_texture.sampler != glTF::INVALID_INT_VALUE) {
-                        sampler_handle = samplers[emissive_texture.sampler].handle;
-                    }
-
-                    ds_creation.texture_sampler(emissive_texture_gpu.handle, sampler_handle, 5);
-
-                    mesh_draw.material_data.flags |= MaterialFeatures_EmissiveTexture;
-                }
-                else {
-                    ds_creation.texture_sampler(dummy_texture, dummy_sampler, 5);
-                }
-
-                if (material.normal_texture != nullptr) {
-                    glTF::Texture& normal_texture = scene.textures[material.normal_texture->index];
-                    TextureResource& normal_texture_gpu = images[normal_texture.source];
+            vec3s scene_min = glms_vec3_sub(scene_center, scene_extent);
+            vec3s scene_max = glms_vec3_add(scene_center, scene_extent);
+            mesh_bounds.add(scene_min.raw, scene_max.raw);
+        }
 
-                    SamplerHandle sampler_handle = dummy_sampler;
-                    if (normal_texture.sampler != glTF::INVALID_INT_VALUE) {
-                        sampler_handle = samplers[normal_texture.sampler].handle;
-                    }
+        rx = 0.0f;
+        ry = 0.0f;
+    }
 
-                    ds_creation.texture_sampler(normal_texture_gpu.handle, sampler_handle, 6);
+    Array<u8> mesh_visibility;
+    mesh_visibility.init(allocator, mesh_draws.size, mesh_draws.size);
 
-                    mesh_draw.material_data.flags |= MaterialFeatures_NormalTexture;
-                }
-                else {
-                    ds_creation.texture_sampler(dummy_texture, dummy_sampler, 6);
-                }
+    // Group draws sharing arena range and material, each group is one instanced draw.
+    Array<InstanceGroup> instance_groups;
+    instance_groups.init(allocator, 16);
+    Array<u32> instance_members;
+    instance_members.init(allocator, mesh_draws.size, mesh_draws.size);
+    {
+        FlatHashMap<u64, u32> group_map;
+        group_map.init(allocator, 16);
+        group_map.set_default_value(u32_max);
+
+        Array<u32> mesh_groups;
+        mesh_groups.init(allocator, mesh_draws.size, mesh_draws.size);
+
+        for (u32 mesh_index = 0; mesh_index < mesh_draws.size; ++mesh_index) {
+            const MeshDraw& mesh_draw = mesh_draws[mesh_index];
+
+            InstanceKey key{ };
+            key.first_index = mesh_draw.first_index;
+            key.index_count = mesh_draw.count;
+            key.vertex_offset = mesh_draw.vertex_offset;
+            key.material_index = mesh_draw.material_index;
+            key.index_type = mesh_draw.index_type;
+
+            const u64 key_hash = hash_bytes(&key, sizeof(InstanceKey));
+            u32 group_index = group_map.get(key_hash);
+            if (group_index == u32_max) {
+                group_index = instance_groups.size;
+                group_map.insert(key_hash, group_index);
+                instance_groups.push({ 0, 0 });
+            }
 
-                mesh_draw.descriptor_set = gpu.create_descriptor_set(ds_creation);
+            mesh_groups[mesh_index] = group_index;
+            ++instance_groups[group_index].count;
+        }
 
-                mesh_draws.push(mesh_draw);
-            }
+        u32 first_member = 0;
+        for (u32 group_index = 0; group_index < instance_groups.size; ++group_index) {
+            instance_groups[group_index].first_member = first_member;
+            first_member += instance_groups[group_index].count;
+            instance_groups[group_index].count = 0;
         }
 
-        node_parents.shutdown();
-        node_stack.shutdown();
-        node_matrix.shutdown();
+        for (u32 mesh_index = 0; mesh_index < mesh_draws.size; ++mesh_index) {
+            InstanceGroup& group = instance_groups[mesh_groups[mesh_index]];
+            instance_members[group.first_member + group.count++] = mesh_index;
+        }
 
-        rx = 0.0f;
-        ry = 0.0f;
+        mesh_groups.shutdown();
+        group_map.shutdown();
     }
 
-    for (u32 buffer_index = 0; buffer_index < scene.buffers_count; ++buffer_index) {
-        void* buffer = buffers_data[buffer_index];
-        allocator->deallocate(buffer);
-    }
-    buffers_data.shutdown();
+    rprint("Mesh draws %u, instance groups %u\n", mesh_draws.size, instance_groups.size);
+
+    // Object indices of the visible instances, rewritten every frame and read as a per instance vertex stream.
+    BufferCreation instance_buffer_creation{ };
+    instance_buffer_creation.set(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, ResourceUsageType::Dynamic, max(mesh_draws.size, 1u) * sizeof(u32)).set_name("instance_buffer");
+    BufferHandle instance_buffer = gpu.create_buffer(instance_buffer_creation);
 
     i64 begin_frame_tick = time_now();
 
@@ -974,13 +1664,24 @@ void main() {
     f32 pitch = 0.0f;
 
     float model_scale = 1.0f;
+    // Redundant binds skipped by the command buffers in the last recorded frame.
+    ElidedBindCounters elided_binds{ };
+    u32 num_visible_meshes = 0;
+    u32 num_mesh_draw_calls = 0;
 
     while (!window.requested_exit) {
         ZoneScoped;
 
         // New frame
         if (!window.minimised) {
-            gpu.new_frame();
+            renderer.begin_frame();
+
+            // Resources requested with load_async are created here, between their reads on the workers and the frame.
+            rm.update();
+
+            if (renderer.texture_handles_changed) {
+                update_streamed_texture_indices(object_buffer, mesh_draws);
+            }
         }
         //input->new_frame();
 
@@ -1004,6 +1705,13 @@ void main() {
 
         if (ImGui::Begin("Engine ImGui")) {
             ImGui::InputFloat("Model scale", &model_scale, 0.001f);
+            ImGui::Text("Elided binds: pipelines %u, vertex buffers %u, index buffers %u, descriptor sets %u",
+                elided_binds.pipelines, elided_binds.vertex_buffers, elided_binds.index_buffers, elided_binds.descriptor_sets);
+            ImGui::Text("Visible meshes: %u / %u, draw calls %u", num_visible_meshes, mesh_draws.size, num_mesh_draw_calls);
+            if (renderer.texture_memory_budget) {
+                ImGui::Text("Streamed textures: %u, %.1f / %.1f MB", renderer.streamed_textures.size, renderer.texture_memory_streamed / (1024.0f * 1024.0f),
+                            renderer.texture_memory_budget / (1024.0f * 1024.0f));
+            }
         }
         ImGui::End();
 
@@ -1013,6 +1721,7 @@ void main() {
         ImGui::End();
 
         mat4s global_model = { };
+        mat4s view_projection = glms_mat4_identity();
         {
             // Update rotating cube gpu data
             MapBufferParameters cb_map = { cube_cb, 0, 0 };
@@ -1052,10 +1761,10 @@ void main() {
                 }
 
                 mat4s view = glms_lookat(eye, glms_vec3_add(eye, look), vec3s{ 0.0f, 1.0f, 0.0f });
-                mat4s projection = glms_perspective(glm_rad(60.0f), gpu.swapchain_width * 1.0f / gpu.swapchain_height, 0.01f, 1000.0f);
+                mat4s projection = glms_perspective(glm_rad(k_vertical_fov), gpu.swapchain_width * 1.0f / gpu.swapchain_height, 0.01f, k_far_plane);
 
                 // Calculate view projection matrix
-                mat4s view_projection = glms_mat4_mul(projection, view);
+                view_projection = glms_mat4_mul(projection, view);
 
                 // Rotate cube:
                 rx += 1.0f * delta_time;
@@ -1070,6 +1779,7 @@ void main() {
                 UniformData uniform_data{ };
                 uniform_data.vp = view_projection;
                 uniform_data.m = global_model;
+                uniform_data.m_inv = glms_mat4_inv(glms_mat4_transpose(global_model));
                 uniform_data.eye = vec4s{ eye.x, eye.y, eye.z, 1.0f };
                 uniform_data.light = vec4s{ 2.0f, 2.0f, 0.0f, 1.0f };
 
@@ -1086,54 +1796,140 @@ void main() {
 
             gpu_commands->clear(0.3f, 0.9f, 0.3f, 1.0f);
             gpu_commands->clear_depth_stencil(1.0f, 0);
-            gpu_commands->bind_pass(gpu.get_swapchain_pass());
-            gpu_commands->bind_pipeline(cube_pipeline);
-            gpu_commands->set_scissor(nullptr);
-            gpu_commands->set_viewport(nullptr);
 
-            for (u32 mesh_index = 0; mesh_index < mesh_draws.size; ++mesh_index) {
-                MeshDraw mesh_draw = mesh_draws[mesh_index];
-                mesh_draw.material_data.model_inv = glms_mat4_inv(glms_mat4_transpose(glms_mat4_mul(global_model, mesh_draw.material_data.model)));
+            // Copy objects changed since the last frame before the pass reads them.
+            upload_dirty_objects(gpu, gpu_commands, allocator, object_buffer, mesh_draws);
+
+            // Pass content is recorded in parallel into secondary command buffers.
+            gpu_commands->bind_pass(gpu.get_swapchain_pass(), true);
+
+            ElidedBindCounters frame_elided_binds{ };
+
+            // Mesh bounds are in scene space, so the frustum is extracted from the full model view projection.
+            Frustum frustum;
+            mat4s scene_view_projection = glms_mat4_mul(view_projection, global_model);
+            frustum.set_from_matrix(&scene_view_projection.raw[0][0]);
+            num_visible_meshes = frustum_cull(frustum, mesh_bounds, mesh_visibility.data);
+
+            // Visible instances of a group are packed together, the draw reads them from first_instance on.
+            MapBufferParameters instance_map = { instance_buffer, 0, 0 };
+            u32* instance_data = (u32*)gpu.map_buffer(instance_map);
+            u32 num_instances = 0;
+
+            // Pixels covered by one scene unit at distance one, for the texture streaming estimates.
+            const f32 screen_scale = gpu.swapchain_height * 0.5f / tanf(glm_rad(k_vertical_fov) * 0.5f);
 
-                MapBufferParameters material_map = { mesh_draw.material_buffer, 0, 0 };
-                MaterialData* material_buffer_data = (MaterialData*)gpu.map_buffer(material_map);
+            RenderQueue& render_queue = renderer.render_queue;
+            for (u32 group_index = 0; group_index < instance_groups.size; ++group_index) {
+                const InstanceGroup& group = instance_groups[group_index];
 
-                memcpy(material_buffer_data, &mesh_draw.material_data, sizeof(MaterialData));
+                // Front to back on the closest visible instance.
+                const u32 first_instance = num_instances;
+                f32 depth = 1.0f;
+                f32 screen_size = 0.0f;
+                for (u32 member = 0; member < group.count; ++member) {
+                    const u32 mesh_index = instance_members[group.first_member + member];
+                    if (!mesh_visibility[mesh_index]) {
+                        continue;
+                    }
 
-                gpu.unmap_buffer(material_map);
+                    instance_data[num_instances++] = mesh_index;
 
-                gpu_commands->bind_vertex_buffer(mesh_draw.position_buffer, 0, mesh_draw.position_offset);
-                gpu_commands->bind_vertex_buffer(mesh_draw.normal_buffer, 2, mesh_draw.normal_offset);
+                    const MeshDraw& instance = mesh_draws[mesh_index];
+                    const mat4s world = glms_mat4_mul(global_model, instance.material_data.model);
+                    const vec3s world_center = glms_mat4_mulv3(world, instance.bounding_center, 1.0f);
+                    const f32 distance = glms_vec3_distance(eye, world_center);
+                    depth = min(depth, distance / k_far_plane);
 
-                if (mesh_draw.material_data.flags & MaterialFeatures_TangentVertexAttribute) {
-                    gpu_commands->bind_vertex_buffer(mesh_draw.tangent_buffer, 1, mesh_draw.tangent_offset);
+                    // Projected diameter of the bounding sphere, the largest instance sets the material estimate.
+                    f32 world_scale = 0.0f;
+                    for (u32 c = 0; c < 3; ++c) {
+                        world_scale = max(world_scale, sqrtf(world.raw[c][0] * world.raw[c][0] + world.raw[c][1] * world.raw[c][1] + world.raw[c][2] * world.raw[c][2]));
+                    }
+                    const f32 world_radius = instance.bounding_radius * world_scale;
+                    screen_size = max(screen_size, 2.0f * world_radius * screen_scale / max(distance - world_radius, 0.01f));
                 }
-                else {
-                    gpu_commands->bind_vertex_buffer(dummy_attribute_buffer, 1, 0);
+
+                if (num_instances == first_instance) {
+                    continue;
                 }
 
-                if (mesh_draw.material_data.flags & MaterialFeatures_TexcoordVertexAttribute) {
-                    gpu_commands->bind_vertex_buffer(mesh_draw.texcoord_buffer, 3, mesh_draw.texcoord_offset);
+                MeshDraw& mesh_draw = mesh_draws[instance_members[group.first_member]];
+
+                for (u32 slot = 0; slot < SceneCacheTextureSlot_Count; ++slot) {
+                    if (mesh_draw.textures[slot]) {
+                        renderer.use_streamed_texture(mesh_draw.textures[slot], screen_size);
+                    }
                 }
-                else {
-                    gpu_commands->bind_vertex_buffer(dummy_attribute_buffer, 3, 0);
+
+                DrawItem draw_item{ };
+                draw_item.pipeline = cube_pipeline;
+                draw_item.descriptor_set = mesh_draw.descriptor_set;
+                draw_item.instance_count = num_instances - first_instance;
+                draw_item.first_instance = first_instance;
+
+                // Every draw binds the same arena streams, followed by the instance stream.
+                for (u32 stream = 0; stream < GeometryStream_Count; ++stream) {
+                    draw_item.vertex_buffers[stream] = geometry_arena.vertex_buffers[stream];
+                    draw_item.vertex_offsets[stream] = 0;
                 }
+                draw_item.vertex_buffers[GeometryStream_Count] = instance_buffer;
+                draw_item.vertex_offsets[GeometryStream_Count] = 0;
+                draw_item.num_vertex_buffers = GeometryStream_Count + 1;
+
+                draw_item.index_buffer = geometry_arena.get_index_buffer(mesh_draw.index_type);
+                draw_item.index_type = mesh_draw.index_type;
+                draw_item.index_count = mesh_draw.count;
+                draw_item.first_index = mesh_draw.first_index;
+                draw_item.vertex_offset = (i32)mesh_draw.vertex_offset;
+
+                render_queue.add(RenderQueue::make_sort_key(0, cube_pipeline.index, mesh_draw.material_index, depth), draw_item);
+            }
+
+            gpu.unmap_buffer(instance_map);
+            num_mesh_draw_calls = render_queue.size();
+
+            render_queue.sort();
+
+            if (render_queue.size()) {
+                const u32 num_record_tasks = min(min(task_scheduler->num_threads, gpu.num_threads), k_max_record_tasks);
 
-                gpu_commands->bind_index_buffer(mesh_draw.index_buffer, mesh_draw.index_offset, mesh_draw.index_type);
-                gpu_commands->bind_descriptor_set(&mesh_draw.descriptor_set, 1, nullptr, 0);
+                MeshDrawRecordContext record_context{ };
+                record_context.gpu = &gpu;
+                record_context.render_queue = &render_queue;
+                record_context.render_pass = gpu_commands->current_render_pass;
+                record_context.draws_per_task = (render_queue.size() + num_record_tasks - 1) / num_record_tasks;
 
-                gpu_commands->draw_indexed(TopologyType::Triangle, mesh_draw.count, 1, 0, 0, 0);
+                task_scheduler->parallel_for(render_queue.size(), record_context.draws_per_task, record_mesh_draws, &record_context);
+
+                const u32 num_command_buffers = (render_queue.size() + record_context.draws_per_task - 1) / record_context.draws_per_task;
+                gpu_commands->execute_commands(record_context.command_buffers, num_command_buffers);
+
+                for (u32 c = 0; c < num_command_buffers; ++c) {
+                    frame_elided_binds.add(record_context.command_buffers[c]->elided_binds);
+                }
             }
 
-            imgui->render(*gpu_commands);
+            CommandBuffer* imgui_commands = gpu.get_secondary_command_buffer(task_scheduler->get_thread_index());
+            imgui_commands->begin_secondary(gpu_commands->current_render_pass);
+            imgui->render(*imgui_commands);
+            imgui_commands->end();
+
+            gpu_commands->execute_commands(&imgui_commands, 1);
 
+            frame_elided_binds.add(imgui_commands->elided_binds);
+            frame_elided_binds.add(gpu_commands->elided_binds);
+            elided_binds = frame_elided_binds;
+
+            // Only secondary buffers can be executed inside the pass, close it before the marker.
+            gpu_commands->end_current_render_pass();
             gpu_commands->pop_marker();
 
             gpu_profiler.update(gpu);
 
             // Send commands to GPU
             gpu.queue_command_buffer(gpu_commands);
-            gpu.present();
+            renderer.end_frame();
 
         }
         else {
@@ -1143,26 +1939,31 @@ void main() {
         FrameMark;
     }
 
-    for ( u32 mesh_index = 0; mesh_index < mesh_draws.size; ++mesh_index )
-    {
-        MeshDraw& mesh_draw = mesh_draws[mesh_index];
-        gpu.destroy_descriptor_set(mesh_draw.descriptor_set);
-        gpu.destroy_buffer(mesh_draw.material_buffer);
+    if (gpu.bindless_supported) {
+        gpu.destroy_descriptor_set(shared_descriptor_set);
     }
-
-    for ( u32 mi = 0; mi < custom_mesh_buffers.size; ++mi )
-    {
-        gpu.destroy_buffer(custom_mesh_buffers[mi]);
+    else {
+        for ( u32 mesh_index = 0; mesh_index < mesh_draws.size; ++mesh_index )
+        {
+            MeshDraw& mesh_draw = mesh_draws[mesh_index];
+            gpu.destroy_descriptor_set(mesh_draw.descriptor_set);
+        }
     }
 
-    custom_mesh_buffers.shutdown();
+    gpu.destroy_buffer(object_buffer.buffer);
+    gpu.destroy_buffer(instance_buffer);
+
+    instance_groups.shutdown();
+    instance_members.shutdown();
 
-    gpu.destroy_buffer( dummy_attribute_buffer );
+    geometry_arena.shutdown();
 
     gpu.destroy_texture( dummy_texture );
     gpu.destroy_sampler( dummy_sampler );
 
     mesh_draws.shutdown();
+    mesh_bounds.shutdown();
+    mesh_visibility.shutdown();
 
     gpu.destroy_buffer( cube_cb );
     gpu.destroy_pipeline( cube_pipeline );
@@ -1172,23 +1973,26 @@ void main() {
 
     gpu_profiler.shutdown();
 
-    rm.shutdown();
+    // Resources loaded asynchronously point to names owned by the resource manager.
     renderer.shutdown();
+    rm.shutdown();
 
     samplers.shutdown();
     images.shutdown();
-    buffers.shutdown();
 
     resource_name_buffer.shutdown();
 
     // NOTE(marco): we can't destroy this sooner as textures and buffers
     // hold a pointer to the names stored here
-    gltf_free(scene);
+    scene_cache.unmap();
+    scene_cache_writer.shutdown();
 
     input_handler.shutdown();
     window.unregister_os_messages_callback(input_os_messages_callback);
     window.shutdown();
 
+    task_scheduler->shutdown();
+
     MemoryService::instance()->shutdown();
 
     return 0;